@@ -0,0 +1,670 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+//
+// Headless benchmark: boots a game without UI, frame limiting nor audio, runs it for a given number of frames
+// and writes a JSON report of the emulation speed and of the time spent in the main subsystems.
+//
+#include "types.h"
+#include "emulator.h"
+#include "stdclass.h"
+#include "cfg/cfg.h"
+#include "cfg/option.h"
+#include "hw/mem/addrspace.h"
+#include "hw/pvr/Renderer_if.h"
+#include "hw/pvr/ta_ctx.h"
+#include "hw/pvr/ta_structs.h"
+#include "hw/pvr/ta_vtx_simd.h"
+#include "hw/sh4/sh4_sched.h"
+#include "hw/sh4/dyna/ngen.h"
+#include "input/gamepad_device.h"
+#include "log/LogManager.h"
+#include "oslib/oslib.h"
+#include "profiler/telemetry.h"
+#include "rend/texconv.h"
+#include "json.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace nlohmann;
+
+Renderer *rend_norend();
+
+struct BenchmarkOptions
+{
+	u32 frames = 3600;
+	std::string renderer = "norend";
+	std::string inputPath;
+	std::string outputPath;
+	std::string tracePath;
+	std::string homePath = ".";
+	// Run a microbenchmark instead of a game
+	enum { Game, TexConv, VtxConv, Sort } scenario = Game;
+	// Passed to config::parseCommandLine
+	std::vector<const char *> args;
+};
+
+static const struct {
+	const char *name;
+	RenderType type;
+} Renderers[] = {
+	{ "opengl", RenderType::OpenGL },
+	{ "opengl-oit", RenderType::OpenGL_OIT },
+	{ "vulkan", RenderType::Vulkan },
+	{ "vulkan-oit", RenderType::Vulkan_OIT },
+	{ "dx9", RenderType::DirectX9 },
+	{ "dx11", RenderType::DirectX11 },
+	{ "dx11-oit", RenderType::DirectX11_OIT },
+	{ "software", RenderType::Software },
+};
+
+static void usage(const char *exe)
+{
+	fprintf(stderr, "Usage: %s [option]... <game path>\n", exe);
+	fprintf(stderr, "       %s -texconv|-vtxconv|-sort [-output <file>]\n", exe);
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "-frames <n>                    number of frames to run (default: 3600)\n");
+	fprintf(stderr, "-renderer <name>               norend (default), opengl, opengl-oit, vulkan, vulkan-oit,\n");
+	fprintf(stderr, "                               dx9, dx11, dx11-oit or software\n");
+	fprintf(stderr, "-input <file>                  replay a recorded input file\n");
+	fprintf(stderr, "-output <file>                 write the report to this file instead of stdout\n");
+	fprintf(stderr, "-trace <file>                  record telemetry and save it as a Chrome trace\n");
+	fprintf(stderr, "-home <dir>                    config and data directory (default: current directory)\n");
+	fprintf(stderr, "-config section:key=value,...  set a config value\n");
+	fprintf(stderr, "-texconv                       measure the texture decoding speed of each format\n");
+	fprintf(stderr, "-vtxconv                       compare the scalar and simd TA vertex conversions\n");
+	fprintf(stderr, "-sort                          compare the translucent triangle radix sort with std::sort\n");
+}
+
+static bool parseOptions(int argc, char *argv[], BenchmarkOptions& options)
+{
+	options.args.push_back(argv[0]);
+	for (int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+		// Accept both -option and --option
+		if (arg[0] == '-' && arg[1] == '-')
+			arg++;
+		const bool hasValue = i < argc - 1;
+		if (!strcmp(arg, "-frames") && hasValue)
+			options.frames = atoi(argv[++i]);
+		else if (!strcmp(arg, "-renderer") && hasValue)
+			options.renderer = argv[++i];
+		else if (!strcmp(arg, "-input") && hasValue)
+			options.inputPath = argv[++i];
+		else if (!strcmp(arg, "-output") && hasValue)
+			options.outputPath = argv[++i];
+		else if (!strcmp(arg, "-trace") && hasValue)
+			options.tracePath = argv[++i];
+		else if (!strcmp(arg, "-texconv"))
+			options.scenario = BenchmarkOptions::TexConv;
+		else if (!strcmp(arg, "-vtxconv"))
+			options.scenario = BenchmarkOptions::VtxConv;
+		else if (!strcmp(arg, "-sort"))
+			options.scenario = BenchmarkOptions::Sort;
+		else if (!strcmp(arg, "-home") && hasValue)
+			options.homePath = argv[++i];
+		else if (!strcmp(arg, "-config") && hasValue)
+		{
+			options.args.push_back(argv[i]);
+			options.args.push_back(argv[++i]);
+		}
+		else if (arg[0] == '-')
+			return false;
+		else
+			options.args.push_back(argv[i]);
+	}
+	if (options.scenario != BenchmarkOptions::Game)
+		return options.args.size() == 1;
+	return options.frames > 0 && options.args.size() >= 2 && options.args.back()[0] != '-';
+}
+
+//
+// Replays an input file recorded with a TEST_AUTOMATION build (record.record_input=yes).
+// Each line is: <sh4 cycles> button <port> <kcode>
+//
+class InputReplay
+{
+public:
+	bool load(const std::string& path)
+	{
+		FILE *f = nowide::fopen(path.c_str(), "r");
+		if (f == nullptr)
+			return false;
+		InputEvent event;
+		char action[32];
+		while (fscanf(f, "%" SCNu64 " %31s %x %x\n", &event.time, action, &event.port, &event.kcode) == 4)
+			if (event.port < std::size(kcode))
+				events.push_back(event);
+		fclose(f);
+		return true;
+	}
+
+	void update(u64 now)
+	{
+		for (; next < events.size() && events[next].time <= now; next++)
+			kcode[events[next].port] = events[next].kcode;
+	}
+
+private:
+	struct InputEvent
+	{
+		u64 time;
+		u32 port;
+		u32 kcode;
+	};
+	std::vector<InputEvent> events;
+	size_t next = 0;
+};
+
+static InputReplay inputReplay;
+static u32 frameCount;
+static u32 frameTarget;
+
+static void onVBlank(Event, void *)
+{
+	frameCount++;
+	inputReplay.update(sh4_sched_now64());
+	if (frameCount >= frameTarget)
+		emu.getSh4Executor()->Stop();
+}
+
+template<typename Duration>
+static double toMs(Duration duration) {
+	return std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / 1000.0;
+}
+
+static json runBenchmark(const BenchmarkOptions& options)
+{
+	json report;
+	report["game"] = settings.content.path;
+	report["renderer"] = options.renderer;
+	report["dynarec"] = (bool)config::DynarecEnabled;
+
+	auto start = std::chrono::steady_clock::now();
+	emu.loadGame(settings.content.path.c_str());
+	report["load_time_ms"] = toMs(std::chrono::steady_clock::now() - start);
+
+	frameCount = 0;
+	frameTarget = options.frames;
+	EventManager::listen(Event::VBlank, onVBlank);
+	emu.start();
+
+	telemetry::startTotals();
+	const u32 renderedStart = FrameCount;
+	const u64 cyclesStart = sh4_sched_now64();
+#if FEAT_SHREC != DYNAREC_NONE
+	const Sh4Recompiler::CodeCacheStats cacheStart = Sh4Recompiler::getCodeCacheStats();
+#endif
+	start = std::chrono::steady_clock::now();
+
+	while (frameCount < frameTarget && emu.render())
+		;
+
+	const double seconds = toMs(std::chrono::steady_clock::now() - start) / 1000.0;
+	const u64 cycles = sh4_sched_now64() - cyclesStart;
+	telemetry::stopTotals();
+	EventManager::unlisten(Event::VBlank, onVBlank);
+	emu.stop();
+	if (!options.tracePath.empty() && !telemetry::exportChromeTrace(options.tracePath))
+		throw FlycastException("Can't write the trace file " + options.tracePath);
+
+	report["frames"] = frameCount;
+	report["rendered_frames"] = FrameCount - renderedStart;
+	report["time_s"] = seconds;
+	report["fps"] = frameCount / seconds;
+	report["sh4_cycles"] = cycles;
+	report["sh4_cycles_per_s"] = cycles / seconds;
+	// Percentage of the real console speed
+	report["speed_percent"] = cycles * 100.0 / SH4_MAIN_CLOCK / seconds;
+#if FEAT_SHREC != DYNAREC_NONE
+	if (config::DynarecEnabled)
+	{
+		const Sh4Recompiler::CodeCacheStats& cacheStats = Sh4Recompiler::getCodeCacheStats();
+		report["blocks_compiled"] = cacheStats.compiledBlocks - cacheStart.compiledBlocks;
+		report["cache_flushes"] = cacheStats.fullFlushes - cacheStart.fullFlushes;
+		report["cache_evictions"] = cacheStats.evictions - cacheStart.evictions;
+	}
+#endif
+	report["ta_parses"] = telemetry::totalCount(telemetry::Probe::TaParse);
+	report["ta_parse_time_ms"] = telemetry::totalTime(telemetry::Probe::TaParse);
+	report["texture_updates"] = telemetry::totalCount(telemetry::Probe::TextureUpdate);
+	report["aica_time_ms"] = telemetry::totalTime(telemetry::Probe::AicaRun);
+
+	return report;
+}
+
+//
+// Texture decoding scenario: random data is decoded in every format and size from 8x8 to 1024x1024
+//
+template<typename Pixel>
+static void texconvFormat(json& report, const std::string& name, void (*conv)(PixelBuffer<Pixel> *, const u8 *, u32, u32),
+		const u8 *data)
+{
+	constexpr int Loops = 4;
+	if (conv == nullptr)
+		return;
+	u64 pixels = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (int loop = 0; loop < Loops; loop++)
+		for (u32 w = 8; w <= 1024; w *= 2)
+			for (u32 h = 8; h <= 1024; h *= 2)
+			{
+				PixelBuffer<Pixel> pb;
+				pb.init(w, h);
+				conv(&pb, data, w, h);
+				pixels += w * h;
+			}
+	const double time = toMs(std::chrono::steady_clock::now() - start);
+	report[name]["time_ms"] = time;
+	report[name]["mpixels_per_s"] = pixels / std::max(time, 0.001) / 1000.0;
+}
+
+static json runTexConvBenchmark()
+{
+	std::mt19937 gen(42);
+	// Largest texture with mipmaps, and a VQ codebook
+	std::vector<u8> data(1024 * 1024 * 2 * 2);
+	for (u8& b : data)
+		b = gen();
+	std::vector<u8> codebook(256 * 8);
+	for (u8& b : codebook)
+		b = gen();
+	vq_codebook = codebook.data();
+	palette_index = 0;
+
+	json report;
+	report["scenario"] = "texconv";
+	json& formats = report["formats"];
+	for (const PvrTexInfo& info : opengl::pvrTexInfo)
+	{
+		const std::string name(info.name);
+		texconvFormat(formats, name + " TW", info.TW, data.data());
+		texconvFormat(formats, name + " VQ", info.VQ, data.data());
+		texconvFormat(formats, name + " PL32", info.PL32, data.data());
+		texconvFormat(formats, name + " TW32", info.TW32, data.data());
+		texconvFormat(formats, name + " VQ32", info.VQ32, data.data());
+		texconvFormat(formats, name + " PLVQ32", info.PLVQ32, data.data());
+		texconvFormat(formats, name + " TW8", info.TW8, data.data());
+	}
+	vq_codebook = nullptr;
+
+	return report;
+}
+
+#ifdef TA_VTX_SIMD
+//
+// TA vertex conversion scenario: the colors and uvs of random vertices are converted in strips of 16 vertices
+// with the simd kernels used by ta_vtx.cpp and with a copy of its scalar conversion
+//
+static u8 f32_su8_tbl[65536];
+
+static u8 float_to_satu8(float val) {
+	return f32_su8_tbl[(u32&)val >> 16];
+}
+
+template<typename Scalar, typename Simd>
+static void vtxconvKernel(json& report, const std::string& name, const std::vector<Ta_Dma>& data, Scalar scalar, Simd simd)
+{
+	constexpr int Loops = 10000;
+	constexpr u32 StripSize = 16;
+	std::vector<Vertex> scalarOut(data.size());
+	std::vector<Vertex> simdOut(data.size());
+
+	auto start = std::chrono::steady_clock::now();
+	for (int loop = 0; loop < Loops; loop++)
+		for (u32 i = 0; i < data.size(); i += StripSize)
+			scalar(&scalarOut[i], &data[i], std::min<u32>(StripSize, data.size() - i));
+	const double scalarTime = toMs(std::chrono::steady_clock::now() - start);
+
+	start = std::chrono::steady_clock::now();
+	for (int loop = 0; loop < Loops; loop++)
+		for (u32 i = 0; i < data.size(); i += StripSize)
+			simd(&simdOut[i], &data[i], std::min<u32>(StripSize, data.size() - i));
+	const double simdTime = toMs(std::chrono::steady_clock::now() - start);
+
+	const double vertices = (double)data.size() * Loops;
+	report[name]["scalar_time_ms"] = scalarTime;
+	report[name]["simd_time_ms"] = simdTime;
+	report[name]["scalar_mvertices_per_s"] = vertices / std::max(scalarTime, 0.001) / 1000.0;
+	report[name]["simd_mvertices_per_s"] = vertices / std::max(simdTime, 0.001) / 1000.0;
+	report[name]["speedup"] = scalarTime / std::max(simdTime, 0.001);
+	report[name]["identical"] = memcmp(scalarOut.data(), simdOut.data(), data.size() * sizeof(Vertex)) == 0;
+}
+
+static json runVtxConvBenchmark()
+{
+	for (u32 i = 0; i < std::size(f32_su8_tbl); i++)
+	{
+		u32 fr = i << 16;
+		f32 f = (f32&)fr;
+		f32_su8_tbl[i] = (u8)(f == f ? std::clamp(f, 0.f, 1.f) * 255.f : 255.f);
+	}
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<f32> colorDist(-0.25f, 1.25f);
+	std::vector<Ta_Dma> data(4096);
+	for (Ta_Dma& vtx : data)
+	{
+		vtx.pcw.full = 0;
+		vtx.pcw.ParaType = ParamType_Vertex_Parameter;
+		for (u32& w : vtx.data_32)
+		{
+			f32 f = colorDist(gen);
+			w = (u32&)f;
+		}
+	}
+	constexpr size_t srcStride = sizeof(Ta_Dma);
+	constexpr size_t dstStride = sizeof(Vertex);
+	const u8 face[4] { 0x12, 0x80, 0xff, 0xc3 };
+#define vtx_field(type, field) src->data_8 + offsetof(type, field), srcStride
+
+	json report;
+	report["scenario"] = "vtxconv";
+	json& kernels = report["kernels"];
+	vtxconvKernel(kernels, "packed", data,
+		[](Vertex *cv, const Ta_Dma *src, u32 count) {
+			for (u32 i = 0; i < count; i++, cv++)
+			{
+				u32 t = ((const TA_Vertex0 *)src[i].data_8)->BaseCol;
+				cv->col[2] = (u8)t;
+				cv->col[1] = (u8)(t >> 8);
+				cv->col[0] = (u8)(t >> 16);
+				cv->col[3] = (u8)(t >> 24);
+			}
+		},
+		[](Vertex *cv, const Ta_Dma *src, u32 count) {
+			vtxconv::packedColors<0, 1, 2, 3>(cv->col, dstStride, vtx_field(TA_Vertex0, BaseCol), count);
+		});
+	vtxconvKernel(kernels, "float", data,
+		[](Vertex *cv, const Ta_Dma *src, u32 count) {
+			for (u32 i = 0; i < count; i++, cv++)
+			{
+				const TA_Vertex1 *vtx = (const TA_Vertex1 *)src[i].data_8;
+				cv->col[0] = float_to_satu8(vtx->BaseR);
+				cv->col[1] = float_to_satu8(vtx->BaseG);
+				cv->col[2] = float_to_satu8(vtx->BaseB);
+				cv->col[3] = float_to_satu8(vtx->BaseA);
+			}
+		},
+		[](Vertex *cv, const Ta_Dma *src, u32 count) {
+			vtxconv::floatColors<0, 1, 2, 3>(cv->col, dstStride, vtx_field(TA_Vertex1, BaseA), count);
+		});
+	vtxconvKernel(kernels, "intensity", data,
+		[&](Vertex *cv, const Ta_Dma *src, u32 count) {
+			for (u32 i = 0; i < count; i++, cv++)
+			{
+				u32 satint = float_to_satu8(((const TA_Vertex2 *)src[i].data_8)->BaseInt);
+				cv->col[0] = face[0] * satint / 256;
+				cv->col[1] = face[1] * satint / 256;
+				cv->col[2] = face[2] * satint / 256;
+				cv->col[3] = face[3];
+			}
+		},
+		[&](Vertex *cv, const Ta_Dma *src, u32 count) {
+			vtxconv::intensityColors<3>(cv->col, dstStride, vtx_field(TA_Vertex2, BaseInt), count, face);
+		});
+	vtxconvKernel(kernels, "uv16", data,
+		[](Vertex *cv, const Ta_Dma *src, u32 count) {
+			for (u32 i = 0; i < count; i++, cv++)
+			{
+				const TA_Vertex4 *vtx = (const TA_Vertex4 *)src[i].data_8;
+				u32 u = vtx->u << 16;
+				u32 v = vtx->v << 16;
+				cv->u = (f32&)u;
+				cv->v = (f32&)v;
+			}
+		},
+		[](Vertex *cv, const Ta_Dma *src, u32 count) {
+			vtxconv::uv16((u8 *)&cv->u, dstStride, vtx_field(TA_Vertex4, v), count);
+		});
+#undef vtx_field
+
+	return report;
+}
+#else
+static json runVtxConvBenchmark()
+{
+	json report;
+	report["scenario"] = "vtxconv";
+	report["error"] = "No simd vertex conversion on this platform";
+	return report;
+}
+#endif
+
+//
+// Triangle sort scenario: the z sort keys of random triangles are sorted with the radix sort used for
+// translucent triangles and with std::sort, for scene sizes from 256 to 256K triangles
+//
+static json runSortBenchmark()
+{
+	// Same number of sorted triangles for each size
+	constexpr u32 TotalTriangles = 16 * 1024 * 1024;
+	std::mt19937 gen(42);
+	// -1/z is between 0 and 1 in most scenes
+	std::uniform_real_distribution<f32> zDist(0.0001f, 1.f);
+
+	json report;
+	report["scenario"] = "sort";
+	json& sizes = report["sizes"] = json::array();
+	for (u32 triangles = 256; triangles <= 256 * 1024; triangles *= 4)
+	{
+		// Positive float z in the 32 msbits with its sign bit set, as in sortTriangles(), and the triangle index
+		std::vector<u64> keys(triangles);
+		for (u32 i = 0; i < triangles; i++)
+		{
+			f32 z = zDist(gen);
+			keys[i] = ((u64)((u32&)z | 0x80000000) << 32) | i;
+		}
+		const u32 loops = TotalTriangles / triangles;
+		std::vector<u64> radixKeys;
+		std::vector<u64> tmp;
+		auto start = std::chrono::steady_clock::now();
+		for (u32 loop = 0; loop < loops; loop++)
+		{
+			radixKeys = keys;
+			radixSort(radixKeys, tmp);
+		}
+		const double radixTime = toMs(std::chrono::steady_clock::now() - start);
+
+		std::vector<u64> stdKeys;
+		start = std::chrono::steady_clock::now();
+		for (u32 loop = 0; loop < loops; loop++)
+		{
+			stdKeys = keys;
+			// The triangle index makes the keys unique so the order is the same as the stable radix sort
+			std::sort(stdKeys.begin(), stdKeys.end());
+		}
+		const double stdTime = toMs(std::chrono::steady_clock::now() - start);
+
+		json size;
+		size["triangles"] = triangles;
+		size["radix_time_ms"] = radixTime / loops;
+		size["std_sort_time_ms"] = stdTime / loops;
+		size["speedup"] = stdTime / std::max(radixTime, 0.001);
+		size["identical"] = radixKeys == stdKeys;
+		sizes.push_back(size);
+	}
+
+	return report;
+}
+
+static bool writeReport(const json& report, const std::string& path)
+{
+	const std::string s = report.dump(4);
+	if (path.empty())
+	{
+		printf("%s\n", s.c_str());
+		return true;
+	}
+	FILE *f = nowide::fopen(path.c_str(), "w");
+	if (f == nullptr)
+		return false;
+	fprintf(f, "%s\n", s.c_str());
+	fclose(f);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	BenchmarkOptions options;
+	if (!parseOptions(argc, argv, options))
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	RenderType renderType {};
+	if (options.renderer != "norend")
+	{
+		auto it = std::find_if(std::begin(Renderers), std::end(Renderers),
+				[&](const auto& r) { return options.renderer == r.name; });
+		if (it == std::end(Renderers))
+		{
+			usage(argv[0]);
+			return 1;
+		}
+		renderType = it->type;
+	}
+	if (options.scenario != BenchmarkOptions::Game)
+	{
+		json report;
+		switch (options.scenario)
+		{
+		case BenchmarkOptions::TexConv:
+			report = runTexConvBenchmark();
+			break;
+		case BenchmarkOptions::VtxConv:
+			report = runVtxConvBenchmark();
+			break;
+		case BenchmarkOptions::Sort:
+			report = runSortBenchmark();
+			break;
+		default:
+			break;
+		}
+		if (!writeReport(report, options.outputPath))
+		{
+			fprintf(stderr, "Can't create %s\n", options.outputPath.c_str());
+			return 1;
+		}
+		return 0;
+	}
+	LogManager::Init();
+
+	const std::string home = options.homePath + "/";
+	set_user_config_dir(home);
+	set_user_data_dir(home + "data/");
+	add_system_data_dir(home);
+#if defined(__unix__)
+	void common_linux_setup();
+	common_linux_setup();
+#else
+	os_InstallFaultHandler();
+#endif
+	if (!addrspace::reserve())
+	{
+		fprintf(stderr, "Failed to reserve the emulator address space\n");
+		return 1;
+	}
+	// The config file isn't loaded nor saved so that results don't depend on the user settings
+	config::setAutoSave(false);
+	config::parseCommandLine((int)options.args.size(), options.args.data());
+	// Single-threaded rendering, no audio
+	config::setTransient("config", "rend.ThreadedRendering", "no");
+	config::setTransient("audio", "backend", "null");
+	if (options.renderer != "norend")
+		config::setTransient("config", "pvr.rend", std::to_string((int)renderType));
+	if (!options.tracePath.empty())
+		config::setTransient("config", "Telemetry.Enabled", "yes");
+	config::Settings::instance().reset();
+	config::Settings::instance().load(false);
+	settings.aica.muteAudio = true;
+
+	if (options.renderer == "norend")
+	{
+		renderer = rend_norend();
+	}
+	else
+	{
+		config::RendererType = renderType;
+		// The software renderer doesn't need a graphics context, which would replace it with OpenGL
+		if (renderType != RenderType::Software)
+			os_CreateWindow();
+	}
+	if (!rend_init_renderer())
+	{
+		fprintf(stderr, "Renderer initialization failed\n");
+		return 1;
+	}
+
+	if (!options.inputPath.empty() && !inputReplay.load(options.inputPath))
+	{
+		fprintf(stderr, "Can't open input file %s\n", options.inputPath.c_str());
+		return 1;
+	}
+
+	int rc = 0;
+	try {
+		json report = runBenchmark(options);
+		if (!writeReport(report, options.outputPath))
+			throw FlycastException("Can't create " + options.outputPath);
+	} catch (const std::exception& e) {
+		fprintf(stderr, "Benchmark failed: %s\n", e.what());
+		rc = 1;
+	}
+	try {
+		emu.unloadGame();
+	} catch (...) { }
+	rend_term_renderer();
+	emu.term();
+	os_DestroyWindow();
+
+	return rc;
+}
+
+#if !defined(__ANDROID__) && !defined(__APPLE__)
+void os_DoEvents()
+{
+}
+
+void os_RunInstance(int argc, const char *argv[])
+{
+}
+
+[[noreturn]] void os_DebugBreak()
+{
+	std::abort();
+}
+
+#ifdef _WIN32
+void os_SetThreadName(const char *name)
+{
+}
+const char *getThreadName()
+{
+	return "threadname";
+}
+#endif
+#endif
@@ -17,13 +17,26 @@
     along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
 */
 #include "rzip.h"
+#include "util/thread_pool.h"
 #include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 
+#include <atomic>
 #include <cstring>
+#include <vector>
 
 const u8 RZipHeader[8] = { '#', 'R', 'Z', 'I', 'P', 'v', 1, '#' };
+const u8 RZstdHeader[8] = { '#', 'R', 'Z', 'S', 'T', 'D', 1, '#' };
 
-bool RZipFile::Open(hostfs::File *file, bool write)
+static ThreadPool& compressionPool()
+{
+	static ThreadPool pool("RZipCompress");
+	return pool;
+}
+
+bool RZipFile::Open(hostfs::File *file, bool write, Codec codec)
 {
 	verify(this->file == nullptr);
 	verify(file != nullptr);
@@ -31,8 +44,19 @@ bool RZipFile::Open(hostfs::File *file, bool write)
 	if (!write)
 	{
 		u8 header[sizeof(RZipHeader)];
-		if (file->read(header, sizeof(header), 1) != 1
-			|| memcmp(header, RZipHeader, sizeof(header))
+		bool validHeader = file->read(header, sizeof(header), 1) == 1;
+		if (validHeader)
+		{
+			if (!memcmp(header, RZipHeader, sizeof(header)))
+				this->codec = Codec::Zlib;
+#ifdef HAVE_ZSTD
+			else if (!memcmp(header, RZstdHeader, sizeof(header)))
+				this->codec = Codec::Zstd;
+#endif
+			else
+				validHeader = false;
+		}
+		if (!validHeader
 			|| file->read(&maxChunkSize, sizeof(maxChunkSize), 1) != 1
 			|| file->read(&size, sizeof(size), 1) != 1)
 		{
@@ -51,8 +75,12 @@ bool RZipFile::Open(hostfs::File *file, bool write)
 	}
 	else
 	{
+#ifndef HAVE_ZSTD
+		codec = Codec::Zlib;
+#endif
+		this->codec = codec;
 		maxChunkSize = 1_MB;
-		if (file->write(RZipHeader, sizeof(RZipHeader), 1) != 1
+		if (file->write(codec == Codec::Zstd ? RZstdHeader : RZipHeader, sizeof(RZipHeader), 1) != 1
 			|| file->write(&maxChunkSize, sizeof(maxChunkSize), 1) != 1
 			|| file->write(&size, sizeof(size), 1) != 1)
 		{
@@ -65,12 +93,12 @@ bool RZipFile::Open(hostfs::File *file, bool write)
 	return true;
 }
 
-bool RZipFile::Open(const std::string& path, bool write)
+bool RZipFile::Open(const std::string& path, bool write, Codec codec)
 {
 	hostfs::File *f = hostfs::storage().openFile(path.c_str(), write ? "wb" : "rb");
 	if (f == nullptr)
 		return false;
-	if (!Open(f, write)) {
+	if (!Open(f, write, codec)) {
 		Close();
 		return false;
 	}
@@ -120,14 +148,14 @@ size_t RZipFile::Read(void *data, size_t length)
 				delete [] zipped;
 				break;
 			}
-			uLongf tl = maxChunkSize;
-			if (uncompress(chunk, &tl, zipped, zippedSize) != Z_OK)
+			u32 unzippedSize = maxChunkSize;
+			if (!uncompress(chunk, unzippedSize, zipped, zippedSize))
 			{
 				delete [] zipped;
 				break;
 			}
 			delete [] zipped;
-			chunkSize = (u32)tl;
+			chunkSize = unzippedSize;
 		}
 		u32 l = std::min(chunkSize - chunkIndex, (u32)(length - rv));
 		memcpy(p, chunk + chunkIndex, l);
@@ -146,31 +174,88 @@ size_t RZipFile::Write(const void *data, size_t length)
 
 	size += length;
 	const u8 *p = (const u8 *)data;
-	// compression output buffer must be 0.1% larger + 12 bytes
-	uLongf maxZippedSize = maxChunkSize + maxChunkSize / 1000 + 12;
-	u8 *zipped = new u8[maxZippedSize];
+	// Chunks are compressed in batches, one per thread, and written in order
+	ThreadPool& pool = compressionPool();
+	const size_t batchSize = std::min(pool.size() + 1, 16u);
+	const u32 maxZippedSize = maxCompressedSize();
+	std::vector<u8> zipped(batchSize * maxZippedSize);
+	std::vector<u32> zippedSizes(batchSize);
 	size_t rv = 0;
 	while (rv < length)
 	{
-		uLongf zippedSize = maxZippedSize;
-		uLongf uncompressedSize = std::min(maxChunkSize, (u32)(length - rv));
-		u32 rc = compress(zipped, &zippedSize, p, uncompressedSize);
-		if (rc != Z_OK)
-		{
-			WARN_LOG(SAVESTATE, "Compression error: %d", rc);
+		const size_t chunkCount = std::min<size_t>(batchSize, (length - rv + maxChunkSize - 1) / maxChunkSize);
+		std::atomic<bool> error = false;
+		pool.parallelFor(chunkCount, [&](size_t i) {
+			const size_t offset = rv + i * maxChunkSize;
+			zippedSizes[i] = maxZippedSize;
+			if (!compress(&zipped[i * maxZippedSize], zippedSizes[i],
+					p + offset, (u32)std::min<size_t>(maxChunkSize, length - offset)))
+				error = true;
+		});
+		if (error)
 			break;
-		}
-		u32 sz = (u32)zippedSize;
-		if (file->write(&sz, sizeof(sz), 1) != 1
-			|| file->write(zipped, zippedSize, 1) != 1)
+		for (size_t i = 0; i < chunkCount; i++)
 		{
-			rv = 0;
-			break;
+			if (file->write(&zippedSizes[i], sizeof(u32), 1) != 1
+				|| file->write(&zipped[i * maxZippedSize], zippedSizes[i], 1) != 1)
+				return 0;
 		}
-		p += uncompressedSize;
-		rv += uncompressedSize;
+		rv += std::min<size_t>(chunkCount * maxChunkSize, length - rv);
 	}
-	delete [] zipped;
-	
+
 	return rv;
 }
+
+u32 RZipFile::maxCompressedSize() const
+{
+#ifdef HAVE_ZSTD
+	if (codec == Codec::Zstd)
+		return (u32)ZSTD_compressBound(maxChunkSize);
+#endif
+	return (u32)compressBound(maxChunkSize);
+}
+
+bool RZipFile::compress(u8 *dst, u32& dstSize, const u8 *src, u32 srcSize) const
+{
+#ifdef HAVE_ZSTD
+	if (codec == Codec::Zstd)
+	{
+		size_t rc = ZSTD_compress(dst, dstSize, src, srcSize, ZSTD_CLEVEL_DEFAULT);
+		if (ZSTD_isError(rc))
+		{
+			WARN_LOG(SAVESTATE, "Compression error: %s", ZSTD_getErrorName(rc));
+			return false;
+		}
+		dstSize = (u32)rc;
+		return true;
+	}
+#endif
+	uLongf zippedSize = dstSize;
+	int rc = ::compress(dst, &zippedSize, src, srcSize);
+	if (rc != Z_OK)
+	{
+		WARN_LOG(SAVESTATE, "Compression error: %d", rc);
+		return false;
+	}
+	dstSize = (u32)zippedSize;
+	return true;
+}
+
+bool RZipFile::uncompress(u8 *dst, u32& dstSize, const u8 *src, u32 srcSize) const
+{
+#ifdef HAVE_ZSTD
+	if (codec == Codec::Zstd)
+	{
+		size_t rc = ZSTD_decompress(dst, dstSize, src, srcSize);
+		if (ZSTD_isError(rc))
+			return false;
+		dstSize = (u32)rc;
+		return true;
+	}
+#endif
+	uLongf unzippedSize = dstSize;
+	if (::uncompress(dst, &unzippedSize, src, srcSize) != Z_OK)
+		return false;
+	dstSize = (u32)unzippedSize;
+	return true;
+}
@@ -18,6 +18,8 @@
 */
 // Implementation of the RZIP stream format as defined by libretro
 // https://github.com/libretro/libretro-common/blob/master/include/streams/rzip_stream.h
+// Chunks can optionally be compressed with zstd instead of zlib, using a different header.
+// Such files can only be read by flycast.
 
 #pragma once
 #include "types.h"
@@ -26,17 +28,24 @@
 class RZipFile
 {
 public:
+	enum class Codec { Zlib, Zstd };
+
 	~RZipFile() { Close(); }
 
-	bool Open(const std::string& path, bool write);
-	bool Open(hostfs::File *file, bool write);
+	bool Open(const std::string& path, bool write, Codec codec = Codec::Zlib);
+	bool Open(hostfs::File *file, bool write, Codec codec = Codec::Zlib);
 	void Close();
 	size_t Size() const { return size; }
 	size_t Read(void *data, size_t length);
+	// Chunks are compressed in parallel
 	size_t Write(const void *data, size_t length);
 	hostfs::File *rawFile() const { return file; }
 
 private:
+	bool compress(u8 *dst, u32& dstSize, const u8 *src, u32 srcSize) const;
+	bool uncompress(u8 *dst, u32& dstSize, const u8 *src, u32 srcSize) const;
+	u32 maxCompressedSize() const;
+
 	hostfs::File *file = nullptr;
 	u64 size = 0;
 	u32 maxChunkSize = 0;
@@ -44,5 +53,6 @@ private:
 	u32 chunkSize = 0;
 	u32 chunkIndex = 0;
 	bool write = false;
+	Codec codec = Codec::Zlib;
 	long startOffset = 0;
 };
@@ -65,11 +65,17 @@ class DirectSoundBackend : public AudioBackend
 			if (SUCCEEDED(buffer->Lock(notificationOffset(rv), SAMPLE_BYTES, &p1, &sz1, &p2, &sz2, 0)))
 			{
 				if (!ringBuffer.read((u8*)p1, sz1))
+				{
 					memset(p1, 0, sz1);
+					underruns++;
+				}
 				if (sz2 != 0)
 				{
 					if (!ringBuffer.read((u8*)p2, sz2))
+					{
 						memset(p2, 0, sz2);
+						underruns++;
+					}
 				}
 				buffer->Unlock(p1, sz1, p2, sz2);
 				pushWait.Set();
@@ -165,6 +171,13 @@ public:
 		return 1;
 	}
 
+	bool getBufferStatus(u32& queued, u32& capacity) override
+	{
+		queued = ringBuffer.readSize() / 4;
+		capacity = ringBuffer.capacity() / 4;
+		return true;
+	}
+
 	void term() override
 	{
 		audioThreadRunning = false;
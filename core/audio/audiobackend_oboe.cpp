@@ -43,8 +43,11 @@ class OboeBackend : AudioBackend
 		oboe::DataCallbackResult onAudioReady(oboe::AudioStream *audioStream, void *audioData, int32_t numFrames) override
 		{
 			if (!backend->ringBuffer.read((u8 *)audioData, numFrames * 4))
+			{
 				// underrun
 				memset(audioData, 0, numFrames * 4);
+				backend->underruns++;
+			}
 			backend->pushWait.Set();
 
 			return oboe::DataCallbackResult::Continue;
@@ -149,6 +152,13 @@ public:
 		return 1;
 	}
 
+	bool getBufferStatus(u32& queued, u32& capacity) override
+	{
+		queued = ringBuffer.readSize() / 4;
+		capacity = ringBuffer.capacity() / 4;
+		return true;
+	}
+
 	void termRecord() override
 	{
 		if (recordStream != nullptr)
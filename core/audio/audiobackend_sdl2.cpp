@@ -7,17 +7,14 @@
 
 #include <algorithm>
 #include <atomic>
-#include <mutex>
 
 class SDLAudioBackend : AudioBackend
 {
 	SDL_AudioDeviceID audiodev {};
 	bool needs_resampling = false;
 	cResetEvent read_wait;
-	std::mutex stream_mutex;
-	uint32_t *sample_buffer;
+	RingBuffer ringBuffer;
 	unsigned sample_buffer_size = 0;
-	unsigned sample_count = 0;
 	SDL_AudioCVT audioCvt;
 
 	SDL_AudioDeviceID recorddev {};
@@ -29,38 +26,34 @@ class SDLAudioBackend : AudioBackend
 	{
 		SDLAudioBackend *backend = (SDLAudioBackend *)userdata;
 
-		backend->stream_mutex.lock();
-		// Wait until there's enough samples to feed the kraken
 		unsigned oslen = len / sizeof(uint32_t);
 		unsigned islen = backend->needs_resampling ? std::ceil(oslen / backend->audioCvt.len_ratio) : oslen;
 
-		if (backend->sample_count < islen)
+		if (!backend->needs_resampling)
 		{
-			// No data, just output a bit of silence for the underrun
-			memset(stream, 0, len);
-			backend->stream_mutex.unlock();
-			backend->read_wait.Set();
-			return;
-		}
-
-		if (!backend->needs_resampling) {
 			// Just copy bytes for this case.
-			memcpy(stream, &backend->sample_buffer[0], len);
+			if (!backend->ringBuffer.read(stream, len))
+			{
+				// No data, just output a bit of silence for the underrun
+				memset(stream, 0, len);
+				backend->underruns++;
+			}
 		}
 		else
 		{
 			SDL_AudioCVT& cvt = backend->audioCvt;
 			cvt.len = islen * sizeof(uint32_t);
-			memcpy(cvt.buf, &backend->sample_buffer[0], cvt.len);
-			SDL_ConvertAudio(&cvt);
-			memcpy(stream, cvt.buf, cvt.len_cvt);
+			if (backend->ringBuffer.read(cvt.buf, cvt.len))
+			{
+				SDL_ConvertAudio(&cvt);
+				memcpy(stream, cvt.buf, cvt.len_cvt);
+			}
+			else
+			{
+				memset(stream, 0, len);
+				backend->underruns++;
+			}
 		}
-
-		// Move samples in the buffer and consume them
-		memmove(&backend->sample_buffer[0], &backend->sample_buffer[islen], (backend->sample_count - islen) * sizeof(uint32_t));
-		backend->sample_count -= islen;
-
-		backend->stream_mutex.unlock();
 		backend->read_wait.Set();
 	}
 
@@ -79,8 +72,8 @@ public:
 		}
 	
 		sample_buffer_size = std::max<u32>(SAMPLE_COUNT * 2, config::AudioBufferSize);
-		sample_buffer = new uint32_t[sample_buffer_size]();
-		sample_count = 0;
+		// Actual capacity is size-1 to avoid overrun so add one frame
+		ringBuffer.setCapacity((sample_buffer_size + 1) * sizeof(uint32_t));
 
 		// Support 44.1KHz (native) but also upsampling to 48KHz
 		SDL_AudioSpec wav_spec, out_spec;
@@ -129,26 +122,20 @@ public:
 		if (SDL_GetAudioDeviceStatus(audiodev) != SDL_AUDIO_PLAYING)
 			SDL_PauseAudioDevice(audiodev, 0);
 
-		// If wait, then wait for the buffer to be smaller than a certain size.
-		stream_mutex.lock();
-		if (wait) {
-			while (sample_count + samples > sample_buffer_size) {
-				stream_mutex.unlock();
-				read_wait.Wait();
-				stream_mutex.lock();
-			}
-		}
-
-		// Copy as many samples as possible, drop any remaining (this should not happen usually)
-		unsigned free_samples = sample_buffer_size - sample_count;
-		unsigned tocopy = samples < free_samples ? samples : free_samples;
-		memcpy(&sample_buffer[sample_count], frame, tocopy * sizeof(uint32_t));
-		sample_count += tocopy;
-		stream_mutex.unlock();
+		// If wait, then wait for the buffer to have enough room. Otherwise drop the samples.
+		while (!ringBuffer.write((const u8 *)frame, samples * sizeof(uint32_t)) && wait)
+			read_wait.Wait();
 
 		return 1;
 	}
 
+	bool getBufferStatus(u32& queued, u32& capacity) override
+	{
+		queued = ringBuffer.readSize() / sizeof(uint32_t);
+		capacity = sample_buffer_size;
+		return true;
+	}
+
 	void term() override
 	{
 		if (audiodev)
@@ -159,8 +146,7 @@ public:
 			SDL_CloseAudioDevice(audiodev);
 			audiodev = SDL_AudioDeviceID();
 		}
-		delete [] sample_buffer;
-		sample_buffer = nullptr;
+		ringBuffer.setCapacity(0);
 		if (needs_resampling)
 		{
 			delete [] audioCvt.buf;
@@ -1,6 +1,8 @@
 #include "audiostream.h"
+#include "resampler.h"
 #include "cfg/option.h"
 #include "emulator.h"
+#include "oslib/oslib.h"
 
 static void registerForEvents();
 
@@ -15,6 +17,24 @@ std::vector<AudioBackend *> *AudioBackend::backends;
 static bool audio_recording_started;
 static bool eight_khz;
 
+//
+// Dynamic rate control
+// The output is slightly resampled to keep the backend buffer half full, so that pushing samples
+// never blocks nor underruns when the emulator is paced by vsync instead of audio.
+//
+// Max pitch deviation, inaudible
+constexpr double MaxRateDelta = 0.005;
+static Resampler resampler;
+// Room for the frames left over from the previous call plus a full resampled block,
+// so that the resampler always consumes all its input
+static SoundFrame ResampledBuffer[SAMPLE_COUNT * 3];
+static u32 resampledCount;
+static double avgFill = 0.5;
+
+static AudioStats audioStats { -1.f };
+static u32 lastUnderruns;
+static u64 statsTime;
+
 AudioBackend *AudioBackend::getBackend(const std::string& slug)
 {
 	if (backends == nullptr)
@@ -48,6 +68,60 @@ AudioBackend *AudioBackend::getBackend(const std::string& slug)
 	return nullptr;
 }
 
+static void resetRateControl()
+{
+	resampler.reset();
+	resampler.setRatio(1.0);
+	resampledCount = 0;
+	avgFill = 0.5;
+}
+
+static void updateStats(u32 queued, u32 capacity)
+{
+	audioStats.latency = capacity == 0 ? -1.f : queued * 1000.f / 44100.f;
+	audioStats.rateAdjust = (float)((resampler.getRatio() - 1.0) * 100.0);
+	const u64 now = getTimeMs();
+	if (now - statsTime < 1000)
+		return;
+	const u32 underruns = currentBackend->getUnderruns();
+	audioStats.underrunsPerSecond = (underruns - lastUnderruns) * 1000 / (now - statsTime);
+	lastUnderruns = underruns;
+	statsTime = now;
+}
+
+static void pushSamples()
+{
+	u32 queued = 0;
+	u32 capacity = 0;
+	if (!currentBackend->getBufferStatus(queued, capacity) || capacity == 0)
+	{
+		updateStats(0, 0);
+		currentBackend->push(Buffer, SAMPLE_COUNT, config::LimitFPS);
+		return;
+	}
+	updateStats(queued, capacity);
+	if (!config::DynamicRateControl)
+	{
+		currentBackend->push(Buffer, SAMPLE_COUNT, config::LimitFPS);
+		return;
+	}
+	// Smooth out the jitter of the backend buffer level (~250 ms time constant)
+	avgFill += ((double)queued / capacity - avgFill) * 0.05;
+	// Produce fewer frames when the buffer is more than half full and more frames when it's less than half full
+	resampler.setRatio(1.0 + MaxRateDelta * std::clamp(1.0 - 2.0 * avgFill, -1.0, 1.0));
+	resampledCount += resampler.process(&Buffer[0].l, SAMPLE_COUNT, &ResampledBuffer[resampledCount].l,
+			std::size(ResampledBuffer) - resampledCount);
+	// The backend is always given SAMPLE_COUNT frames
+	u32 pushed = 0;
+	while (resampledCount - pushed >= SAMPLE_COUNT)
+	{
+		currentBackend->push(&ResampledBuffer[pushed], SAMPLE_COUNT, config::LimitFPS);
+		pushed += SAMPLE_COUNT;
+	}
+	resampledCount -= pushed;
+	memmove(&ResampledBuffer[0], &ResampledBuffer[pushed], resampledCount * sizeof(SoundFrame));
+}
+
 void WriteSample(s16 r, s16 l)
 {
 	Buffer[writePtr].r = r * config::AudioVolume.dbPower();
@@ -56,15 +130,20 @@ void WriteSample(s16 r, s16 l)
 	if (++writePtr == SAMPLE_COUNT)
 	{
 		if (currentBackend != nullptr)
-			currentBackend->push(Buffer, SAMPLE_COUNT, config::LimitFPS);
+			pushSamples();
 		writePtr = 0;
 	}
 }
 
+AudioStats getAudioStats() {
+	return audioStats;
+}
+
 void InitAudio()
 {
 	registerForEvents();
 	TermAudio();
+	resetRateControl();
 
 	std::string slug = config::AudioBackend;
 	currentBackend = AudioBackend::getBackend(slug);
@@ -116,6 +195,7 @@ void TermAudio()
 	currentBackend->term();
 	INFO_LOG(AUDIO, "Terminating audio backend \"%s\" (%s)...", currentBackend->slug.c_str(), currentBackend->getName().c_str());
 	currentBackend = nullptr;
+	audioStats = { -1.f };
 }
 
 void StartAudioRecording(bool eight_khz)
@@ -152,6 +232,7 @@ static void registerForEvents()
 	// Empty the audio buffer when loading a state or terminating the game
 	const auto& callback = [](Event, void *) {
 		writePtr = 0;
+		resetRateControl();
 	};
 	EventManager::listen(Event::Terminate, callback);
 	EventManager::listen(Event::LoadState, callback);
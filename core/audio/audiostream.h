@@ -30,6 +30,12 @@ public:
 		return nullptr;
 	}
 
+	// Number of frames waiting to be played and capacity of the playback buffer, in frames.
+	// Only backends implementing this support dynamic rate control.
+	virtual bool getBufferStatus(u32& queued, u32& capacity) { return false; }
+	// Number of times the playback buffer ran out of frames
+	u32 getUnderruns() const { return underruns; }
+
 	virtual bool initRecord(u32 sampling_freq) { return false; }
 	virtual u32 record(void *, u32) { return 0; }
 	virtual void termRecord() {}
@@ -47,6 +53,7 @@ protected:
 		registerAudioBackend(this);
 	}
 	std::string name;
+	std::atomic<u32> underruns {};
 
 private:
 	static void registerAudioBackend(AudioBackend *backend)
@@ -70,20 +77,31 @@ void StopAudioRecording();
 
 constexpr u32 SAMPLE_COUNT = 512;	// AudioBackend::push() is always called with that many frames
 
+struct AudioStats
+{
+	float latency;				// Audio waiting to be played, in ms. Negative if unknown
+	float rateAdjust;			// Pitch adjustment of the dynamic rate control, in percent
+	u32 underrunsPerSecond;		// Playback buffer underruns during the last second
+};
+AudioStats getAudioStats();
+
 class RingBuffer
 {
 	std::vector<u8> buffer;
 	std::atomic_int readCursor { 0 };
 	std::atomic_int writeCursor { 0 };
 
+public:
 	u32 readSize() {
 		return (u32)((writeCursor - readCursor + buffer.size()) % buffer.size());
 	}
 	u32 writeSize() {
 		return (u32)((readCursor - writeCursor + buffer.size() - 1) % buffer.size());
 	}
+	u32 capacity() const {
+		return buffer.empty() ? 0 : (u32)buffer.size() - 1;
+	}
 
-public:
 	bool write(const u8 *data, u32 size)
 	{
 		if (size > writeSize())
@@ -0,0 +1,127 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "resampler.h"
+#include <algorithm>
+#include <cmath>
+
+float Resampler::coefs[Phases + 1][Taps];
+
+// Zeroth order modified Bessel function of the first kind
+static double besselI0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 32; k++)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+void Resampler::initCoefs()
+{
+	// Kaiser window
+	constexpr double Beta = 8.0;
+	const double i0Beta = besselI0(Beta);
+	constexpr double HalfWidth = Taps / 2;
+
+	for (int phase = 0; phase <= Phases; phase++)
+	{
+		const double frac = (double)phase / Phases;
+		double sum = 0.0;
+		for (int k = 0; k < Taps; k++)
+		{
+			// Distance between the tap and the output position
+			const double x = k - (Taps / 2 - 1) - frac;
+			const double sinc = x == 0.0 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+			const double r = x / HalfWidth;
+			const double window = r * r < 1.0 ? besselI0(Beta * std::sqrt(1.0 - r * r)) / i0Beta : 0.0;
+			coefs[phase][k] = (float)(sinc * window);
+			sum += coefs[phase][k];
+		}
+		// Unity gain
+		for (int k = 0; k < Taps; k++)
+			coefs[phase][k] = (float)(coefs[phase][k] / sum);
+	}
+}
+
+Resampler::Resampler()
+{
+	static const bool initialized = (initCoefs(), true);
+	(void)initialized;
+	reset();
+}
+
+void Resampler::reset()
+{
+	// The first output frame is centered on the first input frame
+	left.assign(Taps / 2 - 1, 0.f);
+	right.assign(Taps / 2 - 1, 0.f);
+	position = 0;
+}
+
+void Resampler::setRatio(double ratio)
+{
+	step = 1.0 / ratio;
+}
+
+u32 Resampler::process(const s16 *in, u32 inFrames, s16 *out, u32 maxOutFrames)
+{
+	for (u32 i = 0; i < inFrames; i++)
+	{
+		left.push_back(in[i * 2]);
+		right.push_back(in[i * 2 + 1]);
+	}
+	u32 outFrames = 0;
+	while (outFrames < maxOutFrames)
+	{
+		const int base = (int)position;
+		if (base + Taps > (int)left.size())
+			break;
+		const float phase = (float)(position - base) * Phases;
+		const int p = std::min((int)phase, Phases - 1);
+		const float t = phase - p;
+		const float *c0 = coefs[p];
+		const float *c1 = coefs[p + 1];
+		const float *l = &left[base];
+		const float *r = &right[base];
+		float suml = 0.f;
+		float sumr = 0.f;
+		for (int k = 0; k < Taps; k++)
+		{
+			const float c = c0[k] + t * (c1[k] - c0[k]);
+			suml += l[k] * c;
+			sumr += r[k] * c;
+		}
+		out[outFrames * 2] = (s16)std::clamp(std::lround(suml), -32768l, 32767l);
+		out[outFrames * 2 + 1] = (s16)std::clamp(std::lround(sumr), -32768l, 32767l);
+		outFrames++;
+		position += step;
+	}
+	// Discard the input frames that won't be used anymore
+	const int consumed = std::min((int)position, (int)left.size());
+	left.erase(left.begin(), left.begin() + consumed);
+	right.erase(right.begin(), right.begin() + consumed);
+	position -= consumed;
+
+	return outFrames;
+}
@@ -0,0 +1,58 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "types.h"
+#include <vector>
+
+//
+// Windowed-sinc fractional resampler for interleaved stereo 16-bit frames.
+// The ratio can be changed between calls without discontinuity, which is used for dynamic rate control.
+// The filter cutoff is at the input Nyquist frequency so it's meant for ratios close to 1.
+//
+class Resampler
+{
+public:
+	// Filter length in input frames. Half of it is held back until the following input frames are available.
+	static constexpr int Taps = 32;
+
+	Resampler();
+
+	void reset();
+	// Number of output frames per input frame
+	void setRatio(double ratio);
+	double getRatio() const { return 1.0 / step; }
+
+	// Resample the input frames into the output buffer. Input frames that can't be processed yet are kept for the next call.
+	// Returns the number of output frames.
+	u32 process(const s16 *in, u32 inFrames, s16 *out, u32 maxOutFrames);
+
+private:
+	static constexpr int Phases = 128;
+
+	// Coefficients for each fractional position, with one extra phase for interpolation
+	static float coefs[Phases + 1][Taps];
+	static void initCoefs();
+
+	// Input frames, left and right channels deinterleaved
+	std::vector<float> left;
+	std::vector<float> right;
+	// Position of the next output frame in the input, relative to the first input frame
+	double position = 0;
+	double step = 1.0;
+};
@@ -25,6 +25,8 @@ namespace config {
 // Dynarec
 
 Option<bool> DynarecEnabled("Dynarec.Enabled", true);
+Option<bool> DynarecPersistentCache("Dynarec.PersistentCache");
+Option<bool> DynarecBackgroundCompile("Dynarec.BackgroundCompile");
 Option<int> Sh4Clock("Sh4Clock", 200);
 
 // General
@@ -37,6 +39,10 @@ OptionString UILanguage("UILanguage", "");
 Option<bool> AutoLoadState("Dreamcast.AutoLoadState");
 Option<bool> AutoSaveState("Dreamcast.AutoSaveState");
 Option<int, false> SavestateSlot("Dreamcast.SavestateSlot");
+Option<bool, false> SavestateZstd("Dreamcast.SavestateZstd");
+Option<bool, false> IncrementalSavestates("Dreamcast.IncrementalSavestates");
+Option<bool, false> Rewind("Dreamcast.Rewind");
+Option<int, false> RewindBufferSize("Dreamcast.RewindBufferSize", 256);
 Option<bool> ForceFreePlay("ForceFreePlay", true);
 Option<bool, false> FetchBoxart("FetchBoxart", true);
 Option<bool, false> BoxartDisplayMode("BoxartDisplayMode", true);
@@ -46,6 +52,8 @@ Option<int, false> UITheme("UITheme", 0);
 // Sound
 
 Option<bool> DSPEnabled("aica.DSPEnabled", false);
+Option<bool> ThreadedAudio("aica.ThreadedAudio", false);
+Option<bool> DynamicRateControl("aica.DynamicRateControl", false);
 #if HOST_CPU == CPU_ARM
 Option<int> AudioBufferSize("aica.BufferSize", 5644);	// 128 ms
 #else
@@ -110,6 +118,9 @@ Option<int64_t> PixelBufferSize("rend.PixelBufferSize", 512_MB);
 Option<int> AnisotropicFiltering("rend.AnisotropicFiltering", 1);
 Option<int> TextureFiltering("rend.TextureFiltering", 0); // Default
 Option<bool> ThreadedRendering("rend.ThreadedRendering", true);
+Option<int> RenderQueueLatency("rend.RenderQueueLatency", 2);
+Option<int> TextureDecodeMode("rend.TextureDecodeMode", 0);
+Option<int> TextureCacheSize("rend.TextureCacheSize", 512);
 Option<bool> DupeFrames("rend.DupeFrames", false);
 Option<int> PerPixelLayers("rend.PerPixelLayers", 32);
 #ifdef TARGET_UWP
@@ -163,6 +174,7 @@ Option<bool> ProfilerEnabled("Profiler.Enabled");
 Option<bool> ProfilerDrawToGUI("Profiler.DrawGUI");
 Option<bool> ProfilerOutputTTY("Profiler.OutputTTY");
 Option<float> ProfilerFrameWarningTime("Profiler.FrameWarningTime", 1.0f / 55.0f);
+Option<bool, false> Telemetry("Telemetry.Enabled");
 
 // Network
 
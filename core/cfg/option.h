@@ -350,6 +350,8 @@ using OptionString = Option<std::string>;
 // Dynarec
 
 extern Option<bool> DynarecEnabled;
+extern Option<bool> DynarecPersistentCache;
+extern Option<bool> DynarecBackgroundCompile;
 #ifndef LIBRETRO
 extern Option<int> Sh4Clock;
 #endif
@@ -364,6 +366,10 @@ extern OptionString UILanguage;
 extern Option<bool> AutoLoadState;
 extern Option<bool> AutoSaveState;
 extern Option<int, false> SavestateSlot;
+extern Option<bool, false> SavestateZstd;
+extern Option<bool, false> IncrementalSavestates;
+extern Option<bool, false> Rewind;
+extern Option<int, false> RewindBufferSize;	// MB
 extern Option<bool> ForceFreePlay;
 extern Option<bool, false> FetchBoxart;
 extern Option<bool, false> BoxartDisplayMode;
@@ -374,6 +380,8 @@ extern Option<int, false> UITheme;          // 0 -> Dark, 1 -> Light, 2 -> Dream
 
 constexpr bool LimitFPS = true;
 extern Option<bool> DSPEnabled;
+extern Option<bool> ThreadedAudio;
+extern Option<bool> DynamicRateControl;
 extern Option<int> AudioBufferSize;	//In samples ,*4 for bytes
 extern Option<bool> AutoLatency;
 
@@ -471,6 +479,9 @@ extern Option<int64_t> PixelBufferSize;
 extern Option<int> AnisotropicFiltering;
 extern Option<int> TextureFiltering; // 0: default, 1: force nearest, 2: force linear
 extern Option<bool> ThreadedRendering;
+extern Option<int> RenderQueueLatency;	// Max number of frames waiting to be rendered
+extern Option<int> TextureCacheSize;	// in MB, 0: no limit
+extern Option<int> TextureDecodeMode;	// 0: on the render thread, 1: threaded, 2: threaded, may use the previous version for one frame
 extern Option<bool> DupeFrames;
 extern Option<bool> NativeDepthInterpolation;
 extern Option<bool> EmulateFramebuffer;
@@ -519,6 +530,7 @@ extern Option<bool> ProfilerEnabled;
 extern Option<bool> ProfilerDrawToGUI;
 extern Option<bool> ProfilerOutputTTY;
 extern Option<float> ProfilerFrameWarningTime;
+extern Option<bool, false> Telemetry;
 
 // Network
 
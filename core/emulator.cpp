@@ -38,9 +38,11 @@
 #include "network/ice.h"
 #include "hw/mem/mem_watch.h"
 #include "network/net_handshake.h"
+#include "rewinder.h"
 #include "serialize.h"
 #include "hw/pvr/pvr.h"
 #include "profiler/fc_profiler.h"
+#include "profiler/telemetry.h"
 #include "oslib/storage.h"
 #include "wsi/context.h"
 #include <chrono>
@@ -734,7 +736,10 @@ void Emulator::runInternal()
 				}
 			} while (resetRequested);
 		}
+		// The audio thread must not be running when the audio backend is terminated
+		aica::sync();
 	} catch (...) {
+		aica::sync();
 		runner.term();
 		throw;
 	}
@@ -764,6 +769,7 @@ void Emulator::unloadGame()
 		settings.content.reset();
 		settings.platform.system = DC_PLATFORM_DREAMCAST;
 		custom_texture.terminate();
+		rewinder::term();
 		state = Init;
 		EventManager::event(Event::Terminate);
 	}
@@ -968,6 +974,8 @@ void Emulator::run()
 		runInternal();
 		if (ggpo::active())
 			ggpo::nextFrame();
+		else
+			rewinder::nextFrame();
 	} catch (const std::exception& e) {
 		ERROR_LOG(COMMON, "Exception: %s", e.what());
 		setNetworkState(false);
@@ -994,6 +1002,7 @@ void Emulator::start()
 	setupPtyPipe();
 
 	memwatch::protect();
+	telemetry::setEnabled(config::Telemetry);
 
 	if (config::ThreadedRendering)
 	{
@@ -1008,7 +1017,12 @@ void Emulator::start()
 					{
 						startTime = sh4_sched_now64();
 						runInternal();
-						if (!ggpo::nextFrame())
+						if (rewinder::nextFrame())
+						{
+							if (!restartCpu())
+								break;
+						}
+						else if (!ggpo::nextFrame())
 							break;
 					}
 					TermAudio();
@@ -1090,6 +1104,8 @@ void Emulator::vblank()
 		return;
 	if (ggpo::active())
 		ggpo::endOfFrame();
+	else if (rewinder::active())
+		rewinder::endOfFrame();
 	else if (!config::ThreadedRendering)
 		getSh4Executor()->Stop();
 }
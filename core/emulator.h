@@ -36,7 +36,10 @@ void SaveSettings();
 int flycast_init(int argc, char* argv[]);
 void flycast_term();
 void dc_exit();
+// Savestate files are written asynchronously
 void dc_savestate(int index = 0, const u8 *pngData = nullptr, u32 pngSize = 0);
+// Wait until all savestate files are written
+void dc_waitSavestates();
 void dc_loadstate(int index = 0);
 time_t dc_getStateCreationDate(int index);
 void dc_getStateScreenshot(int index, std::vector<u8>& pngData);
@@ -7,6 +7,15 @@
 #include "hw/sh4/sh4_sched.h"
 #include "hw/arm7/arm7.h"
 #include "hw/arm7/arm_mem.h"
+#include "hw/mem/addrspace.h"
+#include "cfg/option.h"
+#include "oslib/oslib.h"
+#include "profiler/telemetry.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 namespace aica
 {
@@ -15,6 +24,109 @@ namespace aica
 
 std::deque<u8> midiSendBuffer;
 
+//
+// In threaded mode, the arm7, channels and dsp run on a separate thread that lags behind the sh4
+// by at most MaxLag samples. The sh4 waits for the audio thread to catch up before accessing
+// the aica registers or RAM, or serializing its state, so these accesses see the same state as in
+// synchronous mode. Interrupts raised by the aica are forwarded to the sh4 at the next sync point.
+// While the thread is running, area 0 aica RAM is protected so that fast memory accesses by the
+// sh4 fault and are rewritten to use the area 0 handlers, which sync.
+//
+class AudioThread
+{
+public:
+	// Samples generated per sh4 sync point
+	static constexpr u32 SyncSamples = 16;
+	// Max number of samples the audio thread can lag behind
+	static constexpr u32 MaxLag = 256;
+
+	~AudioThread() {
+		stop();
+	}
+
+	void start()
+	{
+		if (thread.joinable())
+			return;
+		exiting = false;
+		target = done = 0;
+		addrspace::protectAram();
+		thread = std::thread([this]() { loop(); });
+	}
+
+	void stop()
+	{
+		if (!thread.joinable())
+			return;
+		{
+			std::lock_guard<std::mutex> _(mutex);
+			exiting = true;
+		}
+		wakeup.notify_one();
+		thread.join();
+		addrspace::unprotectAram();
+	}
+
+	bool isRunning() const {
+		return thread.joinable();
+	}
+
+	bool isCurrent() const {
+		return std::this_thread::get_id() == thread.get_id();
+	}
+
+	// Called by the sh4 thread to generate more samples
+	void queue(u32 samples)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		target += samples;
+		wakeup.notify_one();
+		caughtUp.wait(lock, [this]() { return target - done <= MaxLag; });
+	}
+
+	// Wait until all queued samples have been generated
+	void sync()
+	{
+		// target is only modified by the sh4 thread
+		if (done.load(std::memory_order_acquire) == target)
+			return;
+		std::unique_lock<std::mutex> lock(mutex);
+		caughtUp.wait(lock, [this]() { return done == target; });
+	}
+
+private:
+	void loop()
+	{
+		ThreadName _("AICA");
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			// pending samples are always generated before exiting
+			wakeup.wait(lock, [this]() { return done != target || exiting; });
+			if (done == target)
+				break;
+			u32 samples = std::min<u64>(target - done, SyncSamples);
+			lock.unlock();
+			{
+				TELEMETRY_SCOPE(AicaRun);
+				arm::run(samples);
+			}
+			lock.lock();
+			done += samples;
+			caughtUp.notify_one();
+		}
+	}
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	std::condition_variable caughtUp;
+	u64 target = 0;
+	std::atomic<u64> done = 0;
+	bool exiting = false;
+};
+static AudioThread audioThread;
+
 //Interrupts
 //arm side
 static u32 GetL(u32 which)
@@ -65,6 +177,9 @@ static void update_arm_interrupts()
 static bool UpdateSh4Ints()
 {
 	u32 p_ints = MCIEB->full & MCIPD->full;
+	// The sh4 interrupt is updated by the sh4 thread at each sync point
+	if (audioThread.isCurrent())
+		return p_ints != 0;
 	if (p_ints)
 	{
 		if ((SB_ISTEXT & SH4_IRQ_BIT) == 0)
@@ -86,9 +201,33 @@ constexpr int AICA_TICK = 4535;		// 44.1 KHz
 
 static int AicaUpdate(int tag, int cycles, int jitter, void *arg)
 {
-	arm::run(1);
+	// Not deterministic enough for netplay
+	if (!config::ThreadedAudio || config::GGPOEnable)
+	{
+		if (audioThread.isRunning())
+		{
+			audioThread.stop();
+			UpdateSh4Ints();
+		}
+		TELEMETRY_SCOPE(AicaRun);
+		arm::run(1);
+
+		return AICA_TICK;
+	}
+	audioThread.start();
+	audioThread.queue(AudioThread::SyncSamples);
+	UpdateSh4Ints();
+
+	return AICA_TICK * AudioThread::SyncSamples;
+}
 
-	return AICA_TICK;
+void sync()
+{
+	if (audioThread.isRunning() && !audioThread.isCurrent())
+	{
+		audioThread.sync();
+		UpdateSh4Ints();
+	}
 }
 
 //Mainloop
@@ -258,6 +397,7 @@ void init()
 
 void reset(bool hard)
 {
+	audioThread.stop();
 	if (hard)
 	{
 		initMem();
@@ -273,6 +413,7 @@ void reset(bool hard)
 
 void term()
 {
+	audioThread.stop();
 	arm::term();
 	sgc::term();
 	termMem();
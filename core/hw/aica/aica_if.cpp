@@ -111,6 +111,7 @@ template void writeRtcReg<>(u32 addr, u32 data);
 template<typename T>
 T readAicaReg(u32 addr)
 {
+	sync();
 	addr &= 0x7FFF;
 	if (sizeof(T) == 1)
 	{
@@ -145,6 +146,7 @@ static void ArmSetRST()
 template<typename T>
 void writeAicaReg(u32 addr, T data)
 {
+	sync();
 	addr &= 0x7FFF;
 
 	if (sizeof(T) == 1)
@@ -395,6 +397,7 @@ static void Write_SB_ADST(u32 addr, u32 data)
 			else
 				DEBUG_LOG(AICA, "AICA-DMA : SB_ADDIR==0:DMA Write to 0x%X from 0x%X %x bytes", dst, src, SB_ADLEN);
 
+			sync();
 			WriteMemBlock_nommu_dma(dst, src, len);
 
 			// indicate that dma is in progress
@@ -513,6 +516,7 @@ void sbTerm()
 
 void serialize(Serializer& ser)
 {
+	sync();
 	ser << arm::aica_interr;
 	ser << arm::aica_reg_L;
 	ser << arm::e68k_out;
@@ -548,6 +552,7 @@ void serialize(Serializer& ser)
 
 void deserialize(Deserializer& deser)
 {
+	sync();
 	deser >> arm::aica_interr;
 	deser >> arm::aica_reg_L;
 	deser >> arm::e68k_out;
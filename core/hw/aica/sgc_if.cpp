@@ -27,10 +27,22 @@
 #include "hw/gdrom/gdrom_if.h"
 #include "cfg/option.h"
 #include "serialize.h"
+#include "profiler/telemetry.h"
 
 #include <algorithm>
 #include <cmath>
 
+#if HOST_CPU == CPU_X64 || (HOST_CPU == CPU_X86 && defined(__SSE2__))
+#include <emmintrin.h>
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+#define SGC_SSE2 1
+#elif HOST_CPU == CPU_ARM64 || (HOST_CPU == CPU_ARM && defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define SGC_NEON 1
+#endif
+
 #undef FAR
 
 //#define CLIP_WARN
@@ -642,12 +654,11 @@ struct ChannelEx
 		return sample;
 	}
 
-	bool Step(SampleType& oLeft, SampleType& oRight, SampleType& oDsp)
+	// Add the channel output to the next lane of the row
+	void Step(ChannelRow& row, bool dspEnabled)
 	{
-		if (!enabled) {
-			oLeft = oRight = oDsp = 0;
-			return false;
-		}
+		if (!enabled)
+			return;
 
 		SampleType sample = InterpolateSample() << 4;
 		sample = lowPassFilter(sample);
@@ -678,16 +689,18 @@ struct ChannelEx
 		u32 dr = std::min(VolMix.DRAtt, max_att);
 		u32 ds = std::min(VolMix.DSPAtt, max_att);
 
-		oLeft = FPMul<s64>(sample, logtable[dl], 19);	// 16 bits
-		oRight = FPMul<s64>(sample, logtable[dr], 19);	// 16 bits
-		oDsp = FPMul<s64>(sample, logtable[ds], 15);	// 20 bits
-
-		clip_verify((s16)oLeft == oLeft);
-		clip_verify((s16)oRight == oRight);
+		// The dsp send is needed now. Left and right outputs are computed later by mixChannels()
+		SampleType oDsp = FPMul<s64>(sample, logtable[ds], 15);	// 20 bits
 		clip_verify((oDsp << 12) >> 12 == oDsp);
-		clip_verify((s64)sample * oLeft >= 0);
-		clip_verify((s64)sample * oRight >= 0);
 		clip_verify((s64)sample * oDsp >= 0);
+		*VolMix.DSPOut += oDsp;
+
+		const u32 lane = row.channels++;
+		row.sample[lane] = sample;
+		row.attLeft[lane] = logtable[dl];
+		row.attRight[lane] = logtable[dr];
+		// Without dsp, channels with no direct output are heard through their dsp send
+		row.attDsp[lane] = dspEnabled ? 0 : logtable[ds];
 
 		(this->*StepAEG)();
 		if (enabled)
@@ -696,27 +709,17 @@ struct ChannelEx
 			(this->*StepStream)();
 			lfo.Step();
 		}
-		return true;
-	}
-
-	void Step(SampleType& mixl, SampleType& mixr)
-	{
-		SampleType oLeft, oRight, oDsp;
-
-		Step(oLeft, oRight, oDsp);
-
-		*VolMix.DSPOut += oDsp;
-		if (oLeft + oRight == 0 && !config::DSPEnabled)
-			oLeft = oRight = oDsp >> 4;
-
-		mixl += oLeft;
-		mixr += oRight;
 	}
 
-	static void StepAll(SampleType& mixl, SampleType& mixr)
+	static void StepAll(ChannelRow& row)
 	{
+		const bool dspEnabled = config::DSPEnabled;
+		row.channels = 0;
 		for (ChannelEx& channel : Chans)
-			channel.Step(mixl, mixr);
+			channel.Step(row, dspEnabled);
+		// Pad the last group of lanes
+		for (u32 i = row.channels; i < ((row.channels + 3) & ~3); i++)
+			row.sample[i] = 0;
 	}
 
 	void SetAegState(EGState newstate)
@@ -1549,14 +1552,196 @@ constexpr int CDDA_SIZE = 2352 / 2;
 static s16 cdda_sector[CDDA_SIZE];
 static u32 cdda_index = CDDA_SIZE;
 
+void stepChannels(ChannelRow& row) {
+	ChannelEx::StepAll(row);
+}
+
+//
+// Left and right channel outputs are mixed in batches, 4 channels at a time.
+// The products of samples (20 bits) and attenuations (up to 1 << 15) need more than 32 bits,
+// so (sample * att) >> 19 is computed in two halves of att, giving the same result as the 64-bit version.
+//
+#ifdef SGC_SSE2
+
+static inline __m128i mullo32(__m128i a, __m128i b)
+{
+#ifdef __SSE4_1__
+	return _mm_mullo_epi32(a, b);
+#else
+	const __m128i even = _mm_mul_epu32(a, b);
+	const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+			_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+
+static inline __m128i attenuate(__m128i sample, __m128i att)
+{
+	const __m128i hi = mullo32(sample, _mm_srli_epi32(att, 8));
+	const __m128i lo = mullo32(sample, _mm_and_si128(att, _mm_set1_epi32(0xff)));
+	const __m128i carry = _mm_add_epi32(_mm_slli_epi32(_mm_and_si128(hi, _mm_set1_epi32(0x7ff)), 8), lo);
+	return _mm_add_epi32(_mm_srai_epi32(hi, 11), _mm_srai_epi32(carry, 19));
+}
+
+static inline s32 horizontalSum(__m128i v)
+{
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(v);
+}
+
+static void mixRow(const ChannelRow& row, SampleType& left, SampleType& right)
+{
+	__m128i sumLeft = _mm_setzero_si128();
+	__m128i sumRight = _mm_setzero_si128();
+	for (u32 i = 0; i < row.channels; i += 4)
+	{
+		const __m128i sample = _mm_load_si128((const __m128i *)&row.sample[i]);
+		__m128i l = attenuate(sample, _mm_load_si128((const __m128i *)&row.attLeft[i]));
+		__m128i r = attenuate(sample, _mm_load_si128((const __m128i *)&row.attRight[i]));
+		const __m128i d = attenuate(sample, _mm_load_si128((const __m128i *)&row.attDsp[i]));
+		const __m128i silent = _mm_cmpeq_epi32(_mm_or_si128(l, r), _mm_setzero_si128());
+		l = _mm_or_si128(_mm_and_si128(silent, d), _mm_andnot_si128(silent, l));
+		r = _mm_or_si128(_mm_and_si128(silent, d), _mm_andnot_si128(silent, r));
+		sumLeft = _mm_add_epi32(sumLeft, l);
+		sumRight = _mm_add_epi32(sumRight, r);
+	}
+	left = horizontalSum(sumLeft);
+	right = horizontalSum(sumRight);
+}
+
+#elif defined(SGC_NEON)
+
+static inline int32x4_t attenuate(int32x4_t sample, int32x4_t att)
+{
+	const int32x4_t hi = vmulq_s32(sample, vshrq_n_s32(att, 8));
+	const int32x4_t lo = vmulq_s32(sample, vandq_s32(att, vdupq_n_s32(0xff)));
+	const int32x4_t carry = vaddq_s32(vshlq_n_s32(vandq_s32(hi, vdupq_n_s32(0x7ff)), 8), lo);
+	return vaddq_s32(vshrq_n_s32(hi, 11), vshrq_n_s32(carry, 19));
+}
+
+static inline s32 horizontalSum(int32x4_t v)
+{
+	const int32x2_t sum = vadd_s32(vget_low_s32(v), vget_high_s32(v));
+	return vget_lane_s32(vpadd_s32(sum, sum), 0);
+}
+
+static void mixRow(const ChannelRow& row, SampleType& left, SampleType& right)
+{
+	int32x4_t sumLeft = vdupq_n_s32(0);
+	int32x4_t sumRight = vdupq_n_s32(0);
+	for (u32 i = 0; i < row.channels; i += 4)
+	{
+		const int32x4_t sample = vld1q_s32(&row.sample[i]);
+		int32x4_t l = attenuate(sample, vld1q_s32(&row.attLeft[i]));
+		int32x4_t r = attenuate(sample, vld1q_s32(&row.attRight[i]));
+		const int32x4_t d = attenuate(sample, vld1q_s32(&row.attDsp[i]));
+		const uint32x4_t silent = vceqq_s32(vorrq_s32(l, r), vdupq_n_s32(0));
+		l = vbslq_s32(silent, d, l);
+		r = vbslq_s32(silent, d, r);
+		sumLeft = vaddq_s32(sumLeft, l);
+		sumRight = vaddq_s32(sumRight, r);
+	}
+	left = horizontalSum(sumLeft);
+	right = horizontalSum(sumRight);
+}
+
+#else
+
+static void mixRow(const ChannelRow& row, SampleType& left, SampleType& right)
+{
+	left = right = 0;
+	for (u32 i = 0; i < row.channels; i++)
+	{
+		SampleType l = FPMul<s64>(row.sample[i], row.attLeft[i], 19);
+		SampleType r = FPMul<s64>(row.sample[i], row.attRight[i], 19);
+		if (l + r == 0)
+			l = r = FPMul<s64>(row.sample[i], row.attDsp[i], 19);
+		left += l;
+		right += r;
+	}
+}
+
+#endif
+
+void mixChannels(const ChannelRow *rows, u32 count, SampleType *left, SampleType *right)
+{
+	for (u32 i = 0; i < count; i++)
+		mixRow(rows[i], left[i], right[i]);
+}
+
+// Samples are output in batches of BatchSize
+constexpr u32 BatchSize = 32;
+struct OutputSample
+{
+	// cdda, dsp effects and vmu beep
+	SampleType left;
+	SampleType right;
+	u32 mvol;
+	bool mono;
+	bool dac18b;
+	bool muted;
+};
+static ChannelRow batchRows[BatchSize];
+static OutputSample batchOutput[BatchSize];
+static u32 batchCount;
+
+static void outputBatch()
+{
+	SampleType channelsLeft[BatchSize];
+	SampleType channelsRight[BatchSize];
+	mixChannels(batchRows, batchCount, channelsLeft, channelsRight);
+
+	for (u32 i = 0; i < batchCount; i++)
+	{
+		const OutputSample& out = batchOutput[i];
+		if (out.muted)
+			continue;
+		SampleType mixl = channelsLeft[i] + out.left;
+		SampleType mixr = channelsRight[i] + out.right;
+
+		// Mono
+		if (out.mono)
+			mixl = mixr = FPs(mixl + mixr, 1);
+
+		//MVOL !
+		//we want to make sure mix* is *At least* 23 bits wide here, so 64 bit mul !
+		s32 val = volume_lut[out.mvol];
+		mixl = (s32)FPMul<s64>(mixl, val, 15);
+		mixr = (s32)FPMul<s64>(mixr, val, 15);
+
+		if (out.dac18b)
+		{
+			//If 18 bit output , make it 16b :p
+			mixl = FPs(mixl, 2);
+			mixr = FPs(mixr, 2);
+		}
+
+		//Sample is ready ! clip/saturate and store :}
+
+#ifdef CLIP_WARN
+		if ((s16)mixl != mixl || (s16)mixr != mixr)
+			printf("Clipped mixl %d mixr %d\n", mixl, mixr);
+#endif
+
+		mixl = std::clamp(mixl, -32768, 32767);
+		mixr = std::clamp(mixr, -32768, 32767);
+
+		WriteSample(mixr, mixl);
+	}
+	batchCount = 0;
+}
+
 void AICA_Sample()
 {
+	TELEMETRY_SCOPE(AicaSample);
 	SampleType mixl,mixr;
 	mixl = 0;
 	mixr = 0;
 	memset(dsp::state.MIXS, 0, sizeof(dsp::state.MIXS));
 
-	ChannelEx::StepAll(mixl,mixr);
+	// The channel outputs are mixed when the batch is full
+	ChannelEx::StepAll(batchRows[batchCount]);
 	
 	//OK , generated all Channels  , now DSP/ect + final mix ;p
 	//CDDA EXTS input
@@ -1588,49 +1773,26 @@ void AICA_Sample()
 			VolumePan(*(s16*)&DSPData->EFREG[i], dsp_out_vol[i].EFSDL, dsp_out_vol[i].EFPAN, mixl, mixr);
 	}
 
+	OutputSample& out = batchOutput[batchCount];
 #ifdef LIBRETRO
-	if (settings.aica.muteAudio)
+	out.muted = settings.aica.muteAudio;
 #else
-	if (settings.input.fastForwardMode || settings.aica.muteAudio)
+	out.muted = settings.input.fastForwardMode || settings.aica.muteAudio;
 #endif
-		return;
-
-	if (config::VmuSound)
+	if (!out.muted && config::VmuSound)
 	{
 		SampleType b = beep.getSample();
 		mixl += b;
 		mixr += b;
 	}
-
-	// Mono
-	if (CommonData->Mono)
-		mixl = mixr = FPs(mixl + mixr, 1);
-	
-	//MVOL !
-	//we want to make sure mix* is *At least* 23 bits wide here, so 64 bit mul !
-	u32 mvol = CommonData->MVOL;
-	s32 val = volume_lut[mvol];
-	mixl = (s32)FPMul<s64>(mixl, val, 15);
-	mixr = (s32)FPMul<s64>(mixr, val, 15);
-
-	if (CommonData->DAC18B)
-	{
-		//If 18 bit output , make it 16b :p
-		mixl = FPs(mixl, 2);
-		mixr = FPs(mixr, 2);
-	}
-
-	//Sample is ready ! clip/saturate and store :}
-
-#ifdef CLIP_WARN
-	if ((s16)mixl != mixl || (s16)mixr != mixr)
-		printf("Clipped mixl %d mixr %d\n", mixl, mixr);
-#endif
-
-	mixl = std::clamp(mixl, -32768, 32767);
-	mixr = std::clamp(mixr, -32768, 32767);
-
-	WriteSample(mixr, mixl);
+	out.left = mixl;
+	out.right = mixr;
+	out.mono = CommonData->Mono;
+	out.mvol = CommonData->MVOL;
+	out.dac18b = CommonData->DAC18B;
+
+	if (++batchCount == BatchSize)
+		outputBatch();
 }
 
 void serialize(Serializer& ser)
@@ -1671,6 +1833,8 @@ void serialize(Serializer& ser)
 
 void deserialize(Deserializer& deser)
 {
+	// Drop the samples of the batch in progress
+	batchCount = 0;
 	for (ChannelEx& channel : Chans)
 	{
 		channel.quiet = true;
@@ -41,6 +41,22 @@ union fp_20_12
 
 typedef s32 SampleType;
 
+// Output of the playing channels for one sample, in structure-of-arrays layout
+struct ChannelRow
+{
+	u32 channels;
+	alignas(16) SampleType sample[64];
+	alignas(16) s32 attLeft[64];
+	alignas(16) s32 attRight[64];
+	// Replaces the left and right attenuations when both outputs are silent
+	alignas(16) s32 attDsp[64];
+};
+
+// Step all channels by one sample and add their dsp sends to MIXS
+void stepChannels(ChannelRow& row);
+// Mix the channels of each row into left and right
+void mixChannels(const ChannelRow *rows, u32 count, SampleType *left, SampleType *right);
+
 void ReadCommonReg(u32 reg, bool byte);
 void serialize(Serializer& ctx);
 void deserialize(Deserializer& ctx);
@@ -124,6 +124,7 @@ T DYNACALL ReadMem_area0(u32 paddr)
 	case 6:
 	case 7:
 		// AICA ram
+		aica::sync();
 		return ReadMemArr<T>(&aica::aica_ram[0], addr & ARAM_MASK);
 
 	default:
@@ -242,6 +243,7 @@ void DYNACALL WriteMem_area0(u32 paddr, T data)
 	case 6:
 	case 7:
 		// AICA ram
+		aica::sync();
 		WriteMemArr(&aica::aica_ram[0], addr & ARAM_MASK, data);
 		return;
 
@@ -519,6 +519,25 @@ void unprotectVram(u32 addr, u32 size)
 	}
 }
 
+// Make the sh4 accesses to aica ram in area 0 fault so that they go through the area 0 handlers
+void protectAram()
+{
+	if (!virtmemEnabled())
+		return;
+	// Each mirror is a different mapping
+	for (u32 addr = 0x00800000; addr < 0x01000000; addr += ARAM_SIZE)
+		virtmem::region_noaccess(ram_base + addr, ARAM_SIZE);
+}
+
+void unprotectAram()
+{
+	if (!virtmemEnabled())
+		return;
+	// Area 0 aica ram is mapped read-only
+	for (u32 addr = 0x00800000; addr < 0x01000000; addr += ARAM_SIZE)
+		virtmem::region_lock(ram_base + addr, ARAM_SIZE);
+}
+
 u32 getVramOffset(void *addr)
 {
 #ifndef __SWITCH__
@@ -79,6 +79,8 @@ bool bm_lockedWrite(u8* address); // FIXME rename?
 
 void protectVram(u32 addr, u32 size);
 void unprotectVram(u32 addr, u32 size);
+void protectAram();
+void unprotectAram();
 u32 getVramOffset(void *addr);
 void getAddress(void** out_ram_base, void** out_ram, void** out_vram, void** out_aica);
 
@@ -0,0 +1,139 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "checkpoint.h"
+#include <cstring>
+
+namespace checkpoint
+{
+
+void History::addKeyframe(const Regions& regions, std::vector<u8>&& state)
+{
+	clear();
+	keyframe.state = std::move(state);
+	keyframeSize = keyframe.state.size();
+	for (int i = 0; i < RegionCount; i++)
+	{
+		keyframe.memory[i].assign(regions[i].data, regions[i].data + regions[i].size);
+		keyframeSize += regions[i].size;
+	}
+}
+
+void History::addDelta(const Regions& regions, const DirtyPages& dirtyPages, std::vector<u8>&& state)
+{
+	verify(!empty());
+	Delta& delta = deltas.emplace_back();
+	delta.state = std::move(state);
+	for (int i = 0; i < RegionCount; i++)
+	{
+		Pages& pages = delta.pages[i];
+		pages.offsets = dirtyPages[i];
+		pages.data.resize(pages.offsets.size() * PAGE_SIZE);
+		u8 *dst = pages.data.data();
+		for (u32 offset : pages.offsets)
+		{
+			verify(offset + PAGE_SIZE <= regions[i].size);
+			memcpy(dst, regions[i].data + offset, PAGE_SIZE);
+			dst += PAGE_SIZE;
+		}
+	}
+	deltaSize += memoryUsage(delta);
+}
+
+const std::vector<u8>& History::restore(size_t index, const Regions& regions)
+{
+	verify(index < size());
+	while (deltas.size() > index)
+	{
+		deltaSize -= memoryUsage(deltas.back());
+		deltas.pop_back();
+	}
+	for (int i = 0; i < RegionCount; i++)
+	{
+		const Region& region = regions[i];
+		verify(region.size == keyframe.memory[i].size());
+		// Copy the most recent version of each page once
+		std::vector<bool> restored(region.size / PAGE_SIZE);
+		for (auto it = deltas.rbegin(); it != deltas.rend(); ++it)
+		{
+			const Pages& pages = it->pages[i];
+			for (size_t j = 0; j < pages.offsets.size(); j++)
+			{
+				u32 page = pages.offsets[j] / PAGE_SIZE;
+				if (restored[page])
+					continue;
+				restored[page] = true;
+				memcpy(region.data + pages.offsets[j], &pages.data[j * PAGE_SIZE], PAGE_SIZE);
+			}
+		}
+		// Then the unmodified pages from the keyframe, in contiguous runs
+		for (size_t page = 0; page < restored.size(); )
+		{
+			if (restored[page]) {
+				page++;
+				continue;
+			}
+			size_t end = page + 1;
+			while (end < restored.size() && !restored[end])
+				end++;
+			memcpy(region.data + page * PAGE_SIZE, &keyframe.memory[i][page * PAGE_SIZE], (end - page) * PAGE_SIZE);
+			page = end;
+		}
+	}
+	return deltas.empty() ? keyframe.state : deltas.back().state;
+}
+
+void History::compact(size_t maxDeltas)
+{
+	while (!deltas.empty() && (deltas.size() > maxDeltas || deltaSize > keyframeSize))
+		rebase();
+}
+
+void History::rebase()
+{
+	// The oldest delta becomes the keyframe
+	Delta& delta = deltas.front();
+	deltaSize -= memoryUsage(delta);
+	for (int i = 0; i < RegionCount; i++)
+	{
+		const Pages& pages = delta.pages[i];
+		for (size_t j = 0; j < pages.offsets.size(); j++)
+			memcpy(&keyframe.memory[i][pages.offsets[j]], &pages.data[j * PAGE_SIZE], PAGE_SIZE);
+	}
+	keyframeSize += delta.state.size() - keyframe.state.size();
+	keyframe.state = std::move(delta.state);
+	deltas.pop_front();
+}
+
+void History::clear()
+{
+	keyframe = {};
+	deltas.clear();
+	keyframeSize = 0;
+	deltaSize = 0;
+}
+
+size_t History::memoryUsage(const Delta& delta)
+{
+	size_t size = delta.state.size();
+	for (const Pages& pages : delta.pages)
+		size += pages.data.size() + pages.offsets.size() * sizeof(u32);
+	return size;
+}
+
+}
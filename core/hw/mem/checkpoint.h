@@ -0,0 +1,93 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "types.h"
+#include "stdclass.h"
+#include <array>
+#include <deque>
+#include <vector>
+
+namespace checkpoint
+{
+
+// Main RAM, VRAM, AICA RAM and Elan RAM
+constexpr int RegionCount = 4;
+
+struct Region
+{
+	u8 *data;
+	u32 size;
+};
+using Regions = std::array<Region, RegionCount>;
+// Offsets of the pages written since the last checkpoint, for each region
+using DirtyPages = std::array<std::vector<u32>, RegionCount>;
+
+//
+// History of emulator states made of a full keyframe followed by incremental deltas.
+// A delta only holds the memory pages written since the previous checkpoint, so its cost is
+// proportional to the number of pages touched. The rest of the emulator state, which is small,
+// is stored as is.
+//
+class History
+{
+public:
+	// Add a full copy of the memory regions. Previous checkpoints are discarded.
+	void addKeyframe(const Regions& regions, std::vector<u8>&& state);
+	// Add a checkpoint holding the current content of the given pages
+	void addDelta(const Regions& regions, const DirtyPages& dirtyPages, std::vector<u8>&& state);
+	// Restore the memory regions to the given checkpoint and return its state.
+	// More recent checkpoints are discarded.
+	const std::vector<u8>& restore(size_t index, const Regions& regions);
+	// Rebase the oldest deltas onto the keyframe until at most maxDeltas are left
+	// and the deltas don't use more memory than the keyframe.
+	void compact(size_t maxDeltas);
+
+	void clear();
+	bool empty() const { return keyframe.state.empty(); }
+	// Number of checkpoints, including the keyframe
+	size_t size() const { return empty() ? 0 : deltas.size() + 1; }
+	size_t memoryUsage() const { return keyframeSize + deltaSize; }
+
+private:
+	struct Pages
+	{
+		std::vector<u32> offsets;
+		std::vector<u8> data;
+	};
+	struct Delta
+	{
+		std::vector<u8> state;
+		std::array<Pages, RegionCount> pages;
+	};
+	struct Keyframe
+	{
+		std::vector<u8> state;
+		std::array<std::vector<u8>, RegionCount> memory;
+	};
+
+	static size_t memoryUsage(const Delta& delta);
+	void rebase();
+
+	Keyframe keyframe;
+	std::deque<Delta> deltas;
+	size_t keyframeSize = 0;
+	size_t deltaSize = 0;
+};
+
+}
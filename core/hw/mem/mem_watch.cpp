@@ -22,10 +22,13 @@
 namespace memwatch
 {
 
+// Must be destroyed after the watchers
+PagePool pagePool;
 VramWatcher vramWatcher;
 RamWatcher ramWatcher;
 AicaRamWatcher aramWatcher;
 ElanRamWatcher elanWatcher;
+Tracking tracking;
 
 void AicaRamWatcher::protectMem(u32 addr, u32 size)
 {
@@ -74,5 +77,33 @@ u32 ElanRamWatcher::getMemOffset(void *p)
 	return (u32)((u8 *)p - RAM);
 }
 
+u8 *PagePool::alloc()
+{
+	std::lock_guard<std::mutex> _(mutex);
+	if (freePages.empty())
+	{
+		u8 *block = blocks.emplace_back(std::make_unique<u8[]>(PagesPerBlock * PAGE_SIZE)).get();
+		for (size_t i = 0; i < PagesPerBlock; i++)
+			freePages.push_back(block + i * PAGE_SIZE);
+	}
+	u8 *page = freePages.back();
+	freePages.pop_back();
+	return page;
+}
+
+void PagePool::release(u8 *page)
+{
+	std::lock_guard<std::mutex> _(mutex);
+	freePages.push_back(page);
 }
 
+void PagePool::trim()
+{
+	std::lock_guard<std::mutex> _(mutex);
+	if (freePages.size() != blocks.size() * PagesPerBlock)
+		return;
+	freePages = std::vector<u8 *>();
+	blocks = std::vector<std::unique_ptr<u8[]>>();
+}
+
+}
@@ -19,6 +19,7 @@
 #pragma once
 #include "types.h"
 #include "addrspace.h"
+#include "checkpoint.h"
 #include "hw/aica/aica_if.h"
 #include "hw/sh4/dyna/blockmanager.h"
 #include "hw/sh4/sh4_mem.h"
@@ -26,14 +27,59 @@
 #include "hw/pvr/elan.h"
 #include "rend/TexCache.h"
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace memwatch
 {
 
+// What written pages are tracked for, outside of GGPO. Cleared by reset()
+enum class Tracking {
+	None,
+	Checkpoints,
+	Rewind
+};
+extern Tracking tracking;
+
+//
+// Page buffers carved out of large blocks and recycled, so that saving the written pages
+// every frame doesn't churn the allocator.
+//
+class PagePool
+{
+public:
+	u8 *alloc();
+	void release(u8 *page);
+	// Free the blocks if no page is in use
+	void trim();
+
+private:
+	static constexpr size_t PagesPerBlock = 256;
+
+	std::vector<std::unique_ptr<u8[]>> blocks;
+	std::vector<u8 *> freePages;
+	std::mutex mutex;
+};
+extern PagePool pagePool;
+
 struct Page
 {
-	std::unique_ptr<u8[]> data = std::make_unique<u8[]>(PAGE_SIZE);
+	Page() : data(pagePool.alloc()) {}
+	Page(Page&& other) noexcept : data(other.data) {
+		other.data = nullptr;
+	}
+	Page& operator=(Page&& other) noexcept {
+		std::swap(data, other.data);
+		return *this;
+	}
+	~Page() {
+		if (data != nullptr)
+			pagePool.release(data);
+	}
+
+	u8 *data;
 };
 using PageMap = std::unordered_map<u32, Page>;
 
@@ -42,10 +88,15 @@ class Watcher
 {
 	bool started;
 	PageMap pages;
+	// Written pages whose previous content isn't needed (checkpoints)
+	std::unordered_set<u32> dirtyPages;
+	// aica RAM can be written by the audio thread
+	std::mutex mutex;
 
 public:
 	void protect()
 	{
+		std::lock_guard<std::mutex> _(mutex);
 		if (!started)
 		{
 			static_cast<T&>(*this).protectMem(0, 0xffffffff);
@@ -55,6 +106,8 @@ public:
 		{
 			for (const auto& pair : pages)
 				static_cast<T&>(*this).protectMem(pair.first, PAGE_SIZE);
+			for (u32 offset : dirtyPages)
+				static_cast<T&>(*this).protectMem(offset, PAGE_SIZE);
 		}
 	}
 
@@ -65,8 +118,10 @@ public:
 
 	void reset()
 	{
+		std::lock_guard<std::mutex> _(mutex);
 		started = false;
 		pages.clear();
+		dirtyPages.clear();
 	}
 
 	bool hit(void *addr)
@@ -75,21 +130,43 @@ public:
 		if (offset == (u32)-1)
 			return false;
 		offset &= ~PAGE_MASK;
-	    auto rv = pages.try_emplace(offset);
-	    if (!rv.second)
-	      // already saved
-	      return true;
-	    Page& page = rv.first->second;
-	    memcpy(&page.data[0], static_cast<T&>(*this).getMemPage(offset), PAGE_SIZE);
+		std::lock_guard<std::mutex> _(mutex);
+		if (tracking == Tracking::Checkpoints)
+		{
+			dirtyPages.insert(offset);
+		}
+		else
+		{
+			auto rv = pages.try_emplace(offset);
+			if (rv.second)
+			{
+				Page& page = rv.first->second;
+				memcpy(&page.data[0], static_cast<T&>(*this).getMemPage(offset), PAGE_SIZE);
+			}
+			// else already saved but protected again since
+		}
 		static_cast<T&>(*this).unprotectMem(offset, PAGE_SIZE);
 		return true;
 	}
 
 	void getPages(PageMap& other)
 	{
+		std::lock_guard<std::mutex> _(mutex);
 		std::swap(pages, other);
 		pages = PageMap();
 	}
+
+	// Offsets of the pages written since the last call
+	std::vector<u32> getDirtyPages()
+	{
+		std::lock_guard<std::mutex> _(mutex);
+		std::vector<u32> offsets(dirtyPages.begin(), dirtyPages.end());
+		for (const auto& pair : pages)
+			offsets.push_back(pair.first);
+		dirtyPages.clear();
+		pages = PageMap();
+		return offsets;
+	}
 };
 
 class VramWatcher : public Watcher<VramWatcher>
@@ -182,10 +259,13 @@ extern VramWatcher vramWatcher;
 extern RamWatcher ramWatcher;
 extern AicaRamWatcher aramWatcher;
 extern ElanRamWatcher elanWatcher;
+inline static bool enabled() {
+	return config::GGPOEnable || tracking != Tracking::None;
+}
 
 inline static bool writeAccess(void *p)
 {
-	if (!config::GGPOEnable)
+	if (!enabled())
 		return false;
 	if (ramWatcher.hit(p))
 	{
@@ -204,7 +284,7 @@ inline static bool writeAccess(void *p)
 
 inline static void protect()
 {
-	if (!config::GGPOEnable)
+	if (!enabled())
 		return;
 	vramWatcher.protect();
 	ramWatcher.protect();
@@ -220,8 +300,20 @@ inline static void unprotect()
 	elanWatcher.unprotect();
 }
 
+// Memory regions that can be tracked, in checkpoint order
+inline static checkpoint::Regions regions()
+{
+	return {{
+		{ &mem_b[0], RAM_SIZE },
+		{ &vram[0], VRAM_SIZE },
+		{ &aica::aica_ram[0], ARAM_SIZE },
+		{ elan::RAM, elan::ERAM_SIZE },
+	}};
+}
+
 inline static void reset()
 {
+	tracking = Tracking::None;
 	vramWatcher.reset();
 	ramWatcher.reset();
 	aramWatcher.reset();
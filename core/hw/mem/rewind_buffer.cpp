@@ -0,0 +1,185 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "rewind_buffer.h"
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include <cstring>
+
+namespace checkpoint
+{
+
+// Frame layout, before compression:
+// u32 previous state size
+// u32 page count, for each region
+// pages: u32 offset followed by the page data, for each region
+// previous state xor current state, zero-padded to the previous state size
+
+template<typename T>
+static void write(u8 *&dst, T v)
+{
+	memcpy(dst, &v, sizeof(T));
+	dst += sizeof(T);
+}
+
+template<typename T>
+static T read(const u8 *&src)
+{
+	T v;
+	memcpy(&v, src, sizeof(T));
+	src += sizeof(T);
+	return v;
+}
+
+void RewindBuffer::setCapacity(size_t bytes)
+{
+	capacity = bytes;
+	while (usedSize > capacity && !frames.empty())
+	{
+		usedSize -= frames.front().size();
+		frames.pop_front();
+	}
+}
+
+void RewindBuffer::reset(std::vector<u8>&& state)
+{
+	clear();
+	current = std::move(state);
+}
+
+void RewindBuffer::push(const UndoPages& pages, std::vector<u8>&& state)
+{
+	if (current.empty())
+	{
+		// Nothing to go back to
+		current = std::move(state);
+		return;
+	}
+	size_t size = sizeof(u32) * (RegionCount + 1) + current.size();
+	for (const auto& regionPages : pages)
+		size += regionPages.size() * (sizeof(u32) + PAGE_SIZE);
+	scratch.resize(size);
+
+	u8 *dst = scratch.data();
+	write<u32>(dst, (u32)current.size());
+	for (const auto& regionPages : pages)
+		write<u32>(dst, (u32)regionPages.size());
+	for (const auto& regionPages : pages)
+		for (const Page& page : regionPages)
+		{
+			write<u32>(dst, page.offset);
+			memcpy(dst, page.data, PAGE_SIZE);
+			dst += PAGE_SIZE;
+		}
+	const size_t common = std::min(current.size(), state.size());
+	for (size_t i = 0; i < common; i++)
+		dst[i] = current[i] ^ state[i];
+	memcpy(dst + common, current.data() + common, current.size() - common);
+
+	std::vector<u8>& frame = frames.emplace_back(compress(scratch));
+	usedSize += frame.size();
+	current = std::move(state);
+	// Keep at least the new frame
+	while (usedSize > capacity && frames.size() > 1)
+	{
+		usedSize -= frames.front().size();
+		frames.pop_front();
+	}
+}
+
+bool RewindBuffer::pop(const Regions& regions, DirtyPages *restored)
+{
+	if (frames.empty())
+		return false;
+	uncompress(frames.back(), scratch);
+	usedSize -= frames.back().size();
+	frames.pop_back();
+
+	const u8 *src = scratch.data();
+	const u32 stateSize = read<u32>(src);
+	std::array<u32, RegionCount> pageCount;
+	for (u32& count : pageCount)
+		count = read<u32>(src);
+	for (int i = 0; i < RegionCount; i++)
+		for (u32 j = 0; j < pageCount[i]; j++)
+		{
+			const u32 offset = read<u32>(src);
+			verify(offset + PAGE_SIZE <= regions[i].size);
+			memcpy(regions[i].data + offset, src, PAGE_SIZE);
+			src += PAGE_SIZE;
+			if (restored != nullptr)
+				(*restored)[i].push_back(offset);
+		}
+	verify(src + stateSize == scratch.data() + scratch.size());
+	const size_t common = std::min<size_t>(stateSize, current.size());
+	current.resize(stateSize);
+	for (size_t i = 0; i < common; i++)
+		current[i] ^= src[i];
+	memcpy(current.data() + common, src + common, stateSize - common);
+
+	return true;
+}
+
+void RewindBuffer::clear()
+{
+	frames.clear();
+	current.clear();
+	usedSize = 0;
+}
+
+// Compressed frames start with their uncompressed size.
+// Frames are compressed at the fastest level since it's done every frame.
+std::vector<u8> RewindBuffer::compress(const std::vector<u8>& data)
+{
+	std::vector<u8> out;
+#ifdef HAVE_ZSTD
+	out.resize(sizeof(u32) + ZSTD_compressBound(data.size()));
+	size_t rc = ZSTD_compress(&out[sizeof(u32)], out.size() - sizeof(u32), data.data(), data.size(), 1);
+	verify(!ZSTD_isError(rc));
+	out.resize(sizeof(u32) + rc);
+#else
+	uLongf size = compressBound(data.size());
+	out.resize(sizeof(u32) + size);
+	int rc = compress2(&out[sizeof(u32)], &size, data.data(), data.size(), Z_BEST_SPEED);
+	verify(rc == Z_OK);
+	out.resize(sizeof(u32) + size);
+#endif
+	u8 *p = out.data();
+	write<u32>(p, (u32)data.size());
+	out.shrink_to_fit();
+
+	return out;
+}
+
+void RewindBuffer::uncompress(const std::vector<u8>& src, std::vector<u8>& dst)
+{
+	const u8 *p = src.data();
+	dst.resize(read<u32>(p));
+#ifdef HAVE_ZSTD
+	size_t rc = ZSTD_decompress(dst.data(), dst.size(), p, src.size() - sizeof(u32));
+	verify(!ZSTD_isError(rc) && rc == dst.size());
+#else
+	uLongf size = dst.size();
+	int rc = ::uncompress(dst.data(), &size, p, src.size() - sizeof(u32));
+	verify(rc == Z_OK && size == dst.size());
+#endif
+}
+
+}
@@ -0,0 +1,75 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "checkpoint.h"
+#include <deque>
+#include <vector>
+
+namespace checkpoint
+{
+
+struct Page
+{
+	u32 offset;
+	const u8 *data;
+};
+// Previous content of the pages written during a frame, for each region
+using UndoPages = std::array<std::vector<Page>, RegionCount>;
+
+//
+// Ring of compressed per-frame deltas used to rewind the emulation.
+// The live memory and the last pushed state are the most recent frame. Each entry holds what's needed to go
+// one frame back: the previous content of the pages written during the frame, and the previous state xor'ed
+// with the current one, which is mostly zeroes and compresses well.
+// The oldest frames are dropped when the compressed frames use more memory than the capacity.
+//
+class RewindBuffer
+{
+public:
+	void setCapacity(size_t bytes);
+	// Start from the given state. Older frames are discarded.
+	void reset(std::vector<u8>&& state);
+	// Add a frame with its undo pages and the current emulator state.
+	// The buffer starts from this state if it's empty.
+	void push(const UndoPages& pages, std::vector<u8>&& state);
+	// Restore the memory regions and state of the previous frame.
+	// The offsets of the restored pages are added to restored if not null.
+	// Returns false if there is no previous frame.
+	bool pop(const Regions& regions, DirtyPages *restored = nullptr);
+	// State of the most recent frame
+	const std::vector<u8>& state() const { return current; }
+
+	void clear();
+	bool empty() const { return frames.empty(); }
+	size_t size() const { return frames.size(); }
+	size_t memoryUsage() const { return usedSize; }
+
+private:
+	static std::vector<u8> compress(const std::vector<u8>& data);
+	static void uncompress(const std::vector<u8>& src, std::vector<u8>& dst);
+
+	std::deque<std::vector<u8>> frames;
+	std::vector<u8> current;
+	// Uncompressed frame, reused to avoid reallocations
+	std::vector<u8> scratch;
+	size_t capacity = 0;
+	size_t usedSize = 0;
+};
+
+}
@@ -10,7 +10,9 @@
 #include "hw/sh4/sh4_core.h"
 #include "hw/sh4/sh4_sched.h"
 #include "profiler/fc_profiler.h"
+#include "profiler/telemetry.h"
 #include "network/ggpo.h"
+#include "rewinder.h"
 
 #include <mutex>
 #include <deque>
@@ -74,10 +76,11 @@ public:
 							dupe = true;
 							break;
 						}
-					if (!dupe || type == Present) {
+					// Each Render message renders one of the frames in the render queue
+					if (!dupe || type == Present || type == Render) {
 						// Bound the queue to keep the emu-thread producer and
 						// the renderer-thread consumer from drifting apart.
-						// Render/RenderFramebuffer/Stop are already deduplicated
+						// RenderFramebuffer/Stop are already deduplicated
 						// above, but Present is intentionally allowed to repeat
 						// and can stack up indefinitely if the consumer stalls
 						// (notably under libretro frontends, which drive the
@@ -399,6 +402,7 @@ static SwapIntervalDetector swapIntervalDetector;
 Renderer* rend_GLES2();
 Renderer* rend_GL4();
 Renderer* rend_norend();
+Renderer* rend_software();
 Renderer* rend_Vulkan();
 Renderer* rend_OITVulkan();
 Renderer* rend_DirectX9();
@@ -408,10 +412,19 @@ Renderer* rend_OITDirectX11();
 static void rend_create_renderer()
 {
 #ifdef NO_REND
-	renderer	 = rend_norend();
+	if (config::RendererType == RenderType::Software)
+		renderer = rend_software();
+	else
+		renderer	 = rend_norend();
 #else
 	switch (config::RendererType)
 	{
+#ifdef FLYCAST_BENCHMARK
+	// Its output can't be displayed so GUI builds don't have it
+	case RenderType::Software:
+		renderer = rend_software();
+		break;
+#endif
 	default:
 #ifdef USE_OPENGL
 	case RenderType::OpenGL:
@@ -484,7 +497,8 @@ void rend_term_renderer()
 
 void rend_reset()
 {
-	FinishRender(DequeueRender());
+	while (TA_context *ctx = DequeueRender())
+		FinishRender(ctx);
 	render_called = false;
 	pend_rend = false;
 	FrameCount = 1;
@@ -498,6 +512,7 @@ void rend_reset()
 
 void rend_start_render()
 {
+	TELEMETRY_SCOPE(StartRender);
 	render_called = true;
 	pend_rend = false;
 
@@ -560,6 +575,7 @@ void rend_start_render()
 			ctx->rend.clearFramebuffer = false;
 		}
 		ggpo::endOfFrame();
+		rewinder::endOfFrame();
 		swapIntervalDetector.render();
 		if (!config::EmulateFramebuffer)
 			ctx->rend.swapInterval = swapIntervalDetector.swapInterval();
@@ -570,6 +586,8 @@ void rend_start_render()
 	if (QueueRender(ctx))
 	{
 		palette_update();
+		// Renderer::Process() reads vram, the palette and pvr registers so the emulation
+		// must wait until it's done. Only the GPU rendering and presentation are queued.
 		pend_rend = true;
 		pvrQueue.enqueue(PvrMessageQueue::Render);
 		if (!config::DelayFrameSwapping && !ctx->rend.isRTT && !config::EmulateFramebuffer)
@@ -4,7 +4,12 @@
 #include "Renderer_if.h"
 #include "serialize.h"
 #include "stdclass.h"
+#include "network/ggpo.h"
+#include "profiler/fc_profiler.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <mutex>
 #include <vector>
 
@@ -43,28 +48,52 @@ void SetCurrentTARC(u32 addr)
 	}
 }
 
-static TA_context* rqueue;
+// Single producer (emulation thread), single consumer (render thread) queue of contexts to render
+constexpr u32 MAX_RENDER_QUEUE = 4;
+static TA_context* rqueue[MAX_RENDER_QUEUE];
+// Next context to render. Only written by the consumer
+static std::atomic<u32> rqueueHead;
+// Next free slot. Only written by the producer
+static std::atomic<u32> rqueueTail;
 static cResetEvent frame_finished;
+static std::atomic<u32> rqueueMaxDepth { 1 };
+static std::atomic<float> rqueueWaitTime;
+
+static u32 rqueueDepth() {
+	return rqueueTail.load(std::memory_order_acquire) - rqueueHead.load(std::memory_order_acquire);
+}
 
 bool QueueRender(TA_context* ctx)
 {
 	verify(ctx != 0);
 	
+	// Queuing more than one frame is only useful with threaded rendering.
+	// Net rollbacks must wait until the render thread has processed the last frame.
+	const u32 maxDepth = config::ThreadedRendering && !ggpo::active()
+			? std::clamp<int>(config::RenderQueueLatency, 1, MAX_RENDER_QUEUE) : 1;
+	rqueueMaxDepth = maxDepth;
+	float waitTime = 0.f;
 	bool skipFrame = !rend_is_enabled();
 	if (!skipFrame)
 	{
 		RenderCount++;
 		if (RenderCount % (config::SkipFrame + 1) != 0)
 			skipFrame = true;
-		else if (config::ThreadedRendering && rqueue != nullptr
+		else if (config::ThreadedRendering && rqueueDepth() >= maxDepth
 				&& (config::AutoSkipFrame == 0 || (config::AutoSkipFrame == 1 && SH4FastEnough)))
-			// The previous render hasn't completed yet so we wait.
+		{
+			// The renderer is too far behind so we wait.
 			// If autoskipframe is enabled (normal level), we only do so if the CPU is running
 			// fast enough over the last frames
+			FC_PROFILE_SCOPE_NAMED("QueueRender::Wait");
+			auto start = std::chrono::steady_clock::now();
 			frame_finished.Wait();
+			waitTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
 	}
+	rqueueWaitTime = waitTime;
 
-	if (skipFrame || rqueue)
+	if (skipFrame || rqueueDepth() >= maxDepth)
 	{
 		tactx_Recycle(ctx);
 		if (rend_is_enabled())
@@ -74,32 +103,45 @@ bool QueueRender(TA_context* ctx)
 	// disable net rollbacks until the render thread has processed the frame
 	rend_disable_rollback();
 	frame_finished.Reset();
-	verify(rqueue == nullptr);
-	rqueue = ctx;
-
+	u32 tail = rqueueTail.load(std::memory_order_relaxed);
+	rqueue[tail % MAX_RENDER_QUEUE] = ctx;
+	rqueueTail.store(tail + 1, std::memory_order_release);
 
 	return true;
 }
 
 TA_context* DequeueRender()
 {
-	if (rqueue != nullptr)
-		FrameCount++;
+	u32 head = rqueueHead.load(std::memory_order_relaxed);
+	if (head == rqueueTail.load(std::memory_order_acquire))
+		return nullptr;
+	FrameCount++;
 
-	return rqueue;
+	return rqueue[head % MAX_RENDER_QUEUE];
 }
 
 void FinishRender(TA_context* ctx)
 {
 	if (ctx != nullptr)
 	{
-		verify(rqueue == ctx);
-		rqueue = nullptr;
+		u32 head = rqueueHead.load(std::memory_order_relaxed);
+		verify(rqueueDepth() != 0 && rqueue[head % MAX_RENDER_QUEUE] == ctx);
+		rqueue[head % MAX_RENDER_QUEUE] = nullptr;
+		rqueueHead.store(head + 1, std::memory_order_release);
 		tactx_Recycle(ctx);
 	}
 	frame_finished.Set();
 }
 
+RenderQueueStats getRenderQueueStats()
+{
+	RenderQueueStats stats;
+	stats.depth = rqueueDepth();
+	stats.maxDepth = rqueueMaxDepth;
+	stats.waitTime = rqueueWaitTime;
+	return stats;
+}
+
 static std::mutex mtx_pool;
 using Lock = std::lock_guard<std::mutex>;
 
@@ -129,7 +171,7 @@ static void tactx_Recycle(TA_context* ctx)
 	if (ctx->nextContext != nullptr)
 		tactx_Recycle(ctx->nextContext);
 	Lock _(mtx_pool);
-	if (ctx_pool.size() > 3) {
+	if (ctx_pool.size() >= MAX_RENDER_QUEUE) {
 		delete ctx;
 	}
 	else {
@@ -227,6 +227,18 @@ struct SortedTriangle
 	u32 count;
 };
 
+// Scratch buffers used to sort translucent triangles. Kept between frames to avoid reallocations.
+struct TriangleSortBuffers
+{
+	std::vector<u32> vids;		// vertex indices, 3 per triangle
+	std::vector<u32> pids;		// poly param of each triangle
+	std::vector<f32> z;			// z of each triangle
+	std::vector<u32> ppOffsets;	// first triangle of each poly param
+	std::vector<u32> ppCounts;	// number of triangles of each poly param
+	std::vector<u64> keys;		// sort key (z) and triangle index
+	std::vector<u64> sortedKeys;
+};
+
 struct Rect
 {
 	Rect() = default;
@@ -274,6 +286,7 @@ struct rend_context
 	std::vector<PolyParam> global_param_tr;
 	std::vector<RenderPass> render_passes;
 	std::vector<SortedTriangle> sortedTriangles;
+	TriangleSortBuffers sortBuffers;
 
 	std::vector<N2Matrix> matrices;
 	std::vector<N2LightModel> lightModels;
@@ -396,6 +409,14 @@ bool QueueRender(TA_context* ctx);
 TA_context* DequeueRender();
 void FinishRender(TA_context* ctx);
 
+struct RenderQueueStats
+{
+	u32 depth;			// frames waiting to be rendered
+	u32 maxDepth;		// max frames allowed by the latency budget
+	float waitTime;		// time spent by the emulation thread waiting for the renderer during the last frame (ms)
+};
+RenderQueueStats getRenderQueueStats();
+
 //must be moved to proper header
 void FillBGP(TA_context* ctx);
 void SerializeTAContext(Serializer& ser);
@@ -418,6 +439,11 @@ void getRegionTileAddrAndSize(u32& address, u32& size);
 void setTileClipping(rend_context& ctx);
 
 void sortTriangles(rend_context& ctx, RenderPass& pass, const RenderPass& previousPass);
+// Stable sort of 64-bit keys on their 32 msbits. tmp is used as scratch buffer.
+void radixSort(std::vector<u64>& keys, std::vector<u64>& tmp);
+class ThreadPool;
+// Thread pool used to parse TA data and sort triangles
+ThreadPool& taThreadPool();
 void sortPolyParams(std::vector<PolyParam>& polys, int first, int end, rend_context& ctx);
 void fix_texture_bleeding(const std::vector<PolyParam>& polys, int first, int end, rend_context& ctx);
 void makeIndex(std::vector<PolyParam>& polys, int first, int end, bool merge, rend_context& ctx);
@@ -18,6 +18,7 @@
  */
 #include "ta_ctx.h"
 #include "pvr_mem.h"
+#include "util/thread_pool.h"
 #include <algorithm>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -33,129 +34,229 @@ static bool is_vertex_inf(const Vertex& vtx)
 			|| std::isnan(vtx.z) || vtx.z > 3.4e37f;
 }
 
-struct IndexTrig
-{
-	IndexTrig() = default;
-	IndexTrig(u32 pid, u32 v0, u32 v1, u32 v2) : pid(pid), z(0) {
-		vid[0] = v0;
-		vid[1] = v1;
-		vid[2] = v2;
-	}
-
-	u32 vid[3];
-	u32 pid;
-	f32 z;
-};
-
 static float minZ(const Vertex *v, const u32 *mod)
 {
 	return std::min(std::min(v[mod[0]].z, v[mod[1]].z), v[mod[2]].z);
 }
 
-static bool operator<(const IndexTrig& left, const IndexTrig& right)
-{
-	return left.z < right.z;
-}
-
 static float getProjectedZ(const Vertex *v, const float *mat)
 {
 	// -1 / z
 	return -1 / (mat[2] * v->x + mat[1 * 4 + 2] * v->y + mat[2 * 4 + 2] * v->z + mat[3 * 4 + 2]);
 }
 
-void sortTriangles(rend_context& ctx, RenderPass& pass, const RenderPass& previousPass)
+ThreadPool& taThreadPool()
 {
-	int first = previousPass.tr_count;
-	int count = pass.tr_count - first;
-	if (count == 0)
-		return;
-
-	const PolyParam * const pp_base = &ctx.global_param_tr[first];
-	const PolyParam * const pp_end = pp_base + count;
+	static ThreadPool threadPool("TAParser");
+	return threadPool;
+}
 
-	//make lists of all triangles, with their pid and vid
-	static std::vector<IndexTrig> triangleList;
+// Minimum number of triangles to extract them in parallel, and triangles per parallel task
+constexpr u32 PARALLEL_MIN_TRIANGLES = 8192;
+constexpr u32 PARALLEL_CHUNK_TRIANGLES = 2048;
 
-	int vtx_count = ctx.verts.size() - pp_base->first;
-	triangleList.reserve(vtx_count);
-	triangleList.clear();
+// Make a list of the triangles of a poly param, with their vertex indices and z.
+// Returns the number of triangles.
+static u32 extractTriangles(const rend_context& ctx, const PolyParam *pp, u32 pid, u32 *vids, u32 *pids, f32 *z)
+{
+	const Vertex *v0 = &ctx.verts[pp->first];
+	const Vertex *v1 = &ctx.verts[pp->first + 1];
+	float z0 = 0, z1 = 0;
 
-	for (const PolyParam *pp = pp_base; pp != pp_end; pp++)
+	if (pp->isNaomi2())
 	{
-		if (pp->count < 3)
-			continue;
-
-		const Vertex *v0 = &ctx.verts[pp->first];
-		const Vertex *v1 = &ctx.verts[pp->first + 1];
-		float z0 = 0, z1 = 0;
-
-		if (pp->isNaomi2())
+		z0 = getProjectedZ(v0, ctx.matrices[pp->mvMatrix].mat);
+		z1 = getProjectedZ(v1, ctx.matrices[pp->mvMatrix].mat);
+	}
+	else
+	{
+		if (is_vertex_inf(*v0))
+			v0 = nullptr;
+		if (is_vertex_inf(*v1))
+			v1 = nullptr;
+	}
+	u32 count = 0;
+	for (u32 i = 2; i < pp->count; i++)
+	{
+		const Vertex *v2 = &ctx.verts[pp->first + i];
+		if (!pp->isNaomi2() && is_vertex_inf(*v2))
+			v2 = nullptr;
+		if (v0 != nullptr && v1 != nullptr && v2 != nullptr)
 		{
-			z0 = getProjectedZ(v0, ctx.matrices[pp->mvMatrix].mat);
-			z1 = getProjectedZ(v1, ctx.matrices[pp->mvMatrix].mat);
+			u32 *vid = &vids[count * 3];
+			vid[0] = (u32)(v0 - &ctx.verts[0]);
+			vid[1] = (u32)(v1 - &ctx.verts[0]);
+			vid[2] = (u32)(v2 - &ctx.verts[0]);
+			pids[count] = pid;
+			if (pp->isNaomi2())
+			{
+				float z2 = getProjectedZ(v2, ctx.matrices[pp->mvMatrix].mat);
+				z[count] = std::min(z0, std::min(z1, z2));
+				z0 = z1;
+				z1 = z2;
+			}
+			else
+			{
+				z[count] = minZ(&ctx.verts[0], vid);
+			}
+			count++;
 		}
+		if (i & 1)
+			v1 = v2;
 		else
+			v0 = v2;
+	}
+	return count;
+}
+
+// Map a float to an unsigned int with the same ordering
+static u32 floatSortKey(f32 f)
+{
+	u32 bits = (u32&)f;
+	// -0 and 0 are equal
+	if (bits == 0x80000000)
+		bits = 0;
+	return (bits & 0x80000000) ? ~bits : bits | 0x80000000;
+}
+
+// Stable LSD radix sort of the keys on their 32 msbits
+void radixSort(std::vector<u64>& keys, std::vector<u64>& tmp)
+{
+	const size_t size = keys.size();
+	if (size < 2)
+		return;
+	tmp.resize(size);
+	u32 histograms[4][256] {};
+	for (u64 key : keys)
+	{
+		histograms[0][(key >> 32) & 0xff]++;
+		histograms[1][(key >> 40) & 0xff]++;
+		histograms[2][(key >> 48) & 0xff]++;
+		histograms[3][key >> 56]++;
+	}
+	u64 *src = keys.data();
+	u64 *dst = tmp.data();
+	for (int pass = 0; pass < 4; pass++)
+	{
+		u32 *histogram = histograms[pass];
+		const int shift = 32 + pass * 8;
+		// Skip the pass if all keys have the same digit
+		if (histogram[(src[0] >> shift) & 0xff] == size)
+			continue;
+		u32 offset = 0;
+		for (int i = 0; i < 256; i++)
 		{
-			if (is_vertex_inf(*v0))
-				v0 = nullptr;
-			if (is_vertex_inf(*v1))
-				v1 = nullptr;
+			u32 count = histogram[i];
+			histogram[i] = offset;
+			offset += count;
 		}
-		for (u32 i = 2; i < pp->count; i++)
+		for (size_t i = 0; i < size; i++)
 		{
-			const Vertex *v2 = &ctx.verts[pp->first + i];
-			if (!pp->isNaomi2() && is_vertex_inf(*v2))
-				v2 = nullptr;
-			if (v0 != nullptr && v1 != nullptr && v2 != nullptr)
-			{
-				triangleList.emplace_back((u32)(pp - pp_base),
-						(u32)(v0 - &ctx.verts[0]), (u32)(v1 - &ctx.verts[0]), (u32)(v2 - &ctx.verts[0]));
-				if (pp->isNaomi2())
-				{
-					float z2 = getProjectedZ(v2, ctx.matrices[pp->mvMatrix].mat);
-					triangleList.back().z = std::min(z0, std::min(z1, z2));
-					z0 = z1;
-					z1 = z2;
-				}
-				else
-				{
-					triangleList.back().z = minZ(&ctx.verts[0], triangleList.back().vid);
-				}
-			}
-			if (i & 1)
-				v1 = v2;
-			else
-				v0 = v2;
+			u64 key = src[i];
+			dst[histogram[(key >> shift) & 0xff]++] = key;
 		}
+		std::swap(src, dst);
+	}
+	if (src != keys.data())
+		keys.swap(tmp);
+}
+
+void sortTriangles(rend_context& ctx, RenderPass& pass, const RenderPass& previousPass)
+{
+	int first = previousPass.tr_count;
+	int count = pass.tr_count - first;
+	if (count == 0)
+		return;
+
+	const PolyParam * const pp_base = &ctx.global_param_tr[first];
+	TriangleSortBuffers& buffers = ctx.sortBuffers;
+
+	// Reserve room for the triangles of each poly param
+	buffers.ppOffsets.resize(count);
+	buffers.ppCounts.resize(count);
+	u32 maxTriangles = 0;
+	for (int i = 0; i < count; i++)
+	{
+		buffers.ppOffsets[i] = maxTriangles;
+		if (pp_base[i].count >= 3)
+			maxTriangles += pp_base[i].count - 2;
+	}
+	buffers.vids.resize(maxTriangles * 3);
+	buffers.pids.resize(maxTriangles);
+	buffers.z.resize(maxTriangles);
+
+	auto extract = [&](size_t pid) {
+		const u32 offset = buffers.ppOffsets[pid];
+		if (pp_base[pid].count < 3)
+			buffers.ppCounts[pid] = 0;
+		else
+			buffers.ppCounts[pid] = extractTriangles(ctx, &pp_base[pid], pid, &buffers.vids[offset * 3], &buffers.pids[offset], &buffers.z[offset]);
+	};
+	if (maxTriangles >= PARALLEL_MIN_TRIANGLES)
+	{
+		// Split the poly params in chunks of similar triangle count
+		std::vector<u32> chunks;
+		chunks.push_back(0);
+		for (int i = 1; i < count; i++)
+			if (buffers.ppOffsets[i] - buffers.ppOffsets[chunks.back()] >= PARALLEL_CHUNK_TRIANGLES)
+				chunks.push_back(i);
+		chunks.push_back(count);
+		taThreadPool().parallelFor(chunks.size() - 1, [&](size_t chunk) {
+			for (u32 pid = chunks[chunk]; pid < chunks[chunk + 1]; pid++)
+				extract(pid);
+		});
+	}
+	else
+	{
+		for (int pid = 0; pid < count; pid++)
+			extract(pid);
 	}
 
+	// Build the sort keys in triangle order, skipping the unused slots
+	buffers.keys.clear();
+	for (int pid = 0; pid < count; pid++)
+	{
+		const u32 offset = buffers.ppOffsets[pid];
+		for (u32 tri = offset; tri < offset + buffers.ppCounts[pid]; tri++)
+			buffers.keys.push_back(((u64)floatSortKey(buffers.z[tri]) << 32) | tri);
+	}
+	const u32 triangleCount = buffers.keys.size();
+
 	//sort them
-	std::stable_sort(triangleList.begin(), triangleList.end());
+	radixSort(buffers.keys, buffers.sortedKeys);
 
 	//Merge pids/draw cmds if two different pids are actually equal
-	for (size_t k = 1; k < triangleList.size(); k++)
-		if (triangleList[k].pid != triangleList[k - 1].pid)
+	u32 *pids = buffers.pids.data();
+	for (size_t k = 1; k < triangleCount; k++)
+	{
+		u32& pid = pids[(u32)buffers.keys[k]];
+		const u32 prevPid = pids[(u32)buffers.keys[k - 1]];
+		if (pid != prevPid)
 		{
-			const PolyParam& curPoly = pp_base[triangleList[k].pid];
-			const PolyParam& prevPoly = pp_base[triangleList[k - 1].pid];
+			const PolyParam& curPoly = pp_base[pid];
+			const PolyParam& prevPoly = pp_base[prevPid];
 			if (curPoly.equivalentIgnoreCullingDirection(prevPoly)
 					&& (curPoly.isp.CullMode < 2 || curPoly.isp.CullMode == prevPoly.isp.CullMode))
-				triangleList[k].pid = triangleList[k - 1].pid;
+				pid = prevPid;
 		}
+	}
 
 	//re-assemble them into drawing commands
 
 	int idx = -1;
-	int idxSize = ctx.idx.size();
+	const u32 idxSize = ctx.idx.size();
+	ctx.idx.resize(idxSize + triangleCount * 3);
+	u32 *pidx = &ctx.idx[idxSize];
 
-	for (size_t i = 0; i < triangleList.size(); i++)
+	for (size_t i = 0; i < triangleCount; i++)
 	{
-		int pid = triangleList[i].pid;
-		u32* midx = triangleList[i].vid;
+		const u32 tri = (u32)buffers.keys[i];
+		int pid = pids[tri];
+		const u32 *midx = &buffers.vids[tri * 3];
 
-		ctx.idx.emplace_back(midx[0]);
-		ctx.idx.emplace_back(midx[1]);
-		ctx.idx.emplace_back(midx[2]);
+		*pidx++ = midx[0];
+		*pidx++ = midx[1];
+		*pidx++ = midx[2];
 
 		if (idx != pid)
 		{
@@ -172,10 +273,10 @@ void sortTriangles(rend_context& ctx, RenderPass& pass, const RenderPass& previo
 		}
 	}
 
-	if (!triangleList.empty())
+	if (triangleCount != 0)
 	{
 		SortedTriangle& last = ctx.sortedTriangles.back();
-		last.count = idxSize + triangleList.size() * 3 - last.first;
+		last.count = idxSize + triangleCount * 3 - last.first;
 	}
 	else
 	{
@@ -185,7 +286,7 @@ void sortTriangles(rend_context& ctx, RenderPass& pass, const RenderPass& previo
 	pass.sorted_tr_count = ctx.sortedTriangles.size();
 
 #if PRINT_SORT_STATS
-	printf("Reassembled into %d from %d\n", (int)ctx.sortedTriangles.size(), pp_end - pp_base);
+	printf("Reassembled into %d from %d\n", (int)ctx.sortedTriangles.size(), count);
 #endif
 }
 
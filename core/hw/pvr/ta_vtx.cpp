@@ -6,11 +6,15 @@
 */
 #include "ta.h"
 #include "ta_ctx.h"
+#include "ta_vtx_simd.h"
 #include "pvr_mem.h"
 #include "Renderer_if.h"
 #include "cfg/option.h"
+#include "util/thread_pool.h"
+#include "profiler/telemetry.h"
 
 #include <algorithm>
+#include <cstring>
 #include <utility>
 
 #define TACALL DYNACALL
@@ -36,6 +40,10 @@ static f32 f16(u16 v)
 	return *(f32*)&z;
 }
 
+// Minimum number of vertices to convert them in parallel, and vertices per parallel task
+constexpr u32 PARALLEL_MIN_VERTICES = 4096;
+constexpr u32 PARALLEL_CHUNK_VERTICES = 1024;
+
 class BaseTAParser
 {
 	static Ta_Dma *DYNACALL NullVertexData(Ta_Dma *data, Ta_Dma *data_end)
@@ -123,8 +131,51 @@ protected:
 		}
 	}
 
+	// Poly strip vertices are converted once the whole TA buffer has been parsed so that
+	// it can be done in parallel. Each run of vertices has its own slice of the vertex array.
+	struct VertexRun
+	{
+		void (*convert)(const VertexRun& run);
+		Ta_Dma *data;
+		u32 first;
+		u32 count;
+		u8 faceColors[4][4];	// FaceBaseColor, FaceOffsColor, FaceBaseColor1, FaceOffsColor1
+		f32 zMax;
+	};
+
+	static void deferVertices(void (*convert)(const VertexRun& run), Ta_Dma *data, u32 count)
+	{
+		VertexRun& run = vertexRuns.emplace_back();
+		run.convert = convert;
+		run.data = data;
+		run.first = vd_rc.verts.size();
+		run.count = count;
+		memcpy(run.faceColors[0], FaceBaseColor, 4);
+		memcpy(run.faceColors[1], FaceOffsColor, 4);
+		memcpy(run.faceColors[2], FaceBaseColor1, 4);
+		memcpy(run.faceColors[3], FaceOffsColor1, 4);
+		vd_rc.verts.resize(vd_rc.verts.size() + count);
+		deferredVertices += count;
+	}
+
+	static void convertRun(VertexRun& run)
+	{
+		memcpy(FaceBaseColor, run.faceColors[0], 4);
+		memcpy(FaceOffsColor, run.faceColors[1], 4);
+		memcpy(FaceBaseColor1, run.faceColors[2], 4);
+		memcpy(FaceOffsColor1, run.faceColors[3], 4);
+		vertexOut = &vd_rc.verts[run.first];
+		// lowest value when compared as integers
+		vertexZMax = -0.f;
+		run.convert(run);
+		run.zMax = vertexZMax;
+		vertexOut = nullptr;
+	}
+
 	static void reset()
 	{
+		vertexRuns.clear();
+		deferredVertices = 0;
 		memset(FaceBaseColor, 0xff, sizeof(FaceBaseColor));
 		memset(FaceOffsColor, 0xff, sizeof(FaceOffsColor));
 		memset(FaceBaseColor1, 0xff, sizeof(FaceBaseColor1));
@@ -143,11 +194,11 @@ protected:
 	//cache state vars
 	static u32 tileclip_val;
 
-	//TA state vars
-	static u8 FaceBaseColor[4];
-	static u8 FaceOffsColor[4];
-	static u8 FaceBaseColor1[4];
-	static u8 FaceOffsColor1[4];
+	//TA state vars. Thread local since they're also used when converting vertices in parallel
+	static thread_local u8 FaceBaseColor[4];
+	static thread_local u8 FaceOffsColor[4];
+	static thread_local u8 FaceBaseColor1[4];
+	static thread_local u8 FaceOffsColor1[4];
 	static u32 SFaceBaseColor;
 	static u32 SFaceOffsColor;
 	//vdec state variables
@@ -155,7 +206,66 @@ protected:
 
 	static u32 CurrentList;
 	static TaListFP *VertexDataFP;
+
+	static std::vector<VertexRun> vertexRuns;
+	static u32 deferredVertices;
+	// When converting deferred vertices, where the next vertex is written and max z of the run
+	static thread_local Vertex *vertexOut;
+	static thread_local f32 vertexZMax;
+
 public:
+	// Convert the vertices of the deferred poly strips
+	static void convertVertices()
+	{
+		if (vertexRuns.empty())
+			return;
+		u8 faceColors[4][4];
+		memcpy(faceColors[0], FaceBaseColor, 4);
+		memcpy(faceColors[1], FaceOffsColor, 4);
+		memcpy(faceColors[2], FaceBaseColor1, 4);
+		memcpy(faceColors[3], FaceOffsColor1, 4);
+
+		if (deferredVertices < PARALLEL_MIN_VERTICES)
+		{
+			for (VertexRun& run : vertexRuns)
+				convertRun(run);
+		}
+		else
+		{
+			// Split the runs in chunks of similar vertex count
+			static std::vector<size_t> chunks;
+			chunks.clear();
+			chunks.push_back(0);
+			u32 vertices = 0;
+			for (size_t i = 0; i < vertexRuns.size(); i++)
+			{
+				vertices += vertexRuns[i].count;
+				if (vertices >= PARALLEL_CHUNK_VERTICES)
+				{
+					chunks.push_back(i + 1);
+					vertices = 0;
+				}
+			}
+			if (chunks.back() != vertexRuns.size())
+				chunks.push_back(vertexRuns.size());
+			taThreadPool().parallelFor(chunks.size() - 1, [](size_t chunk) {
+				for (size_t i = chunks[chunk]; i < chunks[chunk + 1]; i++)
+					convertRun(vertexRuns[i]);
+			});
+		}
+		// Merge in order so that the result is the same as a sequential conversion
+		for (const VertexRun& run : vertexRuns)
+			if ((s32&)vd_rc.fZ_max < (s32&)run.zMax)
+				vd_rc.fZ_max = run.zMax;
+		vertexRuns.clear();
+		deferredVertices = 0;
+
+		memcpy(FaceBaseColor, faceColors[0], 4);
+		memcpy(FaceOffsColor, faceColors[1], 4);
+		memcpy(FaceBaseColor1, faceColors[2], 4);
+		memcpy(FaceOffsColor1, faceColors[3], 4);
+	}
+
 	static std::vector<PolyParam> *CurrentPPlist;
 	static PolyParam* CurrentPP;
 	static TaListFP* TaCmd;
@@ -164,10 +274,10 @@ public:
 
 const u32 *BaseTAParser::ta_type_lut = TaTypeLut::instance().table;
 u32 BaseTAParser::tileclip_val;
-alignas(4) u8 BaseTAParser::FaceBaseColor[4];
-alignas(4) u8 BaseTAParser::FaceOffsColor[4];
-alignas(4) u8 BaseTAParser::FaceBaseColor1[4];
-alignas(4) u8 BaseTAParser::FaceOffsColor1[4];
+alignas(4) thread_local u8 BaseTAParser::FaceBaseColor[4];
+alignas(4) thread_local u8 BaseTAParser::FaceOffsColor[4];
+alignas(4) thread_local u8 BaseTAParser::FaceBaseColor1[4];
+alignas(4) thread_local u8 BaseTAParser::FaceOffsColor1[4];
 u32 BaseTAParser::SFaceBaseColor;
 u32 BaseTAParser::SFaceOffsColor;
 ModTriangle* BaseTAParser::lmr;
@@ -176,6 +286,10 @@ PolyParam* BaseTAParser::CurrentPP;
 std::vector<PolyParam>* BaseTAParser::CurrentPPlist;
 BaseTAParser::TaListFP *BaseTAParser::TaCmd;
 BaseTAParser::TaListFP *BaseTAParser::VertexDataFP;
+std::vector<BaseTAParser::VertexRun> BaseTAParser::vertexRuns;
+u32 BaseTAParser::deferredVertices;
+thread_local Vertex *BaseTAParser::vertexOut;
+thread_local f32 BaseTAParser::vertexZMax;
 
 template<int Red = 0, int Green = 1, int Blue = 2, int Alpha = 3>
 class TAParserTempl : public BaseTAParser
@@ -321,14 +435,26 @@ case num : {\
 		if (IS_FIST_HALF)
 			goto fist_half;
 
-		do
 		{
-			verify(data->pcw.ParaType == ParamType_Vertex_Parameter);
-			ta_handle_poly<poly_type,0>(data, 0);
-			if (data->pcw.EndOfStrip)
+			// Find the end of the strip. Its vertices are converted later.
+			Ta_Dma *first = data;
+			u32 count = 0;
+			bool stripEnd = false;
+			do
+			{
+				verify(data->pcw.ParaType == ParamType_Vertex_Parameter);
+				count++;
+				if (data->pcw.EndOfStrip)
+				{
+					stripEnd = true;
+					break;
+				}
+				data += poly_size;
+			} while (data <= data_end - poly_size);
+			deferVertices(convertVertexRun<poly_type, poly_size>, first, count);
+			if (stripEnd)
 				goto strip_end;
-			data += poly_size;
-		} while (data <= data_end - poly_size);
+		}
 			
 		if (IS_FIST_HALF)
 		{
@@ -349,6 +475,87 @@ strip_end:
 		return data+poly_size;
 	}
 
+	template <u32 poly_type,u32 poly_size>
+	static void convertVertexRun(const VertexRun& run)
+	{
+#ifdef TA_VTX_SIMD
+		if constexpr (poly_size == SZ32 && poly_type <= 8)
+		{
+			convertVertexBatch<poly_type>(run);
+			return;
+		}
+#endif
+		Ta_Dma *data = run.data;
+		for (u32 i = 0; i < run.count; i++, data += poly_size)
+			ta_handle_poly<poly_type,0>(data, 0);
+	}
+
+#ifdef TA_VTX_SIMD
+	// Convert a run of 32-byte vertices with the simd kernels
+	template <u32 poly_type>
+	static void convertVertexBatch(const VertexRun& run)
+	{
+		Vertex *cv = vertexOut;
+		const u8 *src = (const u8 *)&((TA_VertexParam *)run.data)->vtx0;
+		constexpr size_t stride = sizeof(Ta_Dma);
+		for (u32 i = 0; i < run.count; i++)
+		{
+			const TA_Vertex0 *vtx = (const TA_Vertex0 *)(src + i * stride);
+			cv[i].x = vtx->xyz[0];
+			cv[i].y = vtx->xyz[1];
+			cv[i].z = vtx->xyz[2];
+			update_fz(vtx->xyz[2]);
+		}
+		vertexOut += run.count;
+
+#define vtx_field(type, field) src + offsetof(type, field), stride, run.count
+		constexpr size_t vstride = sizeof(Vertex);
+		switch (poly_type)
+		{
+		case 0:	//(Non-Textured, Packed Color)
+			vtxconv::packedColors<Red, Green, Blue, Alpha>(cv->col, vstride, vtx_field(TA_Vertex0, BaseCol));
+			break;
+		case 1:	//(Non-Textured, Floating Color)
+			vtxconv::floatColors<Red, Green, Blue, Alpha>(cv->col, vstride, vtx_field(TA_Vertex1, BaseA));
+			break;
+		case 2:	//(Non-Textured, Intensity)
+			vtxconv::intensityColors<Alpha>(cv->col, vstride, vtx_field(TA_Vertex2, BaseInt), FaceBaseColor);
+			break;
+		case 3:	//(Textured, Packed Color)
+			vtxconv::packedColors<Red, Green, Blue, Alpha>(cv->col, vstride, vtx_field(TA_Vertex3, BaseCol));
+			vtxconv::packedColors<Red, Green, Blue, Alpha>(cv->spc, vstride, vtx_field(TA_Vertex3, OffsCol));
+			for (u32 i = 0; i < run.count; i++)
+			{
+				const TA_Vertex3 *vtx = (const TA_Vertex3 *)(src + i * stride);
+				cv[i].u = vtx->u;
+				cv[i].v = vtx->v;
+			}
+			break;
+		case 4:	//(Textured, Packed Color, 16bit UV)
+			vtxconv::packedColors<Red, Green, Blue, Alpha>(cv->col, vstride, vtx_field(TA_Vertex4, BaseCol));
+			vtxconv::packedColors<Red, Green, Blue, Alpha>(cv->spc, vstride, vtx_field(TA_Vertex4, OffsCol));
+			vtxconv::uv16((u8 *)&cv->u, vstride, vtx_field(TA_Vertex4, v));
+			break;
+		case 7:	//(Textured, Intensity)
+			vtxconv::intensityColors<Alpha>(cv->col, vstride, vtx_field(TA_Vertex7, BaseInt), FaceBaseColor);
+			vtxconv::intensityColors<Alpha>(cv->spc, vstride, vtx_field(TA_Vertex7, OffsInt), FaceOffsColor);
+			for (u32 i = 0; i < run.count; i++)
+			{
+				const TA_Vertex7 *vtx = (const TA_Vertex7 *)(src + i * stride);
+				cv[i].u = vtx->u;
+				cv[i].v = vtx->v;
+			}
+			break;
+		case 8:	//(Textured, Intensity, 16bit UV)
+			vtxconv::intensityColors<Alpha>(cv->col, vstride, vtx_field(TA_Vertex8, BaseInt), FaceBaseColor);
+			vtxconv::intensityColors<Alpha>(cv->spc, vstride, vtx_field(TA_Vertex8, OffsInt), FaceOffsColor);
+			vtxconv::uv16((u8 *)&cv->u, vstride, vtx_field(TA_Vertex8, v));
+			break;
+		}
+#undef vtx_field
+	}
+#endif
+
 	static void TACALL AppendPolyParam2Full(void* vpp)
 	{
 		Ta_Dma* pp=(Ta_Dma*)vpp;
@@ -654,8 +861,9 @@ private:
 	
 	static inline void update_fz(float z)
 	{
-		if ((s32&)vd_rc.fZ_max<(s32&)z && (s32&)z<0x49800000)
-			vd_rc.fZ_max=z;
+		f32& fZ_max = vertexOut != nullptr ? vertexZMax : vd_rc.fZ_max;
+		if ((s32&)fZ_max<(s32&)z && (s32&)z<0x49800000)
+			fZ_max=z;
 	}
 
 		//Poly Vertex handlers
@@ -664,8 +872,16 @@ private:
 	static Vertex* vert_cvt_base_(T* vtx)
 	{
 		f32 invW = vtx->xyz[2];
-		vd_rc.verts.emplace_back();
-		Vertex* cv = &vd_rc.verts.back();
+		Vertex* cv;
+		if (vertexOut != nullptr)
+		{
+			cv = vertexOut++;
+		}
+		else
+		{
+			vd_rc.verts.emplace_back();
+			cv = &vd_rc.verts.back();
+		}
 		cv->x = vtx->xyz[0];
 		cv->y = vtx->xyz[1];
 		cv->z = invW;
@@ -677,7 +893,7 @@ private:
 
 		//Resume vertex base (for B part)
 	#define vert_res_base \
-		Vertex* cv = &vd_rc.verts.back();
+		Vertex* cv = vertexOut != nullptr ? vertexOut - 1 : &vd_rc.verts.back();
 
 		//uv 16/32
 	#define vert_uv_32(u_name,v_name) \
@@ -1244,6 +1460,7 @@ static void ta_parse_vdrc(TA_context* ctx, bool primRestart)
 			} catch (const TAParserException& e) {
 				break;
 			}
+		BaseTAParser::convertVertices();
 
 		// Disable blending for opaque polys of the first pass
 		if (pass == 0)
@@ -1324,6 +1541,7 @@ static void ta_parse_naomi2(TA_context* ctx, bool primRestart)
 
 void ta_parse(TA_context *ctx, bool primRestart)
 {
+	TELEMETRY_SCOPE(TaParse);
 	if (settings.platform.isNaomi2())
 		ta_parse_naomi2(ctx, primRestart);
 	else
@@ -1447,7 +1665,10 @@ u32 ta_add_ta_data(u32 *data, u32 size)
 	Ta_Dma *ta_data_end = (Ta_Dma *)(data + size / 4);
 	try {
 		ta_data = BaseTAParser::TaCmd(ta_data, ta_data_end);
+		// The TA data isn't kept
+		BaseTAParser::convertVertices();
 	} catch (const FlycastException& e) {
+		BaseTAParser::convertVertices();
 		vd_ctx = nullptr;
 		BaseTAParser::fetchTextures = true;
 		throw;
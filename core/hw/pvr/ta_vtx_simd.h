@@ -0,0 +1,340 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "types.h"
+#include <algorithm>
+#include <type_traits>
+#include <cstring>
+
+//
+// Batch conversion of TA vertex attributes (colors and 16-bit uvs) into the renderer vertex format.
+// Each function converts 'count' vertices. 'src' points to the attribute of the first TA vertex and
+// TA vertices are 'srcStride' bytes apart. 'dst' points to the attribute of the first output vertex,
+// output vertices being 'dstStride' bytes apart.
+// The results are identical to the scalar conversion in ta_vtx.cpp.
+//
+// SSE2 and NEON are always available on the supported x64 and arm64 targets so no runtime
+// detection is needed.
+//
+#if HOST_CPU == CPU_X64 || (HOST_CPU == CPU_X86 && defined(__SSE2__))
+#include <emmintrin.h>
+#define TA_VTX_SIMD 1
+#define TA_VTX_SSE2 1
+#elif HOST_CPU == CPU_ARM64 || (HOST_CPU == CPU_ARM && defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define TA_VTX_SIMD 1
+#define TA_VTX_NEON 1
+#endif
+
+#ifdef TA_VTX_SIMD
+
+namespace vtxconv
+{
+
+// Index of the destination byte of each source byte
+template<int To0, int To1, int To2, int To3>
+struct BytePermutation
+{
+	static constexpr int to[4] { To0, To1, To2, To3 };
+
+	// Index of the source byte of the given destination byte
+	static constexpr int from(int dst) {
+		for (int i = 0; i < 4; i++)
+			if (to[i] == dst)
+				return i;
+		return 0;
+	}
+};
+
+static inline u32 load32(const u8 *p) {
+	u32 v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static inline void store32(u8 *p, u32 v) {
+	memcpy(p, &v, 4);
+}
+
+// Call f(index, n) for each batch of 4 vertices, and the remaining ones.
+// Full batches use a constant n so that loads and stores are unrolled.
+template<typename F>
+static inline void forEachBatch(u32 count, F f)
+{
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4)
+		f(i, std::integral_constant<u32, 4>());
+	if (i < count)
+		f(i, count - i);
+}
+
+#ifdef TA_VTX_SSE2
+
+// Load a 32-bit value from n vertices into a vector. Lanes past n are zeroed.
+template<typename N>
+static inline __m128i gather(const u8 *src, size_t stride, N n)
+{
+	const u32 v0 = load32(src);
+	const u32 v1 = n > 1 ? load32(src + stride) : 0;
+	const u32 v2 = n > 2 ? load32(src + stride * 2) : 0;
+	const u32 v3 = n > 3 ? load32(src + stride * 3) : 0;
+	return _mm_unpacklo_epi64(_mm_unpacklo_epi32(_mm_cvtsi32_si128(v0), _mm_cvtsi32_si128(v1)),
+			_mm_unpacklo_epi32(_mm_cvtsi32_si128(v2), _mm_cvtsi32_si128(v3)));
+}
+
+// Store the 32-bit lanes of a vector into n vertices
+template<typename N>
+static inline void scatter(u8 *dst, size_t stride, __m128i v, N n)
+{
+	store32(dst, _mm_cvtsi128_si32(v));
+	if (n > 1)
+		store32(dst + stride, _mm_cvtsi128_si32(_mm_shuffle_epi32(v, 1)));
+	if (n > 2)
+		store32(dst + stride * 2, _mm_cvtsi128_si32(_mm_shuffle_epi32(v, 2)));
+	if (n > 3)
+		store32(dst + stride * 3, _mm_cvtsi128_si32(_mm_shuffle_epi32(v, 3)));
+}
+
+// Same as float_to_satu8: only the 16 msbits of the floats are used, NaN gives 255
+static inline __m128i floatToSatU8(__m128 v)
+{
+	v = _mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0xffff0000)));
+	// maxps and minps return their second operand if one is NaN
+	v = _mm_min_ps(_mm_max_ps(_mm_setzero_ps(), v), _mm_set1_ps(1.f));
+	return _mm_cvttps_epi32(_mm_mul_ps(v, _mm_set1_ps(255.f)));
+}
+
+template<int From, int To>
+static inline __m128i moveByte(__m128i v)
+{
+	const __m128i mask = _mm_set1_epi32((int)(0xffu << (To * 8)));
+	if constexpr (From == To)
+		return _mm_and_si128(v, mask);
+	else if constexpr (From < To)
+		return _mm_and_si128(_mm_slli_epi32(v, (To - From) * 8), mask);
+	else
+		return _mm_and_si128(_mm_srli_epi32(v, (From - To) * 8), mask);
+}
+
+template<typename Perm>
+static inline __m128i permuteBytes(__m128i v)
+{
+	return _mm_or_si128(_mm_or_si128(moveByte<0, Perm::to[0]>(v), moveByte<1, Perm::to[1]>(v)),
+			_mm_or_si128(moveByte<2, Perm::to[2]>(v), moveByte<3, Perm::to[3]>(v)));
+}
+
+// Packed ARGB8888 colors
+template<int Red, int Green, int Blue, int Alpha>
+void packedColors(u8 *dst, size_t dstStride, const u8 *src, size_t srcStride, u32 count)
+{
+	forEachBatch(count, [&](u32 i, auto n) {
+		__m128i v = gather(src + i * srcStride, srcStride, n);
+		v = permuteBytes<BytePermutation<Blue, Green, Red, Alpha>>(v);
+		scatter(dst + i * dstStride, dstStride, v, n);
+	});
+}
+
+// Floating point A, R, G, B colors
+template<int Red, int Green, int Blue, int Alpha>
+void floatColors(u8 *dst, size_t dstStride, const u8 *src, size_t srcStride, u32 count)
+{
+	forEachBatch(count, [&](u32 i, auto n) {
+		using Perm = BytePermutation<Alpha, Red, Green, Blue>;
+		constexpr int shuffle = _MM_SHUFFLE(Perm::from(3), Perm::from(2), Perm::from(1), Perm::from(0));
+		__m128i c[4];
+		for (u32 j = 0; j < 4; j++)
+			c[j] = j < n ? _mm_shuffle_epi32(floatToSatU8(_mm_loadu_ps((const float *)(src + (i + j) * srcStride))), shuffle)
+					: _mm_setzero_si128();
+		const __m128i v = _mm_packus_epi16(_mm_packs_epi32(c[0], c[1]), _mm_packs_epi32(c[2], c[3]));
+		scatter(dst + i * dstStride, dstStride, v, n);
+	});
+}
+
+// Intensity colors: the rgb components of the face color are multiplied by the intensity
+template<int Alpha>
+void intensityColors(u8 *dst, size_t dstStride, const u8 *src, size_t srcStride, u32 count, const u8 faceColor[4])
+{
+	const __m128i faceColors = _mm_unpacklo_epi8(_mm_set1_epi32((int)load32(faceColor)), _mm_setzero_si128());
+	// multiplying alpha by 256 leaves it unchanged
+	const __m128i alphaMask = _mm_set_epi16(Alpha == 3 ? -1 : 0, Alpha == 2 ? -1 : 0, Alpha == 1 ? -1 : 0, Alpha == 0 ? -1 : 0,
+			Alpha == 3 ? -1 : 0, Alpha == 2 ? -1 : 0, Alpha == 1 ? -1 : 0, Alpha == 0 ? -1 : 0);
+	const __m128i alphaMul = _mm_and_si128(alphaMask, _mm_set1_epi16(256));
+	forEachBatch(count, [&](u32 i, auto n) {
+		__m128i sat = floatToSatU8(_mm_castsi128_ps(gather(src + i * srcStride, srcStride, n)));
+		sat = _mm_packs_epi32(sat, sat);
+		sat = _mm_unpacklo_epi16(sat, sat);
+		__m128i sat01 = _mm_unpacklo_epi32(sat, sat);
+		__m128i sat23 = _mm_unpackhi_epi32(sat, sat);
+		sat01 = _mm_or_si128(_mm_andnot_si128(alphaMask, sat01), alphaMul);
+		sat23 = _mm_or_si128(_mm_andnot_si128(alphaMask, sat23), alphaMul);
+		const __m128i col01 = _mm_srli_epi16(_mm_mullo_epi16(faceColors, sat01), 8);
+		const __m128i col23 = _mm_srli_epi16(_mm_mullo_epi16(faceColors, sat23), 8);
+		scatter(dst + i * dstStride, dstStride, _mm_packus_epi16(col01, col23), n);
+	});
+}
+
+// 16-bit uvs: v in the low half, u in the high half
+static inline void uv16(u8 *dst, size_t dstStride, const u8 *src, size_t srcStride, u32 count)
+{
+	forEachBatch(count, [&](u32 i, auto n) {
+		const __m128i uv = gather(src + i * srcStride, srcStride, n);
+		const __m128i u = _mm_and_si128(uv, _mm_set1_epi32(0xffff0000));
+		const __m128i v = _mm_slli_epi32(uv, 16);
+		const __m128i uv01 = _mm_unpacklo_epi32(u, v);
+		const __m128i uv23 = _mm_unpackhi_epi32(u, v);
+		u8 *p = dst + i * dstStride;
+		for (u32 j = 0; j < n; j++, p += dstStride)
+			switch (j)
+			{
+			case 0: _mm_storel_epi64((__m128i *)p, uv01); break;
+			case 1: _mm_storel_epi64((__m128i *)p, _mm_unpackhi_epi64(uv01, uv01)); break;
+			case 2: _mm_storel_epi64((__m128i *)p, uv23); break;
+			case 3: _mm_storel_epi64((__m128i *)p, _mm_unpackhi_epi64(uv23, uv23)); break;
+			}
+	});
+}
+
+#else // TA_VTX_NEON
+
+// Load a 32-bit value from n vertices into a vector. Lanes past n are zeroed.
+template<typename N>
+static inline uint32x4_t gather(const u8 *src, size_t stride, N n)
+{
+	uint32x4_t v = vdupq_n_u32(0);
+	v = vsetq_lane_u32(load32(src), v, 0);
+	if (n > 1)
+		v = vsetq_lane_u32(load32(src + stride), v, 1);
+	if (n > 2)
+		v = vsetq_lane_u32(load32(src + stride * 2), v, 2);
+	if (n > 3)
+		v = vsetq_lane_u32(load32(src + stride * 3), v, 3);
+	return v;
+}
+
+// Store the 32-bit lanes of a vector into n vertices
+template<typename N>
+static inline void scatter(u8 *dst, size_t stride, uint32x4_t v, N n)
+{
+	store32(dst, vgetq_lane_u32(v, 0));
+	if (n > 1)
+		store32(dst + stride, vgetq_lane_u32(v, 1));
+	if (n > 2)
+		store32(dst + stride * 2, vgetq_lane_u32(v, 2));
+	if (n > 3)
+		store32(dst + stride * 3, vgetq_lane_u32(v, 3));
+}
+
+// Same as float_to_satu8: only the 16 msbits of the floats are used, NaN gives 255
+static inline uint32x4_t floatToSatU8(float32x4_t v)
+{
+	v = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(v), vdupq_n_u32(0xffff0000)));
+	const uint32x4_t notNan = vceqq_f32(v, v);
+	const float32x4_t one = vdupq_n_f32(1.f);
+	float32x4_t c = vminq_f32(vmaxq_f32(v, vdupq_n_f32(0.f)), one);
+	c = vbslq_f32(notNan, c, one);
+	return vcvtq_u32_f32(vmulq_f32(c, vdupq_n_f32(255.f)));
+}
+
+// Byte table indices to permute two 32-bit values
+template<typename Perm>
+static inline uint8x8_t permutationTable()
+{
+	static const u8 table[8] {
+		(u8)Perm::from(0), (u8)Perm::from(1), (u8)Perm::from(2), (u8)Perm::from(3),
+		(u8)(Perm::from(0) + 4), (u8)(Perm::from(1) + 4), (u8)(Perm::from(2) + 4), (u8)(Perm::from(3) + 4),
+	};
+	return vld1_u8(table);
+}
+
+// Packed ARGB8888 colors
+template<int Red, int Green, int Blue, int Alpha>
+void packedColors(u8 *dst, size_t dstStride, const u8 *src, size_t srcStride, u32 count)
+{
+	const uint8x8_t table = permutationTable<BytePermutation<Blue, Green, Red, Alpha>>();
+	forEachBatch(count, [&](u32 i, auto n) {
+		const uint8x16_t v = vreinterpretq_u8_u32(gather(src + i * srcStride, srcStride, n));
+		const uint8x16_t res = vcombine_u8(vtbl1_u8(vget_low_u8(v), table), vtbl1_u8(vget_high_u8(v), table));
+		scatter(dst + i * dstStride, dstStride, vreinterpretq_u32_u8(res), n);
+	});
+}
+
+// Floating point A, R, G, B colors
+template<int Red, int Green, int Blue, int Alpha>
+void floatColors(u8 *dst, size_t dstStride, const u8 *src, size_t srcStride, u32 count)
+{
+	const uint8x8_t table = permutationTable<BytePermutation<Alpha, Red, Green, Blue>>();
+	forEachBatch(count, [&](u32 i, auto n) {
+		uint16x4_t c[4];
+		for (u32 j = 0; j < 4; j++)
+			c[j] = j < n ? vmovn_u32(floatToSatU8(vld1q_f32((const float *)(src + (i + j) * srcStride)))) : vdup_n_u16(0);
+		// bytes are A, R, G, B
+		const uint8x8_t c01 = vmovn_u16(vcombine_u16(c[0], c[1]));
+		const uint8x8_t c23 = vmovn_u16(vcombine_u16(c[2], c[3]));
+		const uint8x16_t res = vcombine_u8(vtbl1_u8(c01, table), vtbl1_u8(c23, table));
+		scatter(dst + i * dstStride, dstStride, vreinterpretq_u32_u8(res), n);
+	});
+}
+
+// Intensity colors: the rgb components of the face color are multiplied by the intensity
+template<int Alpha>
+void intensityColors(u8 *dst, size_t dstStride, const u8 *src, size_t srcStride, u32 count, const u8 faceColor[4])
+{
+	const uint16x8_t faceColors = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(load32(faceColor))));
+	// multiplying alpha by 256 leaves it unchanged
+	static const u16 alphaLanes[8] {
+		Alpha == 0 ? 0xffff : 0, Alpha == 1 ? 0xffff : 0, Alpha == 2 ? 0xffff : 0, Alpha == 3 ? 0xffff : 0,
+		Alpha == 0 ? 0xffff : 0, Alpha == 1 ? 0xffff : 0, Alpha == 2 ? 0xffff : 0, Alpha == 3 ? 0xffff : 0,
+	};
+	const uint16x8_t alphaMask = vld1q_u16(alphaLanes);
+	const uint16x8_t alphaMul = vdupq_n_u16(256);
+	forEachBatch(count, [&](u32 i, auto n) {
+		const float32x4_t intensity = vreinterpretq_f32_u32(gather(src + i * srcStride, srcStride, n));
+		const uint16x4_t sat = vmovn_u32(floatToSatU8(intensity));
+		const uint16x4x2_t sat0011 = vzip_u16(sat, sat);
+		const uint16x4x2_t sat01 = vzip_u16(sat0011.val[0], sat0011.val[0]);
+		const uint16x4x2_t sat23 = vzip_u16(sat0011.val[1], sat0011.val[1]);
+		const uint16x8_t mul01 = vbslq_u16(alphaMask, alphaMul, vcombine_u16(sat01.val[0], sat01.val[1]));
+		const uint16x8_t mul23 = vbslq_u16(alphaMask, alphaMul, vcombine_u16(sat23.val[0], sat23.val[1]));
+		const uint8x16_t res = vcombine_u8(vshrn_n_u16(vmulq_u16(faceColors, mul01), 8),
+				vshrn_n_u16(vmulq_u16(faceColors, mul23), 8));
+		scatter(dst + i * dstStride, dstStride, vreinterpretq_u32_u8(res), n);
+	});
+}
+
+// 16-bit uvs: v in the low half, u in the high half
+static inline void uv16(u8 *dst, size_t dstStride, const u8 *src, size_t srcStride, u32 count)
+{
+	forEachBatch(count, [&](u32 i, auto n) {
+		const uint32x4_t uv = gather(src + i * srcStride, srcStride, n);
+		const uint32x4x2_t out = vzipq_u32(vandq_u32(uv, vdupq_n_u32(0xffff0000)), vshlq_n_u32(uv, 16));
+		u8 *p = dst + i * dstStride;
+		for (u32 j = 0; j < n; j++, p += dstStride)
+		{
+			const uint32x4_t uv01 = out.val[j / 2];
+			const uint32x2_t v = j & 1 ? vget_high_u32(uv01) : vget_low_u32(uv01);
+			vst1_u32((u32 *)p, v);
+		}
+	});
+}
+
+#endif
+
+}	// namespace vtxconv
+
+#endif	// TA_VTX_SIMD
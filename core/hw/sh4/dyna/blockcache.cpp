@@ -0,0 +1,289 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "blockcache.h"
+#include "hw/mem/addrspace.h"
+#include "hw/sh4/sh4_core.h"
+#include "hw/sh4/sh4_mem.h"
+#include "hw/sh4/modules/mmu.h"
+#include "cfg/option.h"
+#include "oslib/oslib.h"
+#include <nowide/cstdio.hpp>
+#include <xxhash.h>
+#include <cctype>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#if FEAT_SHREC != DYNAREC_NONE
+
+namespace blockcache
+{
+
+static_assert(std::is_trivially_copyable_v<shil_opcode>);
+
+constexpr u32 CacheMagic = 0x43344853;	// SH4C
+constexpr u32 CacheVersion = 1;
+constexpr size_t MaxBlocks = 256 * 1024;
+constexpr u32 MaxBlockOps = 1024;
+
+struct Entry
+{
+	u32 flags;
+	u32 sh4CodeSize;
+	u64 hash;
+	u32 guestCycles;
+	u32 guestOpcodes;
+	u32 branchBlock;
+	u32 nextBlock;
+	u32 blockType;
+	u8 hasJcond;
+	u8 hasFpuOp;
+	u8 readOnly;
+	std::vector<shil_opcode> oplist;
+};
+
+static std::unordered_map<u64, std::vector<Entry>> entries;
+static size_t entryCount;
+static std::string currentGameId;
+static bool loaded;
+static bool dirty;
+
+static u64 makeKey(const RuntimeBlockInfo *block) {
+	return ((u64)block->vaddr << 32) | block->addr;
+}
+
+// The decoding depends on the fpu configuration, whether the mmu is enabled, the cpu clock
+// and whether the block is a superblock
+static u32 makeFlags(const RuntimeBlockInfo *block) {
+	return block->fpu_cfg.PR | (block->fpu_cfg.SZ << 1) | (block->fpu_cfg.RM << 2) | ((u32)mmu_enabled() << 4)
+			| ((u32)block->superblock << 5) | ((u32)config::Sh4Clock << 8);
+}
+
+// Hash the guest code of the block.
+// Read-only blocks may have constants from their memory pages propagated, so all the pages are hashed.
+static u64 hashCode(u32 addr, u32 size, bool readOnly)
+{
+	u32 start = addr;
+	u32 end = addr + size;
+	if (readOnly)
+	{
+		start &= ~PAGE_MASK;
+		end = (end + PAGE_MASK) & ~PAGE_MASK;
+	}
+	bool isRam;
+	const u8 *p = (const u8 *)addrspace::readConst(start, isRam, 4);
+	if (isRam)
+	{
+		bool isRamEnd;
+		const u8 *pend = (const u8 *)addrspace::readConst(end - 2, isRamEnd, 2);
+		if (isRamEnd && pend == p + (end - 2 - start))
+			return XXH3_64bits(p, end - start);
+	}
+	// Not contiguous in host memory
+	std::vector<u16> code;
+	code.reserve((end - start) / 2);
+	for (u32 a = start; a < end; a += 2)
+		code.push_back(ReadMem16_nommu(a));
+	return XXH3_64bits(code.data(), code.size() * sizeof(u16));
+}
+
+static std::string getCachePath(const std::string& gameId)
+{
+	std::string name = "sh4cache_";
+	for (char c : gameId.empty() ? std::string("bios") : gameId)
+		name += std::isalnum((u8)c) ? c : '_';
+	return hostfs::getShaderCachePath(name + ".bin");
+}
+
+template<typename T>
+static bool readValue(FILE *fp, T& v) {
+	return std::fread(&v, sizeof(T), 1, fp) == 1;
+}
+template<typename T>
+static bool writeValue(FILE *fp, const T& v) {
+	return std::fwrite(&v, sizeof(T), 1, fp) == 1;
+}
+
+static void load()
+{
+	entries.clear();
+	entryCount = 0;
+	dirty = false;
+	std::string path = getCachePath(currentGameId);
+	FILE *fp = nowide::fopen(path.c_str(), "rb");
+	if (fp == nullptr)
+		return;
+	u32 magic, version;
+	if (!readValue(fp, magic) || magic != CacheMagic
+			|| !readValue(fp, version) || version != CacheVersion)
+	{
+		INFO_LOG(DYNAREC, "Ignoring incompatible block cache %s", path.c_str());
+		std::fclose(fp);
+		return;
+	}
+	while (entryCount < MaxBlocks)
+	{
+		u64 key;
+		u32 opCount;
+		Entry entry;
+		if (!readValue(fp, key) || !readValue(fp, entry.flags) || !readValue(fp, entry.sh4CodeSize)
+				|| !readValue(fp, entry.hash) || !readValue(fp, entry.guestCycles) || !readValue(fp, entry.guestOpcodes)
+				|| !readValue(fp, entry.branchBlock) || !readValue(fp, entry.nextBlock) || !readValue(fp, entry.blockType)
+				|| !readValue(fp, entry.hasJcond) || !readValue(fp, entry.hasFpuOp) || !readValue(fp, entry.readOnly)
+				|| !readValue(fp, opCount) || opCount > MaxBlockOps)
+			break;
+		entry.oplist.resize(opCount);
+		if (std::fread(entry.oplist.data(), sizeof(shil_opcode), opCount, fp) != opCount)
+			break;
+		entries[key].push_back(std::move(entry));
+		entryCount++;
+	}
+	std::fclose(fp);
+	NOTICE_LOG(DYNAREC, "Loaded %d blocks from %s", (int)entryCount, path.c_str());
+}
+
+void save()
+{
+	if (!loaded || !dirty)
+		return;
+	std::string path = getCachePath(currentGameId);
+	FILE *fp = nowide::fopen(path.c_str(), "wb");
+	if (fp == nullptr)
+	{
+		WARN_LOG(DYNAREC, "Cannot save block cache to %s", path.c_str());
+		return;
+	}
+	bool success = writeValue(fp, CacheMagic) && writeValue(fp, CacheVersion);
+	for (const auto& [key, list] : entries)
+	{
+		for (const Entry& entry : list)
+		{
+			u32 opCount = entry.oplist.size();
+			success = success && writeValue(fp, key) && writeValue(fp, entry.flags) && writeValue(fp, entry.sh4CodeSize)
+					&& writeValue(fp, entry.hash) && writeValue(fp, entry.guestCycles) && writeValue(fp, entry.guestOpcodes)
+					&& writeValue(fp, entry.branchBlock) && writeValue(fp, entry.nextBlock) && writeValue(fp, entry.blockType)
+					&& writeValue(fp, entry.hasJcond) && writeValue(fp, entry.hasFpuOp) && writeValue(fp, entry.readOnly)
+					&& writeValue(fp, opCount)
+					&& std::fwrite(entry.oplist.data(), sizeof(shil_opcode), opCount, fp) == opCount;
+		}
+		if (!success)
+			break;
+	}
+	std::fclose(fp);
+	if (success) {
+		NOTICE_LOG(DYNAREC, "Saved %d blocks to %s", (int)entryCount, path.c_str());
+		dirty = false;
+	}
+	else {
+		WARN_LOG(DYNAREC, "Error saving block cache to %s", path.c_str());
+		nowide::remove(path.c_str());
+	}
+}
+
+void setGame(const std::string& gameId)
+{
+	if (!config::DynarecPersistentCache)
+	{
+		save();
+		entries.clear();
+		entryCount = 0;
+		loaded = false;
+		return;
+	}
+	if (loaded && gameId == currentGameId)
+		return;
+	save();
+	currentGameId = gameId;
+	load();
+	loaded = true;
+}
+
+bool lookup(RuntimeBlockInfo *block, bool& protectedFlagsSet)
+{
+	protectedFlagsSet = false;
+	if (!loaded)
+		return false;
+	auto it = entries.find(makeKey(block));
+	if (it == entries.end())
+		return false;
+	const u32 flags = makeFlags(block);
+	for (const Entry& entry : it->second)
+	{
+		if (entry.flags != flags)
+			continue;
+		if (entry.hasFpuOp && Sh4cntx.sr.FD == 1)
+			// Let the decoder raise the exception
+			return false;
+		if (hashCode(block->addr, entry.sh4CodeSize, entry.readOnly) != entry.hash)
+			continue;
+		// Same code so same size
+		block->sh4_code_size = entry.sh4CodeSize;
+		block->SetProtectedFlags();
+		protectedFlagsSet = true;
+		if (entry.readOnly && !block->read_only)
+			// Constant propagation from unprotected memory isn't safe
+			return false;
+		block->guest_cycles = entry.guestCycles;
+		block->guest_opcodes = entry.guestOpcodes;
+		block->BranchBlock = entry.branchBlock;
+		block->NextBlock = entry.nextBlock;
+		block->BlockType = (BlockEndType)entry.blockType;
+		block->has_jcond = entry.hasJcond;
+		block->has_fpu_op = entry.hasFpuOp;
+		block->oplist = entry.oplist;
+		return true;
+	}
+	return false;
+}
+
+void add(const RuntimeBlockInfo *block)
+{
+	if (!loaded || entryCount >= MaxBlocks)
+		return;
+	Entry entry;
+	entry.flags = makeFlags(block);
+	entry.sh4CodeSize = block->sh4_code_size;
+	entry.readOnly = block->read_only;
+	entry.hash = hashCode(block->addr, block->sh4_code_size, block->read_only);
+	entry.guestCycles = block->guest_cycles;
+	entry.guestOpcodes = block->guest_opcodes;
+	entry.branchBlock = block->BranchBlock;
+	entry.nextBlock = block->NextBlock;
+	entry.blockType = block->BlockType;
+	entry.hasJcond = block->has_jcond;
+	entry.hasFpuOp = block->has_fpu_op;
+	entry.oplist = block->oplist;
+
+	std::vector<Entry>& list = entries[makeKey(block)];
+	for (Entry& e : list)
+		if (e.flags == entry.flags && e.readOnly == entry.readOnly)
+		{
+			// Code has changed
+			e = std::move(entry);
+			dirty = true;
+			return;
+		}
+	list.push_back(std::move(entry));
+	entryCount++;
+	dirty = true;
+}
+
+}	// namespace blockcache
+
+#endif	// FEAT_SHREC != DYNAREC_NONE
@@ -0,0 +1,44 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "blockmanager.h"
+#include <string>
+
+//
+// Persistent cache of decoded and optimized sh4 blocks.
+// Blocks are keyed by their virtual and physical addresses, fpu and mmu configuration,
+// and a hash of the guest code. One cache file is kept per game.
+//
+namespace blockcache
+{
+
+// Save the cache of the current game and load the one of the given game if needed.
+void setGame(const std::string& gameId);
+// Save the cache of the current game
+void save();
+
+// Set up the block from the cache. The block vaddr, addr and fpu_cfg must be set.
+// Returns true if found, in which case the protected flags of the block are also set.
+// If false is returned and protectedFlagsSet is true, the block protected flags have been set
+// but the block still needs to be decoded.
+bool lookup(RuntimeBlockInfo *block, bool& protectedFlagsSet);
+// Add a newly decoded and optimized block to the cache
+void add(const RuntimeBlockInfo *block);
+
+}
@@ -37,6 +37,9 @@ bool *unprotected_pages;
 static std::set<RuntimeBlockInfo*> *blocks_per_page;
 
 static bm_Map blkmap;
+// Blocks being compiled in the background. They aren't in the block map yet
+// but their memory pages are already protected.
+static std::set<RuntimeBlockInfo*> pending_blocks;
 // Stats
 u32 protected_blocks;
 u32 unprotected_blocks;
@@ -262,6 +265,65 @@ void bm_DiscardBlock(RuntimeBlockInfo* block)
 	block_ptr->Discard();
 }
 
+void bm_AddPendingBlock(RuntimeBlockInfo* blk)
+{
+	pending_blocks.insert(blk);
+}
+
+bool bm_CommitPendingBlock(RuntimeBlockInfo* blk)
+{
+	if (pending_blocks.erase(blk) == 0)
+	{
+		// Invalidated while being compiled
+		delete blk;
+		return false;
+	}
+	if (blk->code == nullptr || (void*)bm_GetCode(blk->addr) != (void*)ngen_FailedToFindBlock)
+	{
+		// Not compiled, or compiled synchronously in the meantime
+		blk->Discard();
+		delete blk;
+		return false;
+	}
+	bm_AddBlock(blk);
+	return true;
+}
+
+// Discard the blocks whose code is in [start, end[ (RW addresses) so that this part
+// of the code buffer can be reused. Other blocks are kept.
+u32 bm_DiscardCodeRange(void *start, void *end)
+{
+	u32 count = 0;
+	auto it = blkmap.lower_bound(start);
+	while (it != blkmap.end() && it->first < end)
+	{
+		RuntimeBlockInfoPtr block = it->second;
+		++it;
+		// The successors must not relink this block once its code is overwritten
+		if (block->pNextBlock != nullptr)
+			block->pNextBlock->RemRef(block);
+		if (block->pBranchBlock != nullptr)
+			block->pBranchBlock->RemRef(block);
+		bm_DiscardBlock(block.get());
+		count++;
+	}
+	return count;
+}
+
+// Returns the sum of the hotness of the blocks whose code is in [start, end[.
+// If age is true, the hotness of these blocks is halved.
+u64 bm_GetCodeRangeHotness(void *start, void *end, bool age)
+{
+	u64 hotness = 0;
+	for (auto it = blkmap.lower_bound(start); it != blkmap.end() && it->first < end; ++it)
+	{
+		hotness += it->second->hotness;
+		if (age)
+			it->second->hotness /= 2;
+	}
+	return hotness;
+}
+
 void bm_Periodical_1s()
 {
 	bm_CleanupDeletedBlocks();
@@ -345,6 +407,8 @@ void bm_ResetCache()
 	blkmap.clear();
 	// blkmap includes temp blocks as well
 	all_temp_blocks.clear();
+	// blocks still being compiled will be deleted when committed
+	pending_blocks.clear();
 
 	for (size_t i = 0; i < pageCount; i++)
 		blocks_per_page[i].clear();
@@ -449,9 +513,8 @@ void RuntimeBlockInfo::AddRef(const RuntimeBlockInfoPtr& other)
 
 void RuntimeBlockInfo::RemRef(const RuntimeBlockInfoPtr& other)
 {
-	auto it = std::find(pre_refs.begin(), pre_refs.end(), other);
-	if (it != pre_refs.end())
-		pre_refs.erase(it);
+	// A block linking both its next and branch blocks to the same block is referenced twice
+	pre_refs.erase(std::remove(pre_refs.begin(), pre_refs.end(), other), pre_refs.end());
 }
 
 void RuntimeBlockInfo::Discard()
@@ -524,7 +587,15 @@ void bm_RamWriteAccess(u32 addr)
 		if (!list_copy.empty())
 			DEBUG_LOG(DYNAREC, "bm_RamWriteAccess write access to %08x pc %08x", addr, Sh4cntx.pc);
 		for (auto& block : list_copy)
-			bm_DiscardBlock(block);
+		{
+			if (pending_blocks.erase(block) != 0)
+			{
+				rdv_PendingBlockDiscarded(block);
+				block->Discard();
+			}
+			else
+				bm_DiscardBlock(block);
+		}
 		verify(block_list.empty());
 	}
 }
@@ -13,7 +13,7 @@ typedef std::shared_ptr<RuntimeBlockInfo> RuntimeBlockInfoPtr;
 
 struct RuntimeBlockInfo
 {
-	bool Setup(u32 pc,fpscr_t fpu_cfg);
+	bool Setup(u32 pc,fpscr_t fpu_cfg,bool superblock = false);
 
 	u32 addr;
 	u32 vaddr;
@@ -29,6 +29,8 @@ struct RuntimeBlockInfo
 	bool has_fpu_op;
 	bool temp_block;
 	u32 blockcheck_failures;
+	u32 hotness;	// execution samples, halved each time the code cache is full
+	bool superblock;	// decoded across unconditional forward branches
 
 	u32 BranchBlock; //if not 0xFFFFFFFF then jump target
 	u32 NextBlock;   //if not 0xFFFFFFFF then next block (by position)
@@ -75,6 +77,14 @@ RuntimeBlockInfoPtr DYNACALL bm_GetBlock(u32 addr);
 
 void bm_AddBlock(RuntimeBlockInfo* blk);
 void bm_DiscardBlock(RuntimeBlockInfo* block);
+// Register a block that is being compiled in another thread.
+// Its code isn't available yet but it is invalidated if its memory pages are written to.
+void bm_AddPendingBlock(RuntimeBlockInfo* blk);
+// Add a block compiled in another thread to the block map.
+// Returns false and deletes the block if it has been invalidated, not compiled or superseded.
+bool bm_CommitPendingBlock(RuntimeBlockInfo* blk);
+u32 bm_DiscardCodeRange(void *start, void *end);
+u64 bm_GetCodeRangeHotness(void *start, void *end, bool age);
 void bm_Reset();
 void bm_ResetCache();
 void bm_ResetTempCache(bool full);
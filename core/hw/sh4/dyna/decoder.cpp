@@ -21,6 +21,8 @@
 
 #define BLOCK_MAX_SH_OPS_SOFT 500
 #define BLOCK_MAX_SH_OPS_HARD 511
+// Maximum size of the guest code range covered by a superblock
+#define SUPERBLOCK_MAX_SIZE 1024
 
 static RuntimeBlockInfo* blk;
 static Sh4Cycles cycleCounter;
@@ -1023,6 +1025,20 @@ bool dec_DecodeBlock(RuntimeBlockInfo* rbi,u32 max_cycles)
 			break;
 
 		case NDO_End:
+			// Superblocks continue with the target of unconditional forward branches so that
+			// the optimizer works across them. The block still covers a contiguous range of guest code.
+			if (blk->superblock && state.BlockType == BET_StaticJump
+					&& state.JumpAddr > state.cpu.rpc && state.JumpAddr - blk->vaddr < SUPERBLOCK_MAX_SIZE
+					&& blk->oplist.size() < BLOCK_MAX_SH_OPS_SOFT && blk->guest_cycles < max_cycles)
+			{
+				state.cpu.rpc = state.JumpAddr;
+				state.cpu.is_delayslot = false;
+				state.NextOp = NDO_NextOp;
+				state.BlockType = BET_SCL_Intr;
+				state.JumpAddr = NullAddress;
+				state.NextAddr = NullAddress;
+				continue;
+			}
 			// Disabled for now since we need to know if the block is read-only,
 			// which isn't determined until after the decoding.
 			// This is a relatively rare optimization anyway
@@ -1,4 +1,6 @@
 #include "types.h"
+#include <mutex>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "hw/sh4/sh4_interpreter.h"
@@ -6,27 +8,64 @@
 #include "hw/sh4/sh4_interrupts.h"
 
 #include "hw/sh4/sh4_mem.h"
+#include "hw/sh4/sh4_sched.h"
 #include "hw/sh4/modules/mmu.h"
 
 #include "blockmanager.h"
 #include "ngen.h"
 #include "decoder.h"
+#include "blockcache.h"
 #include "oslib/virtmem.h"
+#include "util/worker_thread.h"
+#include "cfg/option.h"
+#include "profiler/telemetry.h"
 
 #if FEAT_SHREC != DYNAREC_NONE
 
+// Background compilation is only supported by the x64 and arm64 dynarecs, and
+// code can only be generated by the emulation thread on iOS and UWP.
+#if (HOST_CPU == CPU_X64 || HOST_CPU == CPU_ARM64) && !defined(TARGET_IPHONE) && !defined(TARGET_UWP)
+#define BACKGROUND_COMPILE
+#endif
+
 constexpr u32 CODE_SIZE = 10_MB;
 constexpr u32 TEMP_CODE_SIZE = 1_MB;
 constexpr u32 FULL_SIZE = CODE_SIZE + TEMP_CODE_SIZE;
 DECLARE_CODE_CACHE(SH4_TCB, FULL_SIZE)
+// The long term code buffer is split in regions that are filled in turn.
+// When all regions are full, the coldest one is evicted instead of clearing the whole cache.
+constexpr u32 CODE_REGION_SIZE = 1_MB;
+constexpr u32 CODE_REGION_COUNT = CODE_SIZE / CODE_REGION_SIZE;
+static_assert(CODE_SIZE % CODE_REGION_SIZE == 0);
+// SH4 cycles between two samples of the running block, used to measure block hotness
+constexpr int HOTNESS_SAMPLE_CYCLES = 20000;
+// Hotness above which a block ending with an unconditional branch is recompiled as a superblock
+constexpr u32 SUPERBLOCK_HOTNESS = 16;
 
 static u8* CodeCache;
 static u8* TempCodeCache;
 ptrdiff_t cc_rx_offset;
 
 static std::unordered_set<u32> smc_hotspots;
+// Hot blocks to be decoded as superblocks
+static std::unordered_set<u32> superblocks;
+
+static u32 currentRegion;
+static bool regionUsed[CODE_REGION_COUNT];
+// Start of the first region, after the main loop and other static code
+static u32 firstRegionStart;
+static bool firstRegionStartSet;
+// Region of the block being linked, that must not be evicted
+static u32 pinnedRegion = CODE_REGION_COUNT;
+static int hotnessSchedId = -1;
+static u32 hotnessSamples;
+static u32 lastCompiledBlocks;
+static u32 lastEvictions;
+static Sh4Recompiler::CodeCacheStats cacheStats;
 
 static Sh4CodeBuffer codeBuffer;
+// Serializes the use of the code buffer by the emulation and compile threads
+static std::mutex codeBufferMutex;
 Sh4Dynarec *sh4Dynarec;
 Sh4Recompiler *Sh4Recompiler::Instance;
 
@@ -48,7 +87,7 @@ u32 Sh4CodeBuffer::getFreeSpace()
 	if (tempBuffer)
 		return TEMP_CODE_SIZE - tempLastAddr;
 	else
-		return CODE_SIZE - lastAddr;
+		return endAddr - lastAddr;
 }
 
 void *Sh4CodeBuffer::getBase()
@@ -63,10 +102,179 @@ u32 Sh4CodeBuffer::getSize()
 
 void Sh4CodeBuffer::reset(bool temporary)
 {
-	if (temporary)
+	if (temporary) {
 		tempLastAddr = 0;
+	}
 	else
+	{
 		lastAddr = 0;
+		endAddr = CODE_REGION_SIZE;
+	}
+}
+
+void Sh4CodeBuffer::setRegion(u32 start, u32 end)
+{
+	lastAddr = start;
+	endAddr = end;
+}
+
+#ifdef BACKGROUND_COMPILE
+// Blocks are decoded and optimized by the emulation thread since this may raise sh4 exceptions,
+// then compiled by a worker thread. They are run by the interpreter until their code is ready.
+struct PendingBlock
+{
+	RuntimeBlockInfo *block;
+	u32 size;		// sh4 code size
+	u32 cycles;		// guest cycles
+};
+static WorkerThread compileThread("Sh4Compiler");
+// Blocks compiled by the worker thread, pushed with codeBufferMutex held
+static TsQueue<RuntimeBlockInfo *> compiledBlocks;
+// Blocks being compiled by vaddr. Only used by the emulation thread
+static std::unordered_map<u32, PendingBlock> pendingBlocks;
+// Incremented when the code buffer is cleared to drop the stale compile jobs. Protected by codeBufferMutex
+static u32 compileGeneration;
+
+static bool backgroundCompileEnabled() {
+	// Net rollbacks need a deterministic block map
+	return config::DynarecBackgroundCompile && !mmu_enabled() && !config::GGPOEnable;
+}
+
+static bool superblocksEnabled() {
+	// Superblock promotion isn't restored by net rollbacks and would change the interrupt check points
+	return !mmu_enabled() && !config::GGPOEnable;
+}
+
+static void queueBlock(RuntimeBlockInfo *block)
+{
+	bm_AddPendingBlock(block);
+	pendingBlocks[block->vaddr] = { block, block->sh4_code_size, block->guest_cycles };
+	const u32 generation = compileGeneration;
+	compileThread.run([block, generation]() {
+		TELEMETRY_SCOPE(DynarecCompile);
+		std::lock_guard<std::mutex> _(codeBufferMutex);
+		// Drop stale jobs, and leave the switch to the next code region to the emulation thread
+		if (generation == compileGeneration && codeBuffer.getFreeSpace() >= 32_KB)
+			// Protected blocks don't need self-modifying code checks
+			sh4Dynarec->compile(block, false, true);
+		compiledBlocks.push(block);
+	});
+}
+
+// Forget a block invalidated while being compiled so that it isn't interpreted with its old size and cycles
+void rdv_PendingBlockDiscarded(RuntimeBlockInfo *block)
+{
+	auto it = pendingBlocks.find(block->vaddr);
+	if (it != pendingBlocks.end() && it->second.block == block)
+		pendingBlocks.erase(it);
+}
+
+// Add the blocks compiled in the background to the block map
+static void commitCompiledBlocks()
+{
+	while (!compiledBlocks.empty())
+	{
+		RuntimeBlockInfo *block = compiledBlocks.pop();
+		auto it = pendingBlocks.find(block->vaddr);
+		if (it != pendingBlocks.end() && it->second.block == block)
+			pendingBlocks.erase(it);
+		if (bm_CommitPendingBlock(block))
+		{
+			cacheStats.compiledBlocks++;
+#if HOST_CPU == CPU_ARM64
+			// The code has been written by another core
+			u8 *code = (u8 *)block->code;
+			u8 *rxCode = (u8 *)CC_RW2RX(code);
+			virtmem::flush_cache(rxCode, rxCode + block->host_code_size, code, code + block->host_code_size);
+#endif
+		}
+	}
+}
+#else
+void rdv_PendingBlockDiscarded(RuntimeBlockInfo *block) {
+}
+#endif
+
+static u32 regionStart(u32 region) {
+	return region == 0 ? firstRegionStart : region * CODE_REGION_SIZE;
+}
+
+static u32 codeRegion(const void *code) {
+	return (u32)((const u8 *)code - CodeCache) / CODE_REGION_SIZE;
+}
+
+// Switch to the next code region when the current one is full.
+// An empty region is used if available. Otherwise the region with the lowest hotness is evicted.
+// codeBufferMutex must be held.
+static void nextCodeRegion()
+{
+#ifdef BACKGROUND_COMPILE
+	// Blocks compiled in the evicted region must be in the block map to be discarded
+	commitCompiledBlocks();
+#endif
+	u32 region = CODE_REGION_COUNT;
+	for (u32 i = 0; i < CODE_REGION_COUNT; i++)
+		if (!regionUsed[i])
+		{
+			region = i;
+			break;
+		}
+	if (region == CODE_REGION_COUNT)
+	{
+		u64 minHotness = ~0ull;
+		for (u32 i = 0; i < CODE_REGION_COUNT; i++)
+		{
+			u64 hotness = bm_GetCodeRangeHotness(&CodeCache[regionStart(i)], &CodeCache[(i + 1) * CODE_REGION_SIZE], true);
+			if (i != currentRegion && i != pinnedRegion && hotness < minHotness)
+			{
+				minHotness = hotness;
+				region = i;
+			}
+		}
+		u32 blocks = bm_DiscardCodeRange(&CodeCache[regionStart(region)], &CodeCache[(region + 1) * CODE_REGION_SIZE]);
+		DEBUG_LOG(DYNAREC, "Code region %d evicted: %d blocks, hotness %d", region, blocks, (int)minHotness);
+		cacheStats.evictions++;
+		cacheStats.evictedBlocks += blocks;
+	}
+	regionUsed[region] = true;
+	currentRegion = region;
+	codeBuffer.setRegion(regionStart(region), (region + 1) * CODE_REGION_SIZE);
+}
+
+// Sample the block being executed to find the hot code regions
+static int hotnessSampler(int tag, int cycles, int jitter, void *arg)
+{
+	// Translating the pc would update the mmu state
+	if (!mmu_enabled())
+	{
+		RuntimeBlockInfoPtr block = bm_GetBlock(Sh4cntx.pc);
+		if (block && ++block->hotness >= SUPERBLOCK_HOTNESS && superblocksEnabled()
+				&& !block->superblock && !block->temp_block && block->read_only
+				&& block->BlockType == BET_StaticJump && block->BranchBlock > block->addr + block->sh4_code_size)
+		{
+			// Discard the block so that it's recompiled as a superblock next time it's run
+			DEBUG_LOG(DYNAREC, "Superblock @ %08x hotness %d", block->addr, block->hotness);
+			superblocks.insert(block->addr);
+			bm_DiscardBlock(block.get());
+			cacheStats.superblocks++;
+		}
+	}
+	if (++hotnessSamples >= SH4_MAIN_CLOCK / HOTNESS_SAMPLE_CYCLES)
+	{
+		hotnessSamples = 0;
+		cacheStats.compiledPerSecond = cacheStats.compiledBlocks - lastCompiledBlocks;
+		cacheStats.evictionsPerSecond = cacheStats.evictions - lastEvictions;
+		lastCompiledBlocks = cacheStats.compiledBlocks;
+		lastEvictions = cacheStats.evictions;
+		if (cacheStats.evictionsPerSecond != 0)
+			DEBUG_LOG(DYNAREC, "Code cache: %d blocks compiled/s, %d regions evicted/s",
+					cacheStats.compiledPerSecond, cacheStats.evictionsPerSecond);
+	}
+	return HOTNESS_SAMPLE_CYCLES;
+}
+
+const Sh4Recompiler::CodeCacheStats& Sh4Recompiler::getCodeCacheStats() {
+	return cacheStats;
 }
 
 void Sh4Recompiler::clear_temp_cache(bool full)
@@ -78,11 +286,51 @@ void Sh4Recompiler::clear_temp_cache(bool full)
 
 void Sh4Recompiler::ResetCache()
 {
+	std::lock_guard<std::mutex> _(codeBufferMutex);
 	INFO_LOG(DYNAREC, "recSh4:Dynarec Cache clear at %08X free space %d", getContext()->pc, codeBuffer.getFreeSpace());
 	codeBuffer.reset(false);
 	bm_ResetCache();
 	smc_hotspots.clear();
+	superblocks.clear();
 	clear_temp_cache(true);
+	currentRegion = 0;
+	firstRegionStart = 0;
+	firstRegionStartSet = false;
+	std::fill(std::begin(regionUsed), std::end(regionUsed), false);
+	regionUsed[0] = true;
+	cacheStats.fullFlushes++;
+	if (hotnessSchedId != -1)
+		sh4_sched_request(hotnessSchedId, HOTNESS_SAMPLE_CYCLES);
+#ifdef BACKGROUND_COMPILE
+	compileGeneration++;
+	pendingBlocks.clear();
+	// No longer pending so deleted
+	commitCompiledBlocks();
+#endif
+}
+
+// Run the block at the current pc with the interpreter while it's being compiled.
+// The block is charged the same number of cycles as its compiled version.
+void Sh4Recompiler::interpretBlock(u32 size, u32 cycles)
+{
+	const u32 start = ctx->pc;
+	const int cycleCounter = ctx->cycle_counter;
+	try {
+		for (u32 i = 0; i < size / 2; i++)
+		{
+			ExecuteOpcode(ReadNexOp());
+			if (ctx->pc <= start || ctx->pc >= start + size)
+				break;
+		}
+	} catch (const SH4ThrownException& ex) {
+		Do_Exception(ex.epc, ex.expEvn);
+	}
+	ctx->cycle_counter = cycleCounter - cycles;
+	if (ctx->cycle_counter <= 0)
+	{
+		ctx->cycle_counter += SH4_TIMESLICE;
+		UpdateSystem_INTC();
+	}
 }
 
 void Sh4Recompiler::Run()
@@ -100,7 +348,7 @@ void Sh4Recompiler::Run()
 
 void AnalyseBlock(RuntimeBlockInfo* blk);
 
-bool RuntimeBlockInfo::Setup(u32 rpc,fpscr_t rfpu_cfg)
+bool RuntimeBlockInfo::Setup(u32 rpc,fpscr_t rfpu_cfg,bool rsuperblock)
 {
 	addr = host_code_size = 0;
 	guest_cycles = guest_opcodes = host_opcodes = 0;
@@ -113,6 +361,8 @@ bool RuntimeBlockInfo::Setup(u32 rpc,fpscr_t rfpu_cfg)
 	BlockType = BET_SCL_Intr;
 	has_fpu_op = false;
 	temp_block = false;
+	hotness = 0;
+	superblock = rsuperblock;
 	
 	vaddr = rpc;
 	if (vaddr & 1)
@@ -138,6 +388,10 @@ bool RuntimeBlockInfo::Setup(u32 rpc,fpscr_t rfpu_cfg)
 	
 	oplist.clear();
 
+	bool protectedFlagsSet;
+	if (blockcache::lookup(this, protectedFlagsSet))
+		return true;
+
 	try {
 		if (!dec_DecodeBlock(this, SH4_TIMESLICE / 2))
 			return false;
@@ -146,29 +400,50 @@ bool RuntimeBlockInfo::Setup(u32 rpc,fpscr_t rfpu_cfg)
 		Do_Exception(rpc, ex.expEvn);
 		return false;
 	}
-	SetProtectedFlags();
+	if (!protectedFlagsSet)
+		SetProtectedFlags();
 
 	AnalyseBlock(this);
+	blockcache::add(this);
 
 	return true;
 }
 
 //Called to compile code @pc
-static DynarecCodeEntryPtr compilePC(u32 blockcheck_failures)
+//If background is true, protected blocks are queued for compilation and nullptr is returned
+static DynarecCodeEntryPtr compilePC(u32 blockcheck_failures, bool background = false)
 {
+	TELEMETRY_SCOPE(DynarecCompile);
 	const u32 pc = Sh4cntx.pc;
 
-	if (codeBuffer.getFreeSpace() < 32_KB || pc == 0x8c0000e0 || pc == 0xac010000 || pc == 0xac008300)
+	if (pc == 0x8c0000e0 || pc == 0xac010000 || pc == 0xac008300)
 		Sh4Recompiler::Instance->ResetCache();
+	std::lock_guard<std::mutex> _(codeBufferMutex);
+	if (codeBuffer.getFreeSpace() < 32_KB)
+		nextCodeRegion();
 
 	RuntimeBlockInfo* rbi = sh4Dynarec->allocateBlock();
+	// The main loop is generated when allocating the first block
+	if (!firstRegionStartSet)
+	{
+		firstRegionStart = codeBuffer.getPosition();
+		firstRegionStartSet = true;
+	}
 
-	if (!rbi->Setup(pc, Sh4cntx.fpscr))
+	if (!rbi->Setup(pc, Sh4cntx.fpscr, superblocksEnabled() && superblocks.count(pc) != 0))
 	{
 		delete rbi;
 		return nullptr;
 	}
 	rbi->blockcheck_failures = blockcheck_failures;
+#ifdef BACKGROUND_COMPILE
+	// Unprotected blocks need self-modifying code checks, which are generated from the current guest code
+	if (background && rbi->read_only && smc_hotspots.find(rbi->addr) == smc_hotspots.end())
+	{
+		queueBlock(rbi);
+		return nullptr;
+	}
+#endif
 	if (smc_hotspots.find(rbi->addr) != smc_hotspots.end())
 	{
 		codeBuffer.useTempBuffer(true);
@@ -184,6 +459,7 @@ static DynarecCodeEntryPtr compilePC(u32 blockcheck_failures)
 	verify(rbi->code != nullptr);
 
 	bm_AddBlock(rbi);
+	cacheStats.compiledBlocks++;
 
 	codeBuffer.useTempBuffer(false);
 
@@ -199,6 +475,28 @@ DynarecCodeEntryPtr DYNACALL rdv_FailedToFindBlock(u32 pc)
 {
 	//DEBUG_LOG(DYNAREC, "rdv_FailedToFindBlock %08x", pc);
 	Sh4cntx.pc=pc;
+#ifdef BACKGROUND_COMPILE
+	if (backgroundCompileEnabled())
+	{
+		commitCompiledBlocks();
+		DynarecCodeEntryPtr code = bm_GetCodeByVAddr(pc);
+		if (code != ngen_FailedToFindBlock)
+			return code;
+		auto it = pendingBlocks.find(pc);
+		if (it == pendingBlocks.end())
+		{
+			code = compilePC(0, true);
+			if (code != nullptr)
+				return (DynarecCodeEntryPtr)CC_RW2RX(code);
+			it = pendingBlocks.find(pc);
+			if (it == pendingBlocks.end() || Sh4cntx.pc != pc)
+				// sh4 exception
+				return bm_GetCodeByVAddr(Sh4cntx.pc);
+		}
+		Sh4Recompiler::Instance->interpretBlock(it->second.size, it->second.cycles);
+		return bm_GetCodeByVAddr(Sh4cntx.pc);
+	}
+#endif
 	DynarecCodeEntryPtr code = compilePC(0);
 	if (code == NULL)
 		code = bm_GetCodeByVAddr(Sh4cntx.pc);
@@ -286,7 +584,11 @@ void* DYNACALL rdv_LinkBlock(u8* code,u32 dpc)
 			Sh4cntx.pc = rbi->NextBlock;
 	}
 
+	if (!stale_block && !rbi->temp_block)
+		// The linking code must not be overwritten
+		pinnedRegion = codeRegion((void *)rbi->code);
 	DynarecCodeEntryPtr rv = findOrCompile();  // Returns rx ptr
+	pinnedRegion = CODE_REGION_COUNT;
 
 	if (mmu_enabled())
 		return (void *)rv;
@@ -336,7 +638,10 @@ void Sh4Recompiler::Reset(bool hard)
 	super::Reset(hard);
 	ResetCache();
 	if (hard)
+	{
 		bm_Reset();
+		blockcache::setGame(settings.content.gameId);
+	}
 }
 
 void Sh4Recompiler::Init()
@@ -361,12 +666,21 @@ void Sh4Recompiler::Init()
 
 	TempCodeCache = CodeCache + CODE_SIZE;
 	sh4Dynarec->init(*getContext(), codeBuffer);
+	codeBuffer.reset(false);
 	bm_ResetCache();
+	hotnessSchedId = sh4_sched_register(0, hotnessSampler);
+	sh4_sched_request(hotnessSchedId, HOTNESS_SAMPLE_CYCLES);
 }
 
 void Sh4Recompiler::Term()
 {
 	INFO_LOG(DYNAREC, "Sh4Recompiler::Term");
+#ifdef BACKGROUND_COMPILE
+	compileThread.stop();
+	commitCompiledBlocks();
+	pendingBlocks.clear();
+#endif
+	blockcache::save();
 #ifdef FEAT_NO_RWX_PAGES
 	if (CodeCache != nullptr)
 		virtmem::release_jit_block(CodeCache, (u8 *)CodeCache + cc_rx_offset, FULL_SIZE);
@@ -376,6 +690,8 @@ void Sh4Recompiler::Term()
 #endif
 	CodeCache = nullptr;
 	TempCodeCache = nullptr;
+	sh4_sched_unregister(hotnessSchedId);
+	hotnessSchedId = -1;
 	bm_Term();
 	super::Term();
 }
@@ -24,6 +24,8 @@ DynarecCodeEntryPtr DYNACALL rdv_FailedToFindBlock(u32 pc);
 DynarecCodeEntryPtr DYNACALL rdv_FailedToFindBlock_pc();
 //Called when a block check failed, and the block needs to be invalidated
 DynarecCodeEntryPtr DYNACALL rdv_BlockCheckFail(u32 addr);
+// Called when a block being compiled in the background is invalidated
+void rdv_PendingBlockDiscarded(RuntimeBlockInfo *block);
 // Registers a custom FailedToFindBlock handler function
 void rdv_SetFailedToFindBlockHandler(void (*handler)());
 
@@ -71,9 +73,14 @@ public:
 	void useTempBuffer(bool enable) { tempBuffer = enable; }
 	// Reset main or temp code buffer position to 0 (internal use)
 	void reset(bool temporary);
+	// Emit long term code in the region [start, end[ of the buffer (internal use)
+	void setRegion(u32 start, u32 end);
+	// Return the current offset in the long term buffer (internal use)
+	u32 getPosition() const { return lastAddr; }
 
 private:
 	u32 lastAddr = 0;
+	u32 endAddr = 0;
 	u32 tempLastAddr = 0;
 	bool tempBuffer = false;
 };
@@ -138,6 +145,20 @@ public:
 	void Term() override;
 
 	void clear_temp_cache(bool full);
+	// Interpret the block at the current pc (internal use)
+	void interpretBlock(u32 size, u32 cycles);
+
+	struct CodeCacheStats
+	{
+		u32 fullFlushes;		// Number of times the whole code cache was cleared
+		u32 evictions;			// Number of code regions evicted
+		u32 evictedBlocks;		// Number of blocks discarded by region evictions
+		u32 compiledBlocks;		// Total number of blocks compiled
+		u32 compiledPerSecond;	// Blocks compiled during the last emulated second
+		u32 evictionsPerSecond;	// Regions evicted during the last emulated second
+		u32 superblocks;		// Hot blocks recompiled as superblocks
+	};
+	static const CodeCacheStats& getCodeCacheStats();
 
 	static Sh4Recompiler *Instance;
 };
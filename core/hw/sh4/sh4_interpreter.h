@@ -21,11 +21,12 @@ public:
 	static Sh4Interpreter *Instance;
 
 protected:
+	void ExecuteOpcode(u16 op);
+	u16 ReadNexOp();
+
 	Sh4Context *ctx = nullptr;
 
 private:
-	void ExecuteOpcode(u16 op);
-	u16 ReadNexOp();
 
 	Sh4Cycles sh4cycles{CPU_RATIO};
 	// SH4 underclock factor when using the interpreter so that it's somewhat usable
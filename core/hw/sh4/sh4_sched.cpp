@@ -2,6 +2,7 @@
 #include "sh4_if.h"
 #include "sh4_sched.h"
 #include "serialize.h"
+#include "profiler/telemetry.h"
 
 #include <algorithm>
 #include <vector>
@@ -173,6 +174,7 @@ void sh4_sched_tick(int cycles)
 {
 	if (Sh4cntx.sh4_sched_next >= 0)
 		return;
+	TELEMETRY_SCOPE(Sh4Scheduler);
 
 	u32 fztime = sh4_sched_now() - cycles;
 	if (sh4_sched_next_id != -1)
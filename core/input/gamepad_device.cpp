@@ -22,6 +22,7 @@
 #include "stdclass.h"
 #include "ui/gui.h"
 #include "emulator.h"
+#include "rewinder.h"
 #include "hw/maple/maple_devs.h"
 #include "mouse.h"
 
@@ -143,6 +144,9 @@ bool GamepadDevice::handleButtonInput(int port, DreamcastKey key, bool pressed)
 			if (pressed)
 				gui_takeScreenshot();
 			break;
+		case EMU_BTN_REWIND:
+			rewinder::setRewinding(pressed && !gui_is_open());
+			break;
 		case DC_AXIS_LT:
 			if (port >= 0)
 				lt[port] = pressed ? 0xffff : 0;
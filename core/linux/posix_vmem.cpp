@@ -71,6 +71,14 @@ bool region_unlock(void *start, size_t len)
 	return true;
 }
 
+bool region_noaccess(void *start, size_t len)
+{
+	size_t inpage = (uintptr_t)start & PAGE_MASK;
+	if (mprotect((u8*)start - inpage, len + inpage, PROT_NONE))
+		die("mprotect failed...");
+	return true;
+}
+
 bool region_set_exec(void *start, size_t len)
 {
 	size_t inpage = (uintptr_t)start & PAGE_MASK;
@@ -132,21 +132,86 @@ static void (*chatCallback)(int playerNum, const std::string& msg);
 
 struct MemPages
 {
-	void load()
+	void load(int frame)
 	{
+		this->frame = frame;
 		memwatch::ramWatcher.getPages(ram);
 		memwatch::vramWatcher.getPages(vram);
 		memwatch::aramWatcher.getPages(aram);
 		memwatch::elanWatcher.getPages(elanram);
 	}
+	// The pages go back to the memwatch page pool
+	void clear()
+	{
+		frame = -1;
+		ram.clear();
+		vram.clear();
+		aram.clear();
+		elanram.clear();
+	}
+	int frame = -1;
 	memwatch::PageMap ram;
 	memwatch::PageMap vram;
 	memwatch::PageMap aram;
 	memwatch::PageMap elanram;
 };
-static std::unordered_map<int, MemPages> deltaStates;
+// GGPO keeps at most GGPO_MAX_PREDICTION_FRAMES + 2 saved states
+constexpr int MaxSavedStates = GGPO_MAX_PREDICTION_FRAMES + 2;
+// Pages written during each saved frame, indexed by frame number
+static std::array<MemPages, MaxSavedStates + 1> deltaStates;
 static int lastSavedFrame = -1;
 
+static MemPages& getDeltaState(int frame) {
+	return deltaStates[frame % deltaStates.size()];
+}
+
+// Restores each page once when rolling back several frames
+static struct RestoredPages
+{
+	void start()
+	{
+		const checkpoint::Regions regions = memwatch::regions();
+		for (int i = 0; i < checkpoint::RegionCount; i++)
+		{
+			restored[i].assign(regions[i].size / PAGE_SIZE, false);
+			count[i] = 0;
+		}
+	}
+
+	void restore(const MemPages& pages)
+	{
+		restore(memwatch::ramWatcher, pages.ram, 0);
+		restore(memwatch::vramWatcher, pages.vram, 1);
+		restore(memwatch::aramWatcher, pages.aram, 2);
+		restore(memwatch::elanWatcher, pages.elanram, 3);
+	}
+
+	template<typename T>
+	void restore(T& watcher, const memwatch::PageMap& pages, int region)
+	{
+		for (const auto& pair : pages)
+		{
+			const u32 page = pair.first / PAGE_SIZE;
+			if (restored[region][page])
+				continue;
+			restored[region][page] = true;
+			memcpy(watcher.getMemPage(pair.first), &pair.second.data[0], PAGE_SIZE);
+			count[region]++;
+		}
+	}
+
+	std::array<std::vector<bool>, checkpoint::RegionCount> restored;
+	std::array<int, checkpoint::RegionCount> count;
+} restoredPages;
+
+// Saved state buffers, reused from one frame to the next
+struct StateSlot
+{
+	std::vector<u8> data;
+	bool used = false;
+};
+static std::vector<StateSlot> stateSlots;
+
 static int timesyncOccurred;
 
 #pragma pack(push, 1)
@@ -298,20 +363,21 @@ static bool load_game_state(unsigned char *buffer, int len)
 	int frame;
 	deser >> frame;
 	memwatch::unprotect();
-	for (int f = lastSavedFrame - 1; f >= frame; f--)
+	restoredPages.start();
+	// A page saved in a frame delta holds its content when the frame was saved, and it hasn't changed
+	// until the frame it was first written in. So the oldest version of each page is the one to restore.
+	for (int f = frame; f < lastSavedFrame; f++)
 	{
-		const MemPages& pages = deltaStates[f];
-		for (const auto& pair : pages.ram)
-			memcpy(memwatch::ramWatcher.getMemPage(pair.first), &pair.second.data[0], PAGE_SIZE);
-		for (const auto& pair : pages.vram)
-			memcpy(memwatch::vramWatcher.getMemPage(pair.first), &pair.second.data[0], PAGE_SIZE);
-		for (const auto& pair : pages.aram)
-			memcpy(memwatch::aramWatcher.getMemPage(pair.first), &pair.second.data[0], PAGE_SIZE);
-		for (const auto& pair : pages.elanram)
-			memcpy(memwatch::elanWatcher.getMemPage(pair.first), &pair.second.data[0], PAGE_SIZE);
-		DEBUG_LOG(NETWORK, "Restored frame %d pages: %d ram, %d vram, %d eram, %d aica ram", f, (u32)pages.ram.size(),
-					(u32)pages.vram.size(), (u32)pages.elanram.size(), (u32)pages.aram.size());
+		const MemPages& pages = getDeltaState(f);
+		verify(pages.frame == f);
+		restoredPages.restore(pages);
 	}
+	// Pages written since the last saved frame
+	MemPages pages;
+	pages.load(lastSavedFrame);
+	restoredPages.restore(pages);
+	DEBUG_LOG(NETWORK, "Rollback to frame %d from %d: restored %d ram, %d vram, %d eram, %d aica ram pages", frame, lastSavedFrame,
+			restoredPages.count[0], restoredPages.count[1], restoredPages.count[3], restoredPages.count[2]);
 	dc_deserialize(deser);
 	if (deser.size() != (u32)len)
 	{
@@ -324,6 +390,15 @@ static bool load_game_state(unsigned char *buffer, int len)
 	return true;
 }
 
+// Size of a saved state buffer. Some headroom is added since the state size varies a bit.
+static size_t stateBufferSize(int frame)
+{
+	Serializer ser(nullptr, std::numeric_limits<size_t>::max(), true);
+	ser << frame;
+	dc_serialize(ser);
+	return ser.size() + ser.size() / 8;
+}
+
 /*
  * save_game_state - The client should allocate a buffer, copy the
  * entire contents of the current game state into it, and copy the
@@ -334,25 +409,37 @@ static bool save_game_state(unsigned char **buffer, int *len, int *checksum, int
 {
 	verify(!emu.getSh4Executor()->IsCpuRunning());
 	lastSavedFrame = frame;
-	// TODO this is way too much memory
-	size_t allocSize = settings.platform.isNaomi() ? 20_MB : 10_MB;
-	*buffer = (unsigned char *)malloc(allocSize);
-	if (*buffer == nullptr)
-	{
-		WARN_LOG(NETWORK, "Memory alloc failed");
-		*len = 0;
-		return false;
-	}
-	Serializer ser(*buffer, allocSize, true);
+	auto slot = std::find_if(stateSlots.begin(), stateSlots.end(), [](const StateSlot& slot) {
+		return !slot.used;
+	});
+	if (slot == stateSlots.end())
+		slot = stateSlots.emplace(stateSlots.end());
 	try {
-		ser << frame;
-		dc_serialize(ser);
+		if (slot->data.empty())
+			slot->data.resize(stateBufferSize(frame));
+		Serializer ser(slot->data.data(), slot->data.size(), true);
+		try {
+			ser << frame;
+			dc_serialize(ser);
+		} catch (const Serializer::Exception&) {
+			// The state has grown
+			slot->data.resize(stateBufferSize(frame));
+			ser = Serializer(slot->data.data(), slot->data.size(), true);
+			ser << frame;
+			dc_serialize(ser);
+		}
 		*len = ser.size();
 	} catch (const Serializer::Exception& e) {
 		WARN_LOG(NETWORK, "Save state failed: %s", e.what());
 		*len = 0;
 		return false;
+	} catch (const std::bad_alloc&) {
+		WARN_LOG(NETWORK, "Memory alloc failed");
+		*len = 0;
+		return false;
 	}
+	slot->used = true;
+	*buffer = slot->data.data();
 #ifdef SYNC_TEST
 	*checksum = XXH3_64bits(*buffer, usedSize);
 #endif
@@ -360,11 +447,11 @@ static bool save_game_state(unsigned char **buffer, int *len, int *checksum, int
 	if (frame > 0)
 	{
 #ifdef SYNC_TEST
-		if (deltaStates.count(frame - 1) != 0)
+		if (getDeltaState(frame - 1).frame == frame - 1)
 		{
 			MemPages memPages;
-			memPages.load();
-			const MemPages& savedPages = deltaStates[frame - 1];
+			memPages.load(frame - 1);
+			const MemPages& savedPages = getDeltaState(frame - 1);
 			//verify(memPages.ram.size() == savedPages.ram.size());
 			if (memPages.ram.size() != savedPages.ram.size())
 			{
@@ -404,9 +491,10 @@ static bool save_game_state(unsigned char **buffer, int *len, int *checksum, int
 		}
 #endif
 		// Save the delta to frame-1
-		deltaStates[frame - 1].load();
-		DEBUG_LOG(NETWORK, "Saved frame %d pages: %d ram, %d vram, %d eram, %d aica ram", frame - 1, (u32)deltaStates[frame - 1].ram.size(),
-				(u32)deltaStates[frame - 1].vram.size(), (u32)deltaStates[frame - 1].elanram.size(), (u32)deltaStates[frame - 1].aram.size());
+		MemPages& pages = getDeltaState(frame - 1);
+		pages.load(frame - 1);
+		DEBUG_LOG(NETWORK, "Saved frame %d pages: %d ram, %d vram, %d eram, %d aica ram", frame - 1, (u32)pages.ram.size(),
+				(u32)pages.vram.size(), (u32)pages.elanram.size(), (u32)pages.aram.size());
 	}
 
 	return true;
@@ -447,11 +535,15 @@ static void free_buffer(void *buffer)
 {
 	if (buffer != nullptr)
 	{
-		Deserializer deser(buffer, 1_MB, true);
+		// The state starts with the frame number
 		int frame;
-		deser >> frame;
-		deltaStates.erase(frame);
-		free(buffer);
+		memcpy(&frame, buffer, sizeof(frame));
+		MemPages& pages = getDeltaState(frame);
+		if (pages.frame == frame)
+			pages.clear();
+		for (StateSlot& slot : stateSlots)
+			if (slot.data.data() == buffer)
+				slot.used = false;
 	}
 }
 
@@ -488,6 +580,8 @@ void startSession(int localPort, int localPlayerNum)
 	cb.on_event        = on_event;
 	cb.log_game_state  = log_game_state;
 	cb.on_message      = on_message;
+	// The buffers are allocated by the first save_game_state calls
+	stateSlots.resize(MaxSavedStates);
 
 #ifdef SYNC_TEST
 	GGPOErrorCode result = ggpo_start_synctest(&ggpoSession, &cb, settings.content.gameId.c_str(), MAX_PLAYERS, sizeof(kcode[0]), 1);
@@ -620,6 +714,11 @@ void stopSession()
 	emu.setNetworkState(false);
 	memwatch::unprotect();
 	memwatch::reset();
+	// All the saved states have been freed by now
+	stateSlots.clear();
+	for (MemPages& pages : deltaStates)
+		pages.clear();
+	memwatch::pagePool.trim();
 }
 
 void getInput(MapleInputState inputState[4])
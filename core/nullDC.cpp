@@ -2,6 +2,8 @@
 #include "types.h"
 #include "emulator.h"
 #include "hw/mem/addrspace.h"
+#include "hw/mem/checkpoint.h"
+#include "hw/mem/mem_watch.h"
 #include "cfg/cfg.h"
 #include "cfg/option.h"
 #include "log/LogManager.h"
@@ -18,7 +20,10 @@
 #include "serialize.h"
 #include "oslib/i18n.h"
 #include "input/maplelink.h"
+#include "util/worker_thread.h"
 #include <time.h>
+#include <condition_variable>
+#include <memory>
 #ifdef TARGET_UWP
 #include <winrt/Windows.System.h>
 #include <winrt/Windows.Foundation.h>
@@ -66,6 +71,152 @@ struct SavestateHeader
 	static constexpr const char *MAGIC = "FLYSAVE1";
 };
 
+static bool writeSavestate(hostfs::File *f, const SavestateHeader& header, const u8 *pngData,
+		const void *data, size_t size, RZipFile::Codec codec)
+{
+	RZipFile zipFile;
+	bool success = f->write(&header, sizeof(header), 1) == 1
+			&& (header.pngSize == 0 || f->write(pngData, 1, header.pngSize) == header.pngSize)
+			&& zipFile.Open(f, true, codec)
+			&& zipFile.Write(data, size) == size;
+	if (zipFile.rawFile() != nullptr)
+		zipFile.Close();
+	else
+		delete f;
+	return success;
+}
+
+//
+// Compresses and writes savestates in the background so that the emulation isn't stalled.
+// The number of savestates in flight is bounded to limit memory usage.
+//
+class SavestateWriter
+{
+public:
+	struct Savestate
+	{
+		std::string filename;
+		std::string contentPath;
+		int index;
+		SavestateHeader header;
+		std::vector<u8> pngData;
+		std::vector<u8> data;
+		RZipFile::Codec codec;
+	};
+
+	// Blocks if too many savestates are already pending
+	void write(std::shared_ptr<Savestate> state)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [this]() { return pending.size() < MaxPending; });
+			pending.push_back(state);
+		}
+		thread.run([this, state]() {
+			hostfs::File *f = hostfs::storage().openFile(state->filename.c_str(), "wb");
+			if (f == nullptr)
+			{
+				WARN_LOG(SAVESTATE, "Failed to save state - could not open %s for writing", state->filename.c_str());
+				os_notify(i18n::T("Cannot open save file"), 5000);
+			}
+			else if (!writeSavestate(f, state->header, state->pngData.data(), state->data.data(), state->data.size(), state->codec))
+			{
+				WARN_LOG(SAVESTATE, "Failed to save state - error writing %s", state->filename.c_str());
+				os_notify(i18n::T("Error saving state"), 5000);
+			}
+			else
+			{
+				NOTICE_LOG(SAVESTATE, "Saved state to %s size %d", state->filename.c_str(), (int)state->data.size());
+				os_notify(i18n::T("State saved"), 2000);
+			}
+			{
+				std::lock_guard<std::mutex> _(mutex);
+				pending.erase(std::find(pending.begin(), pending.end(), state));
+			}
+			cond.notify_all();
+		});
+	}
+
+	// Wait until all pending savestates are written
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		cond.wait(lock, [this]() { return pending.empty(); });
+	}
+
+	// Returns the latest pending savestate of the current game for the given slot, if any
+	std::shared_ptr<const Savestate> find(int index)
+	{
+		std::lock_guard<std::mutex> _(mutex);
+		for (auto it = pending.rbegin(); it != pending.rend(); ++it)
+			if ((*it)->index == index && (*it)->contentPath == settings.content.path)
+				return *it;
+		return nullptr;
+	}
+
+private:
+	static constexpr size_t MaxPending = 2;
+
+	WorkerThread thread { "SavestateWriter" };
+	std::vector<std::shared_ptr<Savestate>> pending;
+	std::mutex mutex;
+	std::condition_variable cond;
+};
+static SavestateWriter savestateWriter;
+
+// In-ram savestates, saved incrementally
+static checkpoint::History checkpoints;
+constexpr size_t MaxCheckpointDeltas = 32;
+
+// The emulator must be stopped
+static void saveCheckpoint()
+{
+	// Memory regions aren't included in rollback mode
+	Serializer ser(nullptr, std::numeric_limits<size_t>::max(), true);
+	dc_serialize(ser);
+	std::vector<u8> state(ser.size());
+	ser = Serializer(state.data(), state.size(), true);
+	dc_serialize(ser);
+
+	if (checkpoints.empty() || memwatch::tracking != memwatch::Tracking::Checkpoints)
+	{
+		// First checkpoint or written pages haven't been tracked since the last one (state loaded, reset)
+		checkpoints.addKeyframe(memwatch::regions(), std::move(state));
+		memwatch::reset();
+		memwatch::tracking = memwatch::Tracking::Checkpoints;
+		memwatch::protect();
+		NOTICE_LOG(SAVESTATE, "Saved keyframe size %d", (int)checkpoints.memoryUsage());
+	}
+	else
+	{
+		// Protect the pages written since the last checkpoint again
+		memwatch::protect();
+		checkpoint::DirtyPages dirtyPages {
+			memwatch::ramWatcher.getDirtyPages(),
+			memwatch::vramWatcher.getDirtyPages(),
+			memwatch::aramWatcher.getDirtyPages(),
+			memwatch::elanWatcher.getDirtyPages(),
+		};
+		checkpoints.addDelta(memwatch::regions(), dirtyPages, std::move(state));
+		checkpoints.compact(MaxCheckpointDeltas);
+		NOTICE_LOG(SAVESTATE, "Saved checkpoint %d: %d ram, %d vram, %d aica ram, %d elan ram pages", (int)checkpoints.size() - 1,
+				(int)dirtyPages[0].size(), (int)dirtyPages[1].size(), (int)dirtyPages[2].size(), (int)dirtyPages[3].size());
+	}
+}
+
+// The emulator must be stopped
+static void loadCheckpoint(size_t index)
+{
+	memwatch::unprotect();
+	const std::vector<u8>& state = checkpoints.restore(index, memwatch::regions());
+	Deserializer deser(state.data(), state.size(), true);
+	emu.loadstate(deser);
+	// Track the pages written from this checkpoint on
+	memwatch::tracking = memwatch::Tracking::Checkpoints;
+	memwatch::protect();
+	NOTICE_LOG(SAVESTATE, "Loaded checkpoint %d", (int)index);
+}
+
 int flycast_init(int argc, char* argv[])
 {
 #if defined(TEST_AUTOMATION)
@@ -111,6 +262,9 @@ int flycast_init(int argc, char* argv[])
 
 		if(config::ProfilerEnabled)
 			LogManager::GetInstance()->SetEnable(LogTypes::PROFILER, true);
+		EventManager::listen(Event::Terminate, [](Event, void *) {
+			checkpoints.clear();
+		});
 
 		return 0;
 	} catch (const std::exception& e) {
@@ -168,6 +322,7 @@ void flycast_term()
 	gui_cancel_load();
 	lua::term();
 	emu.term();
+	savestateWriter.wait();
 	os_DestroyWindow();
 	gui_term();
 	os_TermInput();
@@ -182,89 +337,89 @@ void dc_savestate(int index, const u8 *pngData, u32 pngSize)
 {
 	if (!dc_savestateAllowed())
 		return;
+	if (index == -2 && config::IncrementalSavestates && !config::GGPOEnable && !config::Rewind)
+	{
+		try {
+			saveCheckpoint();
+			os_notify(i18n::T("State saved"), 2000);
+		} catch (const std::bad_alloc&) {
+			checkpoints.clear();
+			WARN_LOG(SAVESTATE, "Failed to save checkpoint - out of memory");
+			os_notify(i18n::T("Save state failed - memory full"), 5000);
+		}
+		return;
+	}
 
 	lastStateFile.clear();
 
 	Serializer ser;
 	dc_serialize(ser);
 
-	void *data = malloc(ser.size());
-	if (data == nullptr)
-	{
+	auto state = std::make_shared<SavestateWriter::Savestate>();
+	try {
+		state->data.resize(ser.size());
+		state->pngData.assign(pngData, pngData + pngSize);
+	} catch (const std::bad_alloc&) {
 		WARN_LOG(SAVESTATE, "Failed to save state - could not malloc %d bytes", (int)ser.size());
 		os_notify(i18n::T("Save state failed - memory full"), 5000);
-    	return;
+		return;
 	}
 
-	ser = Serializer(data, ser.size());
+	ser = Serializer(state->data.data(), state->data.size());
 	dc_serialize(ser);
 
-	hostfs::File *f = nullptr;
-	std::string filename = "";
+	state->header.init();
+	state->header.pngSize = pngSize;
+	state->codec = config::SavestateZstd ? RZipFile::Codec::Zstd : RZipFile::Codec::Zlib;
+
 #ifdef HAS_FMEMOPEN
 	if (index == -2)
 	{
 		// in-ram savestate
-		filename = "RAM";
-		f = new hostfs::StdFile(fmemopen(quicksave_buf, QUICKSAVE_DEFAULT_SIZE, "wb"));
-	}
-	else
-#endif
-	{
-		// regular file savestate
-		filename = hostfs::getSavestatePath(index, true);
-		f = hostfs::storage().openFile(filename.c_str(), "wb");
-	}
-	
-	if (f == nullptr)
-	{
-		WARN_LOG(SAVESTATE, "Failed to save state - could not open %s for writing", filename.c_str());
-		os_notify(i18n::T("Cannot open save file"), 5000);
-		free(data);
-    	return;
+		hostfs::File *f = new hostfs::StdFile(fmemopen(quicksave_buf, QUICKSAVE_DEFAULT_SIZE, "wb"));
+		if (!writeSavestate(f, state->header, state->pngData.data(), state->data.data(), state->data.size(), state->codec))
+		{
+			WARN_LOG(SAVESTATE, "Failed to save state - error writing RAM");
+			os_notify(i18n::T("Error saving state"), 5000);
+			return;
+		}
+		NOTICE_LOG(SAVESTATE, "Saved state to RAM size %d", (int)ser.size());
+		os_notify(i18n::T("State saved"), 2000);
+		return;
 	}
-
-	RZipFile zipFile;
-	SavestateHeader header;
-	header.init();
-	header.pngSize = pngSize;
-	if (f->write(&header, sizeof(header), 1) != 1)
-		goto fail;
-	if (pngSize > 0 && f->write(pngData, 1, pngSize) != pngSize)
-		goto fail;
-
-#if 0
-	// Uncompressed savestate
-	f->write(data, 1, ser.size());
-	delete f;
-#else
-	if (!zipFile.Open(f, true))
-		goto fail;
-	if (zipFile.Write(data, ser.size()) != ser.size())
-		goto fail;
-	zipFile.Close();
 #endif
+	// regular file savestate, compressed and written in the background
+	state->filename = hostfs::getSavestatePath(index, true);
+	state->contentPath = settings.content.path;
+	state->index = index;
+	savestateWriter.write(state);
+}
 
-	free(data);
-	NOTICE_LOG(SAVESTATE, "Saved state to %s size %d", filename.c_str(), (int)ser.size());
-	os_notify(i18n::T("State saved"), 2000);
-	return;
-
-fail:
-	WARN_LOG(SAVESTATE, "Failed to save state - error writing %s", filename.c_str());
-	os_notify(i18n::T("Error saving state"), 5000);
-	if (zipFile.rawFile() != nullptr)
-		zipFile.Close();
-	else
-		delete f;
-	free(data);
-	// delete failed savestate?
+void dc_waitSavestates()
+{
+	savestateWriter.wait();
 }
 
 void dc_loadstate(int index)
 {
 	if (!dc_savestateAllowed() || settings.raHardcoreMode)
 		return;
+	if (index == -2 && config::IncrementalSavestates && !config::GGPOEnable && !config::Rewind)
+	{
+		if (checkpoints.empty())
+		{
+			os_notify(i18n::T("Save state not found"), 2000);
+			return;
+		}
+		try {
+			loadCheckpoint(checkpoints.size() - 1);
+		} catch (const Deserializer::Exception& e) {
+			ERROR_LOG(SAVESTATE, "%s", e.what());
+			os_notify(i18n::T("Failed to load state"), 5000, e.what());
+		}
+		return;
+	}
+	savestateWriter.wait();
 	u32 total_size = 0;
 
 	hostfs::File *f = nullptr;
@@ -372,6 +527,8 @@ void dc_loadstate(int index)
 time_t dc_getStateCreationDate(int index)
 {
 	std::string filename = hostfs::getSavestatePath(index, false);
+	if (auto state = savestateWriter.find(index))
+		return (time_t)state->header.creationDate;
 	if (filename != lastStateFile)
 	{
 		lastStateFile = filename;
@@ -404,6 +561,11 @@ void dc_getStateScreenshot(int index, std::vector<u8>& pngData)
 {
 	pngData.clear();
 	std::string filename = hostfs::getSavestatePath(index, false);
+	if (auto state = savestateWriter.find(index))
+	{
+		pngData = state->pngData;
+		return;
+	}
 	hostfs::File *f = hostfs::storage().openFile(filename, "rb");
 	if (f == nullptr)
 		return;
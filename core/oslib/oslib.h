@@ -1,5 +1,6 @@
 #pragma once
 #include "types.h"
+#include "profiler/telemetry.h"
 #include <vector>
 #if defined(__SWITCH__)
 #include <malloc.h>
@@ -23,6 +24,7 @@ class ThreadName
 public:
 	ThreadName(const char *name) {
 		os_SetThreadName(name);
+		telemetry::setThreadName(name);
 	}
 	~ThreadName() {
 		// default name
@@ -50,6 +50,8 @@ void release_jit_block(void *code_area1, void *code_area2, size_t size);
 
 bool region_lock(void *start, std::size_t len);
 bool region_unlock(void *start, std::size_t len);
+// Make a region inaccessible so that any access faults
+bool region_noaccess(void *start, std::size_t len);
 bool region_set_exec(void *start, std::size_t len);
 
 } // namespace vmem
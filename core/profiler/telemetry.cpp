@@ -0,0 +1,271 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "telemetry.h"
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace telemetry
+{
+
+std::atomic<u32> mode;
+
+static const char * const ProbeNames[] = {
+	"sh4_sched_tick",
+	"rend_start_render",
+	"ta_parse",
+	"TextureUpdate",
+	"AICA_Sample",
+	"arm::run",
+	"DynarecCompile",
+};
+static_assert(std::size(ProbeNames) == (size_t)Probe::Count);
+
+struct Total
+{
+	std::atomic<u64> ticks;
+	std::atomic<u64> count;
+};
+static Total totals[(size_t)Probe::Count];
+// Totaling period, to convert ticks to milliseconds
+static u64 totalsStartTicks;
+static u64 totalsEndTicks;
+static std::chrono::steady_clock::time_point totalsStartTime;
+static std::chrono::steady_clock::time_point totalsEndTime;
+
+struct Record
+{
+	u64 start;
+	u32 duration;
+	Probe probe;
+};
+
+class ThreadBuffer
+{
+public:
+	// ~3 seconds of emulation thread events at full speed
+	static constexpr u32 Size = 1 << 18;
+
+	ThreadBuffer(u32 id) : id(id), records(new Record[Size]) {}
+
+	// Only called by the owning thread
+	void push(Probe probe, u64 start, u64 end)
+	{
+		const u64 h = head.load(std::memory_order_relaxed);
+		Record& record = records[h & (Size - 1)];
+		record.start = start;
+		record.duration = (u32)std::min<u64>(end - start, UINT32_MAX);
+		record.probe = probe;
+		head.store(h + 1, std::memory_order_release);
+	}
+
+	// Copy the records that can be read safely while the owning thread is recording
+	std::vector<Record> snapshot() const
+	{
+		const u64 end = head.load(std::memory_order_acquire);
+		u64 begin = end > Size ? end - Size : 0;
+		std::vector<Record> v;
+		v.reserve(end - begin);
+		for (u64 i = begin; i < end; i++)
+			v.push_back(records[i & (Size - 1)]);
+		// Drop the records that may have been overwritten during the copy.
+		// Keep a margin since the owning thread may be writing the next record.
+		const u64 overwritten = head.load(std::memory_order_acquire) + 1;
+		if (overwritten > begin + Size)
+		{
+			const u64 drop = std::min<u64>(overwritten - begin - Size, v.size());
+			v.erase(v.begin(), v.begin() + drop);
+		}
+		return v;
+	}
+
+	// Discard the records of the previous owner
+	void clear() {
+		head = 0;
+	}
+
+	const u32 id;
+	std::string name;
+	// Set when the owning thread exits so that the buffer can be reused
+	std::atomic<bool> free = false;
+
+private:
+	std::unique_ptr<Record[]> records;
+	std::atomic<u64> head = 0;
+};
+
+static std::mutex buffersMutex;
+static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+// Time reference to convert ticks to microseconds
+static u64 startTicks;
+static std::chrono::steady_clock::time_point startTime;
+
+struct ThreadState
+{
+	~ThreadState() {
+		if (buffer != nullptr)
+			buffer->free = true;
+	}
+
+	ThreadBuffer *buffer = nullptr;
+	char name[32] {};
+};
+static thread_local ThreadState threadState;
+
+static ThreadBuffer *allocBuffer()
+{
+	std::lock_guard<std::mutex> _(buffersMutex);
+	ThreadBuffer *buffer = nullptr;
+	for (auto& b : buffers)
+		if (b->free)
+		{
+			buffer = b.get();
+			buffer->free = false;
+			buffer->clear();
+			break;
+		}
+	if (buffer == nullptr)
+	{
+		buffers.push_back(std::make_unique<ThreadBuffer>((u32)buffers.size() + 1));
+		buffer = buffers.back().get();
+	}
+	buffer->name = threadState.name[0] != '\0' ? threadState.name : "Thread " + std::to_string(buffer->id);
+	return buffer;
+}
+
+void record(Probe probe, u64 start, u64 end)
+{
+	const u32 m = mode.load(std::memory_order_relaxed);
+	if (m & Trace)
+	{
+		ThreadBuffer *buffer = threadState.buffer;
+		if (buffer == nullptr)
+			buffer = threadState.buffer = allocBuffer();
+		buffer->push(probe, start, end);
+	}
+	if (m & Totals)
+	{
+		Total& total = totals[(size_t)probe];
+		total.ticks.fetch_add(end - start, std::memory_order_relaxed);
+		total.count.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void setEnabled(bool enable)
+{
+	if (enable && !(mode & Trace))
+	{
+		startTicks = now();
+		startTime = std::chrono::steady_clock::now();
+	}
+	if (enable)
+		mode |= Trace;
+	else
+		mode &= ~Trace;
+}
+
+void startTotals()
+{
+	for (Total& total : totals)
+	{
+		total.ticks = 0;
+		total.count = 0;
+	}
+	totalsStartTicks = now();
+	totalsStartTime = std::chrono::steady_clock::now();
+	mode |= Totals;
+}
+
+void stopTotals()
+{
+	mode &= ~Totals;
+	totalsEndTicks = now();
+	totalsEndTime = std::chrono::steady_clock::now();
+}
+
+double totalTime(Probe probe)
+{
+	if (totalsEndTicks <= totalsStartTicks)
+		return 0.0;
+	// Calibrate the tick frequency over the totaling period
+	const double elapsedMs = std::chrono::duration_cast<std::chrono::microseconds>(totalsEndTime - totalsStartTime).count() / 1000.0;
+	return totals[(size_t)probe].ticks * elapsedMs / (totalsEndTicks - totalsStartTicks);
+}
+
+u64 totalCount(Probe probe) {
+	return totals[(size_t)probe].count;
+}
+
+void setThreadName(const char *name)
+{
+	strncpy(threadState.name, name, sizeof(threadState.name) - 1);
+	if (threadState.buffer != nullptr)
+	{
+		std::lock_guard<std::mutex> _(buffersMutex);
+		threadState.buffer->name = threadState.name;
+	}
+}
+
+bool exportChromeTrace(const std::string& path)
+{
+	if (startTicks == 0)
+		return false;
+	// Calibrate the tick frequency over the whole recording period
+	const double elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+	const u64 elapsedTicks = now() - startTicks;
+	if (elapsedUs <= 0.0 || elapsedTicks == 0)
+		return false;
+	const double usPerTick = elapsedUs / elapsedTicks;
+
+	FILE *f = nowide::fopen(path.c_str(), "w");
+	if (f == nullptr)
+		return false;
+	fprintf(f, "{\"traceEvents\":[\n");
+	bool first = true;
+	std::lock_guard<std::mutex> _(buffersMutex);
+	for (const auto& buffer : buffers)
+	{
+		std::string name;
+		for (char c : buffer->name)
+			if (c != '"' && c != '\\')
+				name += c;
+		fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",\n", buffer->id, name.c_str());
+		first = false;
+		for (const Record& record : buffer->snapshot())
+		{
+			// Records made before the last call to setEnabled(true)
+			if (record.start < startTicks)
+				continue;
+			fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					ProbeNames[(int)record.probe], buffer->id,
+					(record.start - startTicks) * usPerTick, record.duration * usPerTick);
+		}
+	}
+	fprintf(f, "\n],\"displayTimeUnit\":\"ns\"}\n");
+	const bool success = !ferror(f);
+	fclose(f);
+
+	return success;
+}
+
+}	// namespace telemetry
@@ -0,0 +1,111 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "types.h"
+#include <atomic>
+#include <string>
+#if HOST_CPU == CPU_X86 || HOST_CPU == CPU_X64
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#include <chrono>
+#endif
+
+//
+// Low-overhead timing of a few hot functions, always compiled in and enabled at runtime.
+// Events can be traced (Telemetry.Enabled): each thread records into its own lock-free ring buffer holding
+// the last few seconds of events, which can be exported as a Chrome trace (chrome://tracing or https://ui.perfetto.dev).
+// The time spent in each probe and its number of calls can also be totaled, which the benchmark uses.
+//
+namespace telemetry
+{
+
+enum class Probe : u8
+{
+	Sh4Scheduler,
+	StartRender,
+	TaParse,
+	TextureUpdate,
+	AicaSample,
+	AicaRun,
+	DynarecCompile,
+	Count
+};
+
+// What the probes record
+enum Mode : u32
+{
+	Trace = 1,
+	Totals = 2,
+};
+extern std::atomic<u32> mode;
+
+static inline u64 now()
+{
+#if HOST_CPU == CPU_X86 || HOST_CPU == CPU_X64
+	return __rdtsc();
+#elif HOST_CPU == CPU_ARM64 && !defined(_MSC_VER)
+	u64 ticks;
+	asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+	return ticks;
+#else
+	return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+void record(Probe probe, u64 start, u64 end);
+
+// Record the lifetime of this object
+class Scope
+{
+public:
+	Scope(Probe probe) : probe(probe) {
+		if (mode.load(std::memory_order_relaxed) != 0)
+			start = now();
+	}
+	~Scope() {
+		if (start != 0)
+			record(probe, start, now());
+	}
+
+private:
+	Probe probe;
+	u64 start = 0;
+};
+
+#define TELEMETRY_SCOPE(probe) telemetry::Scope _telemetry_scope(telemetry::Probe::probe)
+
+// Enable tracing
+void setEnabled(bool enabled);
+// Enable and reset the totals
+void startTotals();
+void stopTotals();
+// Time spent in the probe between startTotals() and stopTotals(), in ms
+double totalTime(Probe probe);
+// Number of calls of the probe since startTotals()
+u64 totalCount(Probe probe);
+// Name of the calling thread in exported traces
+void setThreadName(const char *name);
+// Write the recorded events to the given file in Chrome trace format
+bool exportChromeTrace(const std::string& path);
+
+}	// namespace telemetry
@@ -18,15 +18,19 @@
  */
 #include "CustomTexture.h"
 #include "TexCache.h"
+#include "TexturePack.h"
 #include "oslib/directory.h"
 #include "oslib/storage.h"
 #include "cfg/option.h"
 #include "oslib/oslib.h"
 #include "stdclass.h"
 #include "util/worker_thread.h"
+#include "util/thread_pool.h"
 
 #include <sstream>
 #include <locale>
+#include <condition_variable>
+#include <deque>
 #define STB_IMAGE_IMPLEMENTATION
 #define STBI_ONLY_JPEG
 #define STBI_ONLY_PNG
@@ -53,25 +57,47 @@ public:
 	bool shouldPreload() const override { return shouldReplace() && config::PreloadCustomTextures; }
 	bool loadMap() override;
 	size_t getTextureCount() const override { return texture_map.size(); }
-	void preloadTextures(TextureCallback callback, std::atomic<bool>* stop_flag) override;
+	void preloadTextures(TextureCallback callback, std::atomic<bool>* stop_flag, const std::vector<u32>& priority) override;
+	bool dequeuePreload(u32 hash) override;
 	u8* loadCustomTexture(u32 hash, int& width, int& height) override;
 	bool isTextureReplaced(u32 hash) override final;
-	
-	
+	void terminate() override { packs.clear(); }
 
 private:
+	void preloadTexture(u32 hash, const std::string& path, TextureCallback& callback, std::atomic<bool>* stop_flag);
+
+	// Maximum size of the images being decoded at the same time
+	static constexpr size_t PreloadBudget = 256_MB;
+
 	bool custom_textures_available = false;
 	std::string textures_path;
 	std::map<u32, std::string> texture_map;
+	// Packed textures are memory-mapped and decoded on first use, and never preloaded.
+	// Loose image files take precedence over them.
+	std::vector<std::unique_ptr<TexturePack>> packs;
+
+	std::mutex preload_mutex;
+	std::condition_variable budget_cond;
+	std::deque<u32> preload_queue;
+	std::unordered_set<u32> preload_pending;	// queued and not started yet
+	size_t inflight_bytes = 0;
 };
 
 bool CustomTextureSource::loadMap()
 {
 	texture_map.clear();
+	packs.clear();
 	hostfs::DirectoryTree tree(textures_path);
 	for (const hostfs::FileInfo& item : tree)
 	{
 		std::string extension = get_file_extension(item.name);
+		if ("." + extension == texpack::FileExtension)
+		{
+			std::unique_ptr<TexturePack> pack = std::make_unique<TexturePack>();
+			if (pack->open(item.path))
+				packs.push_back(std::move(pack));
+			continue;
+		}
 		if (extension != "jpg" && extension != "jpeg" && extension != "png")
 			continue;
 		std::string::size_type dotpos = item.name.find_last_of('.');
@@ -85,36 +111,106 @@ bool CustomTextureSource::loadMap()
 		}
 		texture_map[hash] = item.path;
 	}
-	return !texture_map.empty();
+	return !texture_map.empty() || !packs.empty();
+}
+
+static ThreadPool& preloadThreadPool()
+{
+	static ThreadPool pool("CustomTexPreload");
+	return pool;
 }
 
-void CustomTextureSource::preloadTextures(TextureCallback callback, std::atomic<bool>* stop_flag)
+void CustomTextureSource::preloadTextures(TextureCallback callback, std::atomic<bool>* stop_flag, const std::vector<u32>& priority)
 {
-	for (auto const& [hash, path] : texture_map)
 	{
-		if (stop_flag != nullptr && *stop_flag)
-			return;
-		int w, h;
-		u8* data = loadCustomTexture(hash, w, h);
-		if (data != nullptr)
+		std::lock_guard<std::mutex> _(preload_mutex);
+		preload_queue.clear();
+		preload_pending.clear();
+		for (u32 hash : priority)
+			if (texture_map.count(hash) != 0 && preload_pending.insert(hash).second)
+				preload_queue.push_back(hash);
+		for (auto const& [hash, path] : texture_map)
+			if (preload_pending.insert(hash).second)
+				preload_queue.push_back(hash);
+	}
+	ThreadPool& pool = preloadThreadPool();
+	pool.parallelFor(pool.size() + 1, [&](size_t) {
+		while (stop_flag == nullptr || !*stop_flag)
 		{
-			size_t size = (size_t)w * h * 4;
-			TextureData tex;
-			tex.w = w;
-			tex.h = h;
-			tex.data.resize(size);
-			memcpy(tex.data.data(), data, size);
-			stbi_image_free(data);
-			callback(hash, std::move(tex));
+			u32 hash;
+			{
+				std::lock_guard<std::mutex> _(preload_mutex);
+				// skip the textures that have been loaded on demand
+				while (!preload_queue.empty() && preload_pending.count(preload_queue.front()) == 0)
+					preload_queue.pop_front();
+				if (preload_queue.empty())
+					return;
+				hash = preload_queue.front();
+				preload_queue.pop_front();
+				preload_pending.erase(hash);
+			}
+			preloadTexture(hash, texture_map.at(hash), callback, stop_flag);
 		}
+	});
+}
+
+void CustomTextureSource::preloadTexture(u32 hash, const std::string& path, TextureCallback& callback, std::atomic<bool>* stop_flag)
+{
+	TextureData tex;
+	hostfs::File *file = hostfs::storage().openFile(path, "rb");
+	int w, h, n;
+	if (file == nullptr || !stbi_info_from_callbacks(&STBI::callbacks, file, &w, &h, &n))
+	{
+		delete file;
+		callback(hash, std::move(tex));
+		return;
+	}
+	// Wait until there's enough room in the budget. Always let a single image through.
+	const size_t size = (size_t)w * h * 4;
+	{
+		std::unique_lock<std::mutex> lock(preload_mutex);
+		budget_cond.wait(lock, [&]() {
+			return inflight_bytes == 0 || inflight_bytes + size <= PreloadBudget || (stop_flag != nullptr && *stop_flag);
+		});
+		inflight_bytes += size;
 	}
+	file->seek(0, SEEK_SET);
+	stbi_set_flip_vertically_on_load_thread(1);
+	u8 *data = stbi_load_from_file(file, &w, &h, &n, STBI_rgb_alpha);
+	delete file;
+	if (data != nullptr)
+	{
+		tex.w = w;
+		tex.h = h;
+		tex.data.assign(data, data + (size_t)w * h * 4);
+		stbi_image_free(data);
+	}
+	callback(hash, std::move(tex));
+
+	std::lock_guard<std::mutex> _(preload_mutex);
+	inflight_bytes -= size;
+	budget_cond.notify_all();
+}
+
+bool CustomTextureSource::dequeuePreload(u32 hash)
+{
+	std::lock_guard<std::mutex> _(preload_mutex);
+	return preload_pending.erase(hash) != 0;
 }
 
 u8* CustomTextureSource::loadCustomTexture(u32 hash, int& width, int& height)
 {
 	auto it = texture_map.find(hash);
 	if (it == texture_map.end())
+	{
+		for (auto& pack : packs)
+		{
+			u8 *data = pack->load(hash, width, height);
+			if (data != nullptr)
+				return data;
+		}
 		return nullptr;
+	}
 
 	hostfs::File *file = hostfs::storage().openFile(it->second, "rb");
 	if (file == nullptr)
@@ -128,7 +224,12 @@ u8* CustomTextureSource::loadCustomTexture(u32 hash, int& width, int& height)
 
 bool CustomTextureSource::isTextureReplaced(u32 hash)
 {
-	return texture_map.count(hash);
+	if (texture_map.count(hash))
+		return true;
+	for (auto& pack : packs)
+		if (pack->find(hash) != nullptr)
+			return true;
+	return false;
 }
 
 void CustomTexture::loadTexture(BaseTextureCacheData *texture)
@@ -140,13 +241,22 @@ void CustomTexture::loadTexture(BaseTextureCacheData *texture)
 	if (!texture->dirty)
 	{
 		int width, height;
-		u8 *image_data = loadTexture(texture->texture_hash, width, height);
+		u32 hash = texture->texture_hash;
+		u8 *image_data = loadTexture(hash, width, height);
 		if (image_data == nullptr && texture->old_vqtexture_hash != 0)
-			image_data = loadTexture(texture->old_vqtexture_hash, width, height);
+		{
+			hash = texture->old_vqtexture_hash;
+			image_data = loadTexture(hash, width, height);
+		}
 		if (image_data == nullptr)
-			image_data = loadTexture(texture->old_texture_hash, width, height);
+		{
+			hash = texture->old_texture_hash;
+			image_data = loadTexture(hash, width, height);
+		}
 		if (image_data != nullptr)
 		{
+			if (used_textures.insert(hash).second)
+				usage_order.push_back(hash);
 			texture->custom_width = width;
 			texture->custom_height = height;
 			texture->custom_image_data = image_data;
@@ -174,11 +284,14 @@ bool CustomTexture::init()
 		stop_preload = false;
 		resetPreloadProgress();
 		pending_preloads = 0;
+		preparing_sources = 0;
 		initialized = true;
 
 		std::string game_id = getGameId();
 		if (game_id.length() > 0)
 		{
+			usage_order_path = get_writable_data_path(game_id + ".texorder");
+			loadUsageOrder();
 			// The first source added has highest priority.
 			// Add your source after the default `CustomTextureSource`(data/textures/<game id> folder), so end-users can override your textures.
 			addSource(std::make_unique<CustomTextureSource>(game_id));
@@ -192,6 +305,10 @@ bool CustomTexture::enabled() {
 	return loaderThread != nullptr;
 }
 
+bool CustomTexture::isPreparing() {
+	return preparing_sources > 0;
+}
+
 bool CustomTexture::preloaded() {
 	return preload_total > 0;
 }
@@ -218,11 +335,13 @@ void CustomTexture::addSource(std::unique_ptr<BaseCustomTextureSource> source)
 		if (!loaderThread && ptr->shouldReplace())
 		{
 			loaderThread = std::make_unique<WorkerThread>("CustomTexLoader");
+			preloadThread = std::make_unique<WorkerThread>("CustomTexPreload");
 		}
 		if (loaderThread)
 		{
 			if (ptr->shouldPreload())
 				pending_preloads++;
+			preparing_sources++;
 			loaderThread->run([this, ptr]() {
 				prepareSource(ptr);
 			});
@@ -237,6 +356,9 @@ CustomTexture::~CustomTexture() {
 void CustomTexture::terminate()
 {
 	stop_preload = true;
+	if (preloadThread)
+		preloadThread->stop();
+	preloadThread.reset();
 	if (loaderThread)
 		loaderThread->stop();
 	loaderThread.reset();
@@ -245,22 +367,30 @@ void CustomTexture::terminate()
 	sources.clear();
 	preloaded_textures.clear();
 	resetPreloadProgress();
+	saveUsageOrder();
+	usage_order.clear();
+	used_textures.clear();
+	previous_usage_order.clear();
+	usage_order_path.clear();
 	initialized = false;
 }
 
 u8* CustomTexture::loadTexture(u32 hash, int& width, int& height)
 {
-	auto it = preloaded_textures.find(hash);
-	if (it != preloaded_textures.end())
 	{
-		width = it->second.w;
-		height = it->second.h;
-		size_t size = (size_t)width * height * 4;
-		u8* buffer = (u8*)malloc(size);
-		if (buffer == nullptr)
-			return nullptr;
-		memcpy(buffer, it->second.data.data(), size);
-		return buffer;
+		std::lock_guard<std::mutex> _(preload_mutex);
+		auto it = preloaded_textures.find(hash);
+		if (it != preloaded_textures.end())
+		{
+			width = it->second.w;
+			height = it->second.h;
+			size_t size = (size_t)width * height * 4;
+			u8* buffer = (u8*)malloc(size);
+			if (buffer == nullptr)
+				return nullptr;
+			memcpy(buffer, it->second.data.data(), size);
+			return buffer;
+		}
 	}
 
 	for (auto it = sources.begin(); it != sources.end(); ++it)
@@ -268,7 +398,20 @@ u8* CustomTexture::loadTexture(u32 hash, int& width, int& height)
 		auto& source = *it;
 		if (source->shouldReplace())
 		{
+			// Load it now if it's still waiting to be preloaded
+			bool dequeued = source->dequeuePreload(hash);
 			u8* data = source->loadCustomTexture(hash, width, height);
+			if (dequeued)
+			{
+				TextureData tex;
+				if (data != nullptr)
+				{
+					tex.w = width;
+					tex.h = height;
+					tex.data.assign(data, data + (size_t)width * height * 4);
+				}
+				addPreloadedTexture(hash, std::move(tex));
+			}
 			if (data != nullptr)
 				return data;
 		}
@@ -466,19 +609,72 @@ void CustomTexture::prepareSource(BaseCustomTextureSource* source)
 			if (count > 0)
 			{
 				preload_total += count;
-				auto callback = [this](u32 hash, TextureData&& data) {
-					size_t size = data.data.size();
-					preloaded_textures[hash] = std::move(data);
-					preload_loaded++;
-					preload_loaded_size += size;
-				};
-				source->preloadTextures(callback, &stop_preload);
+				// Preload in the background so that textures can be loaded on demand in the meantime
+				preloadThread->run([this, source]() {
+					auto callback = [this](u32 hash, TextureData&& data) {
+						addPreloadedTexture(hash, std::move(data));
+					};
+					source->preloadTextures(callback, &stop_preload, previous_usage_order);
+					pending_preloads--;
+				});
+				preparing_sources--;
+				return;
 			}
 		}
 	}
 
 	if (should_preload)
 		pending_preloads--;
+	preparing_sources--;
+}
+
+void CustomTexture::addPreloadedTexture(u32 hash, TextureData&& data)
+{
+	size_t size = data.data.size();
+	if (size != 0)
+	{
+		std::lock_guard<std::mutex> _(preload_mutex);
+		preloaded_textures[hash] = std::move(data);
+	}
+	preload_loaded++;
+	preload_loaded_size += size;
+}
+
+void CustomTexture::loadUsageOrder()
+{
+	if (usage_order_path.empty())
+		return;
+	FILE *f = nowide::fopen(usage_order_path.c_str(), "rb");
+	if (f == nullptr)
+		return;
+	std::fseek(f, 0, SEEK_END);
+	long size = std::ftell(f);
+	std::fseek(f, 0, SEEK_SET);
+	if (size > 0)
+	{
+		previous_usage_order.resize(size / sizeof(u32));
+		previous_usage_order.resize(std::fread(previous_usage_order.data(), sizeof(u32), previous_usage_order.size(), f));
+	}
+	std::fclose(f);
+	DEBUG_LOG(RENDERER, "Loaded custom texture usage order: %d textures", (int)previous_usage_order.size());
+}
+
+void CustomTexture::saveUsageOrder()
+{
+	if (usage_order_path.empty() || usage_order.empty())
+		return;
+	// Textures used this session first, followed by the ones only used previously
+	for (u32 hash : previous_usage_order)
+		if (used_textures.insert(hash).second)
+			usage_order.push_back(hash);
+	FILE *f = nowide::fopen(usage_order_path.c_str(), "wb");
+	if (f == nullptr)
+	{
+		WARN_LOG(RENDERER, "Can't save custom texture usage order to %s: error %d", usage_order_path.c_str(), errno);
+		return;
+	}
+	std::fwrite(usage_order.data(), sizeof(u32), usage_order.size(), f);
+	std::fclose(f);
 }
 
 void CustomTexture::getPreloadProgress(int& completed, int& total, size_t& loaded_size) const
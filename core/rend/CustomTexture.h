@@ -24,6 +24,8 @@
 #include <vector>
 #include <atomic>
 #include <functional>
+#include <mutex>
+#include <unordered_set>
 
 class BaseTextureCacheData;
 class WorkerThread;
@@ -47,7 +49,12 @@ public:
 	virtual void terminate() { }
 	virtual u8* loadCustomTexture(u32 hash, int& width, int& height) = 0;
 	virtual bool isTextureReplaced(u32 hash) = 0;
-	virtual void preloadTextures(TextureCallback callback, std::atomic<bool>* stop_flag) { }
+	// Textures in priority are preloaded first. The callback may be called from several threads
+	// and is called with an empty TextureData if the texture can't be loaded.
+	virtual void preloadTextures(TextureCallback callback, std::atomic<bool>* stop_flag, const std::vector<u32>& priority) { }
+	// Remove a texture that hasn't been preloaded yet from the preload queue.
+	// Returns true if the texture was waiting to be preloaded.
+	virtual bool dequeuePreload(u32 hash) { return false; }
 };
 
 class CustomTexture
@@ -58,6 +65,8 @@ public:
 	bool enabled();
 	bool preloaded();
 	bool isPreloading();
+	// The game can start once all sources are ready, while textures are still being preloaded
+	bool isPreparing();
 	void addSource(std::unique_ptr<BaseCustomTextureSource> source);
 	void loadCustomTextureAsync(BaseTextureCacheData *texture_data);
 	void dumpTexture(BaseTextureCacheData* texture, int w, int h, void *src_buffer);
@@ -71,15 +80,27 @@ private:
 	std::string getGameId();
 	void prepareSource(BaseCustomTextureSource* source);
 	void resetPreloadProgress();
+	void addPreloadedTexture(u32 hash, TextureData&& data);
+	void loadUsageOrder();
+	void saveUsageOrder();
 	
 	bool initialized = false;
 	std::vector<std::unique_ptr<BaseCustomTextureSource>> sources;
 	std::unique_ptr<WorkerThread> loaderThread;
+	std::unique_ptr<WorkerThread> preloadThread;
 	std::map<u32, TextureData> preloaded_textures;
+	std::mutex preload_mutex;
+	// Order in which textures were first used, saved per game to preload them first in the next sessions
+	std::string usage_order_path;
+	std::vector<u32> previous_usage_order;
+	std::vector<u32> usage_order;
+	std::unordered_set<u32> used_textures;
 	std::atomic<int> preload_total { 0 };
 	std::atomic<int> preload_loaded { 0 };
 	std::atomic<size_t> preload_loaded_size { 0 };
 	std::atomic<int> pending_preloads { 0 };
+	// Sources whose texture map isn't loaded yet
+	std::atomic<int> preparing_sources { 0 };
 	std::atomic<bool> stop_preload { false };
 };
 
@@ -18,13 +18,20 @@
 #include "xbrz/xbrz.h"
 #include "hw/pvr/pvr_mem.h"
 #include "hw/mem/addrspace.h"
+#include "util/thread_pool.h"
+#include "profiler/telemetry.h"
 
+#include <chrono>
+#include <future>
 #include <mutex>
 #include <xxhash.h>
 
 #ifdef _OPENMP
 #include <omp.h>
 #endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 extern bool pal_needs_update;
 
@@ -33,11 +40,54 @@ const std::array<f32, 16> D_Adjust_LoD_Bias = {
 		0.f, -4.f, -2.f, -1.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f
 };
 
-static std::vector<vram_block*> *VramLocks;
+constexpr u32 VramPages = VRAM_SIZE_MAX / PAGE_SIZE;
+// Intrusive list of the blocks locking each vram page
+static vram_block **VramLocks;
+// Protects the lock lists
+static std::mutex vramlist_lock;
+
+// Pages written to since the last VramProcessWrites() call.
+// The write fault handler doesn't touch the lock lists. It only sets the dirty bit and unprotects the page
+// while holding the lock of the page shard. The same lock is held when protecting a page and clearing its dirty bit,
+// so that a page can't be unprotected without being marked dirty.
+constexpr u32 PageShards = 64;
+static std::array<std::mutex, PageShards> pageShardLocks;
+static std::atomic<u64> dirtyPages[VramPages / 64];
+static std::atomic<bool> dirtyPagesPending;
+
+static int ctz(u64 v)
+{
+#ifdef _MSC_VER
+	unsigned long idx;
+#ifdef _WIN64
+	_BitScanForward64(&idx, v);
+#else
+	if (!_BitScanForward(&idx, (u32)v))
+	{
+		_BitScanForward(&idx, (u32)(v >> 32));
+		idx += 32;
+	}
+#endif
+	return (int)idx;
+#else
+	return __builtin_ctzll(v);
+#endif
+}
+
+static std::mutex& pageShardLock(u32 page) {
+	return pageShardLocks[page % PageShards];
+}
+
+// Statistics
+static std::atomic<u32> vramFaults;
+static std::atomic<u64> vramFaultTime;
+static u32 vramInvalidations;
+static u64 vramStatsTime;
+static VramLockStats vramLockStats;
 
 static inline void initVramLocks() {
 	if (VramLocks == nullptr)
-		VramLocks = new std::vector<vram_block*>[VRAM_SIZE_MAX / PAGE_SIZE];
+		VramLocks = new vram_block *[VramPages]();
 }
 
 //List functions
@@ -49,74 +99,119 @@ static void vramlock_list_remove(vram_block* block)
 
 	for (u32 i = base; i <= end; i++)
 	{
-		std::vector<vram_block*>& list = VramLocks[i];
-		for (auto& lock : list)
-		{
-			if (lock == block)
-				lock = nullptr;
-		}
+		vram_block::PageLink& link = block->link(i);
+		if (link.prev != nullptr)
+			link.prev->link(i).next = link.next;
+		else
+			VramLocks[i] = link.next;
+		if (link.next != nullptr)
+			link.next->link(i).prev = link.prev;
 	}
 }
- 
+
 static void vramlock_list_add(vram_block* block)
 {
 	u32 base = block->start / PAGE_SIZE;
 	u32 end = block->end / PAGE_SIZE;
+	block->links = std::make_unique<vram_block::PageLink[]>(end - base + 1);
 
 	for (u32 i = base; i <= end; i++)
 	{
-		std::vector<vram_block*>& list = VramLocks[i];
 		// If the list is empty then we need to protect vram, otherwise it's already been done
-		if (list.empty() || std::all_of(list.begin(), list.end(), [](vram_block *block) { return block == nullptr; }))
+		if (VramLocks[i] == nullptr)
+		{
+			std::lock_guard<std::mutex> _(pageShardLock(i));
 			addrspace::protectVram(i * PAGE_SIZE, PAGE_SIZE);
-		auto it = std::find(list.begin(), list.end(), nullptr);
-		if (it != list.end())
-			*it = block;
-		else
-			list.push_back(block);
+		}
+		vram_block::PageLink& link = block->link(i);
+		link.prev = nullptr;
+		link.next = VramLocks[i];
+		if (link.next != nullptr)
+			link.next->link(i).prev = block;
+		VramLocks[i] = block;
 	}
 }
- 
-static std::mutex vramlist_lock;
 
 bool VramLockedWriteOffset(size_t offset)
 {
 	if (offset >= VRAM_SIZE || VramLocks == nullptr)
 		return false;
 
-	size_t addr_hash = offset / PAGE_SIZE;
-	std::vector<vram_block *>& list = VramLocks[addr_hash];
-
+	const auto start = std::chrono::steady_clock::now();
+	const u32 page = offset / PAGE_SIZE;
 	{
-		std::lock_guard<std::mutex> lockguard(vramlist_lock);
+		std::lock_guard<std::mutex> _(pageShardLock(page));
+		dirtyPages[page / 64].fetch_or(1ull << (page % 64));
+		addrspace::unprotectVram(page * PAGE_SIZE, PAGE_SIZE);
+	}
+	dirtyPagesPending = true;
+
+	vramFaults++;
+	vramFaultTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
 
-		for (auto& lock : list)
+	return true;
+}
+
+bool VramLockedWrite(u8* address)
+{
+	u32 offset = addrspace::getVramOffset(address);
+	if (offset == (u32)-1)
+		return false;
+	return VramLockedWriteOffset(offset);
+}
+
+static void updateVramLockStats()
+{
+	const u64 now = getTimeMs();
+	if (now - vramStatsTime < 1000)
+		return;
+	const u32 faults = vramFaults.exchange(0);
+	const u64 faultTime = vramFaultTime.exchange(0);
+	const float seconds = (now - vramStatsTime) / 1000.f;
+	vramLockStats.faultsPerSecond = faults / seconds;
+	vramLockStats.invalidationsPerSecond = vramInvalidations / seconds;
+	vramLockStats.handlerLatency = faults == 0 ? 0.f : faultTime / 1000.f / faults;
+	vramInvalidations = 0;
+	vramStatsTime = now;
+}
+
+VramLockStats getVramLockStats() {
+	return vramLockStats;
+}
+
+void VramProcessWrites()
+{
+	updateVramLockStats();
+	if (!dirtyPagesPending || VramLocks == nullptr)
+		return;
+	dirtyPagesPending = false;
+
+	std::lock_guard<std::mutex> lockguard(vramlist_lock);
+	for (u32 word = 0; word < std::size(dirtyPages); word++)
+	{
+		u64 bits = dirtyPages[word].load(std::memory_order_relaxed);
+		while (bits != 0)
 		{
-			if (lock != nullptr)
+			const u32 page = word * 64 + ctz(bits);
+			bits &= bits - 1;
 			{
+				std::lock_guard<std::mutex> _(pageShardLock(page));
+				dirtyPages[word].fetch_and(~(1ull << (page % 64)));
+			}
+			while (VramLocks[page] != nullptr)
+			{
+				vram_block *lock = VramLocks[page];
 				lock->texture->invalidate();
+				vramInvalidations++;
 
-				if (lock != nullptr)
+				if (VramLocks[page] == lock)
 				{
 					ERROR_LOG(PVR, "Error : pvr is supposed to remove lock");
 					die("Invalid state");
 				}
 			}
 		}
-		list.clear();
-
-		addrspace::unprotectVram((u32)(offset & ~PAGE_MASK), PAGE_SIZE);
 	}
-
-	return true;
-}
-
-bool VramLockedWrite(u8* address)
-{
-	u32 offset = addrspace::getVramOffset(address);
-	if (offset == (u32)-1)
-		return false;
-	return VramLockedWriteOffset(offset);
 }
 
 //unlocks mem
@@ -285,16 +380,67 @@ void BaseTextureCacheData::unprotectVRam()
 bool BaseTextureCacheData::Delete()
 {
 	unprotectVRam();
+	CancelDecoding();
 
 	if (custom_load_in_progress > 0)
 		return false;
 
 	free(custom_image_data);
 	custom_image_data = nullptr;
+	setMemorySize(0, 0, false);
 
 	return true;
 }
 
+static u64 textureMemory;
+
+void BaseTextureCacheData::setMemorySize(u32 width, u32 height, bool mipmapped)
+{
+	u32 bytes = width * height;
+	if (tex_type == TextureType::_8888)
+		bytes *= 4;
+	else if (tex_type != TextureType::_8)
+		bytes *= 2;
+	if (mipmapped)
+		bytes = bytes * 4 / 3;
+	textureMemory += bytes;
+	textureMemory -= memorySize;
+	memorySize = bytes;
+}
+
+u64 getTextureMemory() {
+	return textureMemory;
+}
+
+static TextureCacheStats cacheStats;
+static u32 cacheHits;
+static u32 cacheLookups;
+static u32 cacheEvictions;
+static u64 cacheStatsTime;
+
+void updateTextureCacheStats(u32 entries, u32 hits, u32 misses, u32 evictions)
+{
+	cacheHits += hits;
+	cacheLookups += hits + misses;
+	cacheEvictions += evictions;
+	cacheStats.bytes = textureMemory;
+	cacheStats.entries = entries;
+	const u64 now = getTimeMs();
+	if (now - cacheStatsTime < 1000)
+		return;
+	const float seconds = (now - cacheStatsTime) / 1000.f;
+	cacheStats.hitRate = cacheLookups == 0 ? 100.f : cacheHits * 100.f / cacheLookups;
+	cacheStats.evictionsPerSecond = cacheEvictions / seconds;
+	cacheHits = 0;
+	cacheLookups = 0;
+	cacheEvictions = 0;
+	cacheStatsTime = now;
+}
+
+TextureCacheStats getTextureCacheStats() {
+	return cacheStats;
+}
+
 BaseTextureCacheData::BaseTextureCacheData(TSP tsp, TCW tcw, int area)
 {
 	initVramLocks();
@@ -314,6 +460,8 @@ BaseTextureCacheData::BaseTextureCacheData(TSP tsp, TCW tcw, int area)
 	custom_load_in_progress = 0;
 	gpuPalette = false;
 	is_custom_replaced = false;
+	lastUsed = FrameCount;
+	memorySize = 0;
 
 	//decode info from tsp/tcw into the texture struct
 	tex = &pvrTexInfo[tcw.PixelFmt == PixelReserved ? Pixel1555 : tcw.PixelFmt];	//texture format table entry
@@ -435,8 +583,196 @@ void BaseTextureCacheData::ComputeHash()
 	}
 }
 
+// Texture conversion that can be done by a worker thread.
+// All the parameters are copied from the texture when the job is created so that
+// the texture can be updated or deleted while the job is running.
+struct TextureDecodeJob
+{
+	TSP tsp;
+	TCW tcw;
+	const PvrTexInfo *tex;
+	TexConvFP texconv;
+	TexConvFP32 texconv32;
+	TexConvFP8 texconv8;
+	u32 startAddress;
+	u32 mmStartAddress;
+	u32 width;
+	u32 height;
+	u32 stride;
+	u32 heightLimit;
+	u32 paletteIndex;
+	TextureType texType;
+	bool use32bit;
+	bool mipmapped;			// mipmaps are generated
+	bool gpuMipmaps;		// the texture is mipmapped on the gpu
+	int upscale;
+	bool hasAlpha;
+	bool canDefer;			// the previous version of the texture can be used until decoding is done
+	bool deferred = false;
+
+	// Result
+	PixelBuffer<u16> pb16;
+	PixelBuffer<u32> pb32;
+	PixelBuffer<u8> pb8;
+	const u8 *data = nullptr;
+	u32 outWidth = 0;
+	u32 outHeight = 0;
+	std::future<void> done;
+
+	void decode();
+};
+
+static ThreadPool& decodeThreadPool()
+{
+	static ThreadPool pool("TexDecode");
+	return pool;
+}
+
+// Textures with a decoding job queued. Only accessed by the render thread.
+static std::vector<BaseTextureCacheData *> decodingTextures;
+
+static std::atomic<u32> decodedTextures;
+static std::atomic<u64> decodeTime;
+static u64 decodeWaitTime;
+static u32 decodeStatsFrame;
+static TextureDecodeStats decodeStats;
+
+void TextureDecodeJob::decode()
+{
+	const auto start = std::chrono::steady_clock::now();
+	::palette_index = paletteIndex;
+	if (tcw.VQ_Comp)
+		::vq_codebook = &vram[startAddress];
+
+	outWidth = width;
+	outHeight = height;
+	if (use32bit)
+	{
+		if (mipmapped)
+		{
+			pb32.init(width, height, true);
+			for (u32 i = 0; i <= tsp.TexU + 3u; i++)
+			{
+				pb32.set_mipmap(i);
+				u32 vram_addr;
+				if (tcw.VQ_Comp)
+				{
+					vram_addr = startAddress + VQMipPoint[i];
+					if (i == 0)
+					{
+						PixelBuffer<u32> pb0;
+						pb0.init(2, 2 ,false);
+						if (tcw.PixelFmt == PixelYUV)
+							// Use higher LoD mipmap
+							vram_addr = startAddress + VQMipPoint[1];
+						texconv32(&pb0, &vram[vram_addr], 2, 2);
+						*pb32.data() = *pb0.data(1, 1);
+						continue;
+					}
+				}
+				else
+					vram_addr = startAddress + OtherMipPoint[i] * tex->bpp / 8;
+				if (tcw.PixelFmt == PixelYUV && i == 0)
+					// Special case for YUV at 1x1 LoD
+					pvrTexInfo[Pixel565].TW32(&pb32, &vram[vram_addr], 1, 1);
+				else
+					texconv32(&pb32, &vram[vram_addr], 1 << i, 1 << i);
+			}
+			pb32.set_mipmap(0);
+		}
+		else
+		{
+			pb32.init(width, height);
+			texconv32(&pb32, (u8*)&vram[mmStartAddress], stride, heightLimit);
+
+			// xBRZ scaling
+			if (upscale > 1)
+			{
+				PixelBuffer<u32> tmp_buf;
+				tmp_buf.init(width * upscale, height * upscale);
+
+				UpscalexBRZ(upscale, pb32.data(), tmp_buf.data(), width, height, hasAlpha);
+				pb32.steal_data(tmp_buf);
+				outWidth *= upscale;
+				outHeight *= upscale;
+			}
+		}
+		data = (const u8 *)pb32.data();
+	}
+	else if (texconv8 != NULL && texType == TextureType::_8)
+	{
+		if (mipmapped)
+		{
+			// This shouldn't happen since mipmapped palette textures are converted to rgba
+			pb8.init(width, height, true);
+			for (u32 i = 0; i <= tsp.TexU + 3u; i++)
+			{
+				pb8.set_mipmap(i);
+				u32 vram_addr = startAddress + OtherMipPoint[i] * tex->bpp / 8;
+				texconv8(&pb8, &vram[vram_addr], 1 << i, 1 << i);
+			}
+			pb8.set_mipmap(0);
+		}
+		else
+		{
+			pb8.init(width, height);
+			texconv8(&pb8, &vram[mmStartAddress], stride, height);
+		}
+		data = pb8.data();
+	}
+	else if (texconv != NULL)
+	{
+		if (mipmapped)
+		{
+			pb16.init(width, height, true);
+			for (u32 i = 0; i <= tsp.TexU + 3u; i++)
+			{
+				pb16.set_mipmap(i);
+				u32 vram_addr;
+				if (tcw.VQ_Comp)
+				{
+					vram_addr = startAddress + VQMipPoint[i];
+					if (i == 0)
+					{
+						PixelBuffer<u16> pb0;
+						pb0.init(2, 2 ,false);
+						texconv(&pb0, (u8*)&vram[vram_addr], 2, 2);
+						*pb16.data() = *pb0.data(1, 1);
+						continue;
+					}
+				}
+				else
+					vram_addr = startAddress + OtherMipPoint[i] * tex->bpp / 8;
+				texconv(&pb16, (u8*)&vram[vram_addr], 1 << i, 1 << i);
+			}
+			pb16.set_mipmap(0);
+		}
+		else
+		{
+			pb16.init(width, height);
+			texconv(&pb16, (u8*)&vram[mmStartAddress], stride, heightLimit);
+		}
+		data = (const u8 *)pb16.data();
+	}
+	else
+	{
+		//fill it in with a temp color
+		WARN_LOG(RENDERER, "UNHANDLED TEXTURE");
+		pb16.init(width, height);
+		memset(pb16.data(), 0x80, width * height * 2);
+		data = (const u8 *)pb16.data();
+	}
+	decodedTextures++;
+	decodeTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
 bool BaseTextureCacheData::Update()
 {
+	TELEMETRY_SCOPE(TextureUpdate);
+	// A previous version of the texture can only be used if the format hasn't changed
+	const bool hadTexture = Updates > 0;
+	const TextureType prevTexType = tex_type;
+	const bool prevGpuPalette = gpuPalette;
 	//texture state tracking stuff
 	Updates++;
 	dirty = 0;
@@ -444,6 +780,7 @@ bool BaseTextureCacheData::Update()
 	tex_type = tex->type;
 
 	bool has_alpha = false;
+	u32 paletteIndex = 0;
 	if (IsPaletted())
 	{
 		if (IsGpuHandledPaletted(tsp, tcw, area))
@@ -459,22 +796,18 @@ bool BaseTextureCacheData::Update()
 		}
 
 		// Get the palette hash to check for future updates
-		// TODO get rid of ::palette_index and ::vq_codebook
 		if (tcw.PixelFmt == PixelPal4)
 		{
 			palette_hash = pal_hash_16[tcw.PalSelect];
-			::palette_index = tcw.PalSelect << 4;
+			paletteIndex = tcw.PalSelect << 4;
 		}
 		else
 		{
 			palette_hash = pal_hash_256[tcw.PalSelect >> 4];
-			::palette_index = (tcw.PalSelect >> 4) << 8;
+			paletteIndex = (tcw.PalSelect >> 4) << 8;
 		}
 	}
 
-	if (tcw.VQ_Comp)
-		::vq_codebook = &vram[startAddress];
-
 	//texture conversion work
 	u32 stride = width;
 
@@ -503,6 +836,7 @@ bool BaseTextureCacheData::Update()
 			WARN_LOG(RENDERER, "Warning: invalid texture. Address %08X %08X size %d", startAddress, mmStartAddress, size);
 			dirty = 1;
 			unprotectVRam();
+			CancelDecoding();
 			return false;
 		}
 	}
@@ -526,13 +860,21 @@ bool BaseTextureCacheData::Update()
 	}
 	is_custom_replaced = false;
 
-	void *temp_tex_buffer = NULL;
-	u32 upscaled_w = width;
-	u32 upscaled_h = height;
-
-	PixelBuffer<u16> pb16;
-	PixelBuffer<u32> pb32;
-	PixelBuffer<u8> pb8;
+	auto job = std::make_shared<TextureDecodeJob>();
+	job->tsp = tsp;
+	job->tcw = tcw;
+	job->tex = tex;
+	job->texconv = texconv;
+	job->texconv32 = texconv32;
+	job->texconv8 = texconv8;
+	job->startAddress = startAddress;
+	job->mmStartAddress = mmStartAddress;
+	job->width = width;
+	job->height = height;
+	job->stride = stride;
+	job->heightLimit = heightLimit;
+	job->paletteIndex = paletteIndex;
+	job->gpuMipmaps = IsMipmapped();
 
 	// Figure out if we really need to use a 32-bit pixel buffer
 	bool textureUpscaling = config::TextureUpscale > 1
@@ -550,147 +892,119 @@ bool BaseTextureCacheData::Update()
 
 	bool mipmapped = IsMipmapped() && !config::DumpTextures;
 
-	if (texconv32 != NULL && need_32bit_buffer)
+	job->use32bit = texconv32 != NULL && need_32bit_buffer;
+	if (job->use32bit)
 	{
 		if (textureUpscaling)
 			// don't use mipmaps if upscaling
 			mipmapped = false;
 		// Force the texture type since that's the only 32-bit one we know
 		tex_type = TextureType::_8888;
+		if (tcw.PixelFmt == Pixel1555 || tcw.PixelFmt == Pixel4444)
+			// Alpha channel formats. Palettes with alpha are already handled
+			has_alpha = true;
+	}
+	else if ((texconv8 == NULL || tex_type != TextureType::_8) && texconv == NULL)
+		mipmapped = false;
+	job->texType = tex_type;
+	job->mipmapped = mipmapped;
+	job->upscale = textureUpscaling && job->use32bit && !mipmapped ? (int)config::TextureUpscale : 1;
+	job->hasAlpha = has_alpha;
+	job->canDefer = config::TextureDecodeMode == 2 && hadTexture
+			&& tex_type == prevTexType && gpuPalette == prevGpuPalette;
+	// Don't defer the upload again if the previous job was already deferred
+	job->deferred = decodeJob != nullptr && decodeJob->deferred;
 
-		if (mipmapped)
+	//lock the texture to detect changes in it
+	protectVRam();
+	// Restore the original texture size if it was constrained to VRAM limits above
+	size = originalSize;
+
+	if (config::TextureDecodeMode == 0 || config::DumpTextures)
+	{
+		CancelDecoding();
+		job->decode();
+		UploadToGPU(job->outWidth, job->outHeight, job->data, job->gpuMipmaps, job->mipmapped);
+		setMemorySize(job->outWidth, job->outHeight, job->gpuMipmaps);
+		if (config::DumpTextures)
 		{
-			pb32.init(width, height, true);
-			for (u32 i = 0; i <= tsp.TexU + 3u; i++)
-			{
-				pb32.set_mipmap(i);
-				u32 vram_addr;
-				if (tcw.VQ_Comp)
-				{
-					vram_addr = startAddress + VQMipPoint[i];
-					if (i == 0)
-					{
-						PixelBuffer<u32> pb0;
-						pb0.init(2, 2 ,false);
-						if (tcw.PixelFmt == PixelYUV)
-							// Use higher LoD mipmap
-							vram_addr = startAddress + VQMipPoint[1];
-						texconv32(&pb0, &vram[vram_addr], 2, 2);
-						*pb32.data() = *pb0.data(1, 1);
-						continue;
-					}
-				}
-				else
-					vram_addr = startAddress + OtherMipPoint[i] * tex->bpp / 8;
-				if (tcw.PixelFmt == PixelYUV && i == 0)
-					// Special case for YUV at 1x1 LoD
-					pvrTexInfo[Pixel565].TW32(&pb32, &vram[vram_addr], 1, 1);
-				else
-					texconv32(&pb32, &vram[vram_addr], 1 << i, 1 << i);
-			}
-			pb32.set_mipmap(0);
+			ComputeHash();
+			custom_texture.dumpTexture(this, job->outWidth, job->outHeight, (void *)job->data);
+			NOTICE_LOG(RENDERER, "Dumped texture %x.png. Old hash %x", texture_hash, old_texture_hash);
 		}
-		else
-		{
-			pb32.init(width, height);
-			texconv32(&pb32, (u8*)&vram[mmStartAddress], stride, heightLimit);
+		PrintTextureName();
+	}
+	else
+	{
+		if (decodeJob == nullptr)
+			decodingTextures.push_back(this);
+		// The job keeps a reference to itself until done in case the texture is updated or deleted meanwhile
+		job->done = decodeThreadPool().runFuture([job]() { job->decode(); });
+		decodeJob = job;
+	}
 
-			// xBRZ scaling
-			if (textureUpscaling)
-			{
-				PixelBuffer<u32> tmp_buf;
-				tmp_buf.init(width * config::TextureUpscale, height * config::TextureUpscale);
+	return true;
+}
 
-				if (tcw.PixelFmt == Pixel1555 || tcw.PixelFmt == Pixel4444)
-					// Alpha channel formats. Palettes with alpha are already handled
-					has_alpha = true;
-				UpscalexBRZ(config::TextureUpscale, pb32.data(), tmp_buf.data(), width, height, has_alpha);
-				pb32.steal_data(tmp_buf);
-				upscaled_w *= config::TextureUpscale;
-				upscaled_h *= config::TextureUpscale;
-			}
-		}
-		temp_tex_buffer = pb32.data();
-	}
-	else if (texconv8 != NULL && tex_type == TextureType::_8)
+void BaseTextureCacheData::UploadDecoded()
+{
+	if (decodeJob == nullptr)
+		return;
+	std::shared_ptr<TextureDecodeJob> job = std::move(decodeJob);
+	job->done.wait();
+	UploadToGPU(job->outWidth, job->outHeight, job->data, job->gpuMipmaps, job->mipmapped);
+	setMemorySize(job->outWidth, job->outHeight, job->gpuMipmaps);
+	PrintTextureName();
+}
+
+void BaseTextureCacheData::CancelDecoding()
+{
+	if (decodeJob == nullptr)
+		return;
+	decodeJob.reset();
+	decodingTextures.erase(std::remove(decodingTextures.begin(), decodingTextures.end(), this), decodingTextures.end());
+}
+
+void UploadDecodedTextures(const std::function<void(BaseTextureCacheData *)>& beforeUpload)
+{
+	if (FrameCount != decodeStatsFrame)
 	{
-		if (mipmapped)
-		{
-			// This shouldn't happen since mipmapped palette textures are converted to rgba
-			pb8.init(width, height, true);
-			for (u32 i = 0; i <= tsp.TexU + 3u; i++)
-			{
-				pb8.set_mipmap(i);
-				u32 vram_addr = startAddress + OtherMipPoint[i] * tex->bpp / 8;
-				texconv8(&pb8, &vram[vram_addr], 1 << i, 1 << i);
-			}
-			pb8.set_mipmap(0);
-		}
-		else
-		{
-			pb8.init(width, height);
-			texconv8(&pb8, &vram[mmStartAddress], stride, height);
-		}
-		temp_tex_buffer = pb8.data();
+		decodeStats.textures = decodedTextures.exchange(0);
+		decodeStats.decodeTime = decodeTime.exchange(0) / 1000000.f;
+		decodeStats.waitTime = decodeWaitTime / 1000000.f;
+		decodeWaitTime = 0;
+		decodeStatsFrame = FrameCount;
 	}
-	else if (texconv != NULL)
+	if (decodingTextures.empty())
+		return;
+	std::vector<BaseTextureCacheData *> deferred;
+	for (BaseTextureCacheData *texture : decodingTextures)
 	{
-		if (mipmapped)
+		if (texture->decodeJob == nullptr)
+			continue;
+		TextureDecodeJob& job = *texture->decodeJob;
+		if (job.done.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
 		{
-			pb16.init(width, height, true);
-			for (u32 i = 0; i <= tsp.TexU + 3u; i++)
+			if (job.canDefer && !job.deferred)
 			{
-				pb16.set_mipmap(i);
-				u32 vram_addr;
-				if (tcw.VQ_Comp)
-				{
-					vram_addr = startAddress + VQMipPoint[i];
-					if (i == 0)
-					{
-						PixelBuffer<u16> pb0;
-						pb0.init(2, 2 ,false);
-						texconv(&pb0, (u8*)&vram[vram_addr], 2, 2);
-						*pb16.data() = *pb0.data(1, 1);
-						continue;
-					}
-				}
-				else
-					vram_addr = startAddress + OtherMipPoint[i] * tex->bpp / 8;
-				texconv(&pb16, (u8*)&vram[vram_addr], 1 << i, 1 << i);
+				// Use the previous version for this frame
+				job.deferred = true;
+				deferred.push_back(texture);
+				continue;
 			}
-			pb16.set_mipmap(0);
+			const auto start = std::chrono::steady_clock::now();
+			job.done.wait();
+			decodeWaitTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
 		}
-		else
-		{
-			pb16.init(width, height);
-			texconv(&pb16, (u8*)&vram[mmStartAddress], stride, heightLimit);
-		}
-		temp_tex_buffer = pb16.data();
-	}
-	else
-	{
-		//fill it in with a temp color
-		WARN_LOG(RENDERER, "UNHANDLED TEXTURE");
-		pb16.init(width, height);
-		memset(pb16.data(), 0x80, width * height * 2);
-		temp_tex_buffer = pb16.data();
-		mipmapped = false;
-	}
-	//lock the texture to detect changes in it
-	protectVRam();
-
-	UploadToGPU(upscaled_w, upscaled_h, (const u8 *)temp_tex_buffer, IsMipmapped(), mipmapped);
-	if (config::DumpTextures)
-	{
-		ComputeHash();
-		custom_texture.dumpTexture(this, upscaled_w, upscaled_h, temp_tex_buffer);
-		NOTICE_LOG(RENDERER, "Dumped texture %x.png. Old hash %x", texture_hash, old_texture_hash);
+		if (beforeUpload)
+			beforeUpload(texture);
+		texture->UploadDecoded();
 	}
-	PrintTextureName();
-	// Restore the original texture size if it was constrained to VRAM limits above
-	size = originalSize;
+	decodingTextures = std::move(deferred);
+}
 
-	return true;
+TextureDecodeStats getTextureDecodeStats() {
+	return decodeStats;
 }
 
 void BaseTextureCacheData::CheckCustomTexture()
@@ -701,6 +1015,7 @@ void BaseTextureCacheData::CheckCustomTexture()
 		gpuPalette = false;
 		is_custom_replaced = true;
 		UploadToGPU(custom_width, custom_height, custom_image_data, IsMipmapped(), false);
+		setMemorySize(custom_width, custom_height, IsMipmapped());
 		free(custom_image_data);
 		custom_image_data = nullptr;
 	}
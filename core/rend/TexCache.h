@@ -25,12 +25,15 @@
 #include <algorithm>
 #include <array>
 #include <atomic>
+#include <functional>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include <utility>
 
 class BaseTextureCacheData;
+struct TextureDecodeJob;
 
 struct vram_block
 {
@@ -38,10 +41,61 @@ struct vram_block
 	u32 end;
 
 	BaseTextureCacheData *texture;
+
+	// Links in the lock list of each page covered by the block
+	struct PageLink
+	{
+		vram_block *prev;
+		vram_block *next;
+	};
+	std::unique_ptr<PageLink[]> links;
+
+	PageLink& link(u32 page) {
+		return links[page - start / PAGE_SIZE];
+	}
 };
 
+// Called when a write-protected vram page is written to.
+// The textures locking the page are invalidated by the next call to VramProcessWrites().
 bool VramLockedWriteOffset(size_t offset);
 bool VramLockedWrite(u8* address);
+// Invalidate the textures of the vram pages written to since the last call
+void VramProcessWrites();
+
+struct VramLockStats
+{
+	u32 faultsPerSecond;		// Write faults on protected vram pages
+	u32 invalidationsPerSecond;	// Textures invalidated by vram writes
+	float handlerLatency;		// Average time spent in the write fault handler, in microseconds
+};
+VramLockStats getVramLockStats();
+
+// Upload the textures decoded by the worker threads (rend.TextureDecodeMode > 0).
+// Textures still being decoded are waited for, unless the previous version can be used for one more frame.
+// beforeUpload is called for each texture before it's uploaded.
+void UploadDecodedTextures(const std::function<void(BaseTextureCacheData *)>& beforeUpload = nullptr);
+
+struct TextureDecodeStats
+{
+	u32 textures;		// Textures decoded during the last frame
+	float decodeTime;	// Time spent decoding textures during the last frame, in milliseconds
+	float waitTime;		// Time the render thread waited for texture decoding during the last frame, in milliseconds
+};
+TextureDecodeStats getTextureDecodeStats();
+
+// Estimated memory used by the textures of the cache, in bytes
+u64 getTextureMemory();
+// Called by the texture cache once per frame
+void updateTextureCacheStats(u32 entries, u32 hits, u32 misses, u32 evictions);
+
+struct TextureCacheStats
+{
+	u64 bytes;				// Estimated memory used by the cached textures
+	u32 entries;			// Number of textures in the cache
+	float hitRate;			// Percentage of lookups finding an up-to-date texture during the last second
+	u32 evictionsPerSecond;	// Textures evicted to stay under the memory budget
+};
+TextureCacheStats getTextureCacheStats();
 
 void UpscalexBRZ(int factor, u32* source, u32* dest, int width, int height, bool has_alpha);
 
@@ -78,6 +132,8 @@ public:
 		custom_load_in_progress = 0;
 		gpuPalette = other.gpuPalette;
 		area = other.area;
+		lastUsed = other.lastUsed;
+		memorySize = other.memorySize;
 	}
 
 	TSP tsp;        	//dreamcast texture parameters
@@ -113,6 +169,9 @@ public:
 	bool is_custom_replaced;	// True if the texture currently on the GPU is the custom replacement
 	bool gpuPalette;
 	u8 area;
+	std::shared_ptr<TextureDecodeJob> decodeJob;	// decoding in progress
+	u32 lastUsed;		// frame number at which the texture was last looked up
+	u32 memorySize;		// estimated memory used by the texture, in bytes
 
 	void PrintTextureName();
 	virtual std::string GetId() = 0;
@@ -149,6 +208,10 @@ public:
 
 	void ComputeHash();
 	bool Update();
+	// Upload the result of the decoding job
+	void UploadDecoded();
+	// Discard the decoding in progress, if any
+	void CancelDecoding();
 	virtual void UploadToGPU(int width, int height, const u8 *temp_tex_buffer, bool mipmapped, bool mipmapsIncluded = false) = 0;
 	virtual bool Force32BitTexture(TextureType type) const { return false; }
 	void CheckCustomTexture();
@@ -159,6 +222,8 @@ public:
 	void protectVRam();
 	void unprotectVRam();
 	void invalidate();
+	// Update the memory size of the texture and the texture memory total
+	void setMemorySize(u32 width, u32 height, bool mipmapped);
 
 	static bool IsGpuHandledPaletted(TSP tsp, TCW tcw, int area)
 	{
@@ -184,6 +249,7 @@ class BaseTextureCache
 public:
 	Texture *getTextureCacheData(TSP tsp, TCW tcw, int area)
 	{
+		VramProcessWrites();
 		u64 key = tsp.full & TSPTextureCacheMask.full;
 		if (tcw.PixelFmt == PixelPal4 || tcw.PixelFmt == PixelPal8)
 		{
@@ -208,11 +274,17 @@ public:
 			texture = &it->second;
 			// Needed if the texture is updated
 			texture->tcw.StrideSel = tcw.StrideSel;
+			if (texture->dirty == 0)
+				hits++;
+			else
+				misses++;
 		}
 		else //create if not existing
 		{
 			texture = &cache.emplace(std::make_pair(key, Texture(tsp, tcw, area))).first->second;
+			misses++;
 		}
+		texture->lastUsed = FrameCount;
 
 		return texture;
 	}
@@ -238,7 +310,10 @@ public:
 		for (tsp.TexU = 0; tsp.TexU <= 7 && (8u << tsp.TexU) < width; tsp.TexU++);
 		for (tsp.TexV = 0; tsp.TexV <= 7 && (8u << tsp.TexV) < height; tsp.TexV++);
 
-		return getTextureCacheData(tsp, tcw, 0);
+		Texture *texture = getTextureCacheData(tsp, tcw, 0);
+		// The rendered texture replaces the decoded one
+		texture->CancelDecoding();
+		return texture;
 	}
 
 	void CollectCleanup()
@@ -261,6 +336,9 @@ public:
 			if (cache.find(id)->second.Delete())
 				cache.erase(id);
 		}
+		EvictTextures([](Texture *texture) {
+			return texture->Delete();
+		});
 	}
 
 	void Clear()
@@ -273,7 +351,45 @@ public:
 	}
 
 protected:
+	// Delete the least recently used textures until the texture memory is within budget
+	template<typename Deleter>
+	void EvictTextures(Deleter deleteTexture)
+	{
+		const u64 budget = (u64)config::TextureCacheSize * 1_MB;
+		if (budget != 0 && getTextureMemory() > budget)
+		{
+			// Recently used textures may still be in use by the gpu
+			const u32 TargetFrame = std::max(EvictionMinAge, FrameCount) - EvictionMinAge;
+			std::vector<std::pair<u32, u64>> list;
+			for (const auto& [id, texture] : cache)
+				if (texture.lastUsed < TargetFrame && texture.memorySize != 0 && texture.decodeJob == nullptr)
+					list.emplace_back(texture.lastUsed, id);
+			std::sort(list.begin(), list.end());
+
+			for (const auto& [lastUsed, id] : list)
+			{
+				if (getTextureMemory() <= budget)
+					break;
+				auto it = cache.find(id);
+				if (deleteTexture(&it->second))
+				{
+					cache.erase(it);
+					evictions++;
+				}
+			}
+		}
+		updateTextureCacheStats(cache.size(), hits, misses, evictions);
+		hits = 0;
+		misses = 0;
+		evictions = 0;
+	}
+
 	std::unordered_map<u64, Texture> cache;
+	u32 hits = 0;
+	u32 misses = 0;
+	u32 evictions = 0;
+	// Minimum number of frames a texture must be unused before being evicted
+	static constexpr u32 EvictionMinAge = 60;
 	// Only use TexU and TexV from TSP in the cache key
 	//     TexV : 7, TexU : 7
 	const TSP TSPTextureCacheMask = { { 7, 7 } };
@@ -0,0 +1,240 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "TexturePack.h"
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool TexturePack::map(const std::string& path)
+{
+#if defined(_WIN32) && !defined(TARGET_UWP)
+	HANDLE hFile = CreateFileW(nowide::widen(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+	HANDLE hMapping = CreateFileMapping(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (hMapping == nullptr)
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+	mapped = (const u8 *)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (mapped == nullptr)
+	{
+		CloseHandle(hMapping);
+		CloseHandle(hFile);
+		return false;
+	}
+	fileHandle = hFile;
+	mappingHandle = hMapping;
+	mappedSize = fileSize.QuadPart;
+	return true;
+#elif defined(_WIN32)
+	return false;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+	void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (p == MAP_FAILED)
+		return false;
+	mapped = (const u8 *)p;
+	mappedSize = st.st_size;
+	return true;
+#endif
+}
+
+void TexturePack::unmap()
+{
+	if (mapped == nullptr)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(mapped);
+	CloseHandle(mappingHandle);
+	CloseHandle(fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	munmap((void *)mapped, mappedSize);
+#endif
+	mapped = nullptr;
+	mappedSize = 0;
+}
+
+bool TexturePack::open(const std::string& path)
+{
+	close();
+	texpack::Header header;
+	if (!noMapping && map(path))
+	{
+		if (mappedSize < sizeof(header))
+		{
+			WARN_LOG(RENDERER, "Invalid texture pack %s", path.c_str());
+			unmap();
+			return false;
+		}
+		memcpy(&header, mapped, sizeof(header));
+	}
+	else
+	{
+		file.reset(hostfs::storage().openFile(path, "rb"));
+		if (file == nullptr || file->read(&header, sizeof(header), 1) != 1)
+		{
+			file.reset();
+			return false;
+		}
+	}
+	if (header.magic != texpack::Magic || header.version != texpack::Version)
+	{
+		WARN_LOG(RENDERER, "Invalid or unsupported texture pack %s", path.c_str());
+		close();
+		return false;
+	}
+	count = header.count;
+	if (mapped != nullptr)
+	{
+		if (mappedSize < sizeof(header) + (u64)count * sizeof(texpack::Entry))
+		{
+			WARN_LOG(RENDERER, "Truncated texture pack %s", path.c_str());
+			close();
+			return false;
+		}
+		entries = (const texpack::Entry *)(mapped + sizeof(header));
+	}
+	else
+	{
+		index.resize(count);
+		if (count != 0 && file->read(index.data(), sizeof(texpack::Entry), count) != count)
+		{
+			WARN_LOG(RENDERER, "Truncated texture pack %s", path.c_str());
+			close();
+			return false;
+		}
+		entries = index.data();
+	}
+	NOTICE_LOG(RENDERER, "Opened texture pack %s: %d textures%s", path.c_str(), count, mapped != nullptr ? " (mapped)" : "");
+
+	return true;
+}
+
+void TexturePack::close()
+{
+	unmap();
+	file.reset();
+	index.clear();
+	entries = nullptr;
+	count = 0;
+}
+
+const texpack::Entry *TexturePack::find(u32 hash) const
+{
+	if (entries == nullptr)
+		return nullptr;
+	const texpack::Entry *end = entries + count;
+	const texpack::Entry *entry = std::lower_bound(entries, end, hash, [](const texpack::Entry& e, u32 hash) {
+		return e.hash < hash;
+	});
+	if (entry == end || entry->hash != hash)
+		return nullptr;
+	return entry;
+}
+
+u8 *TexturePack::load(u32 hash, int& width, int& height)
+{
+	const texpack::Entry *entry = find(hash);
+	if (entry == nullptr)
+		return nullptr;
+	if (entry->rawSize != (u32)entry->width * entry->height * 4
+			|| (entry->compression == texpack::None && entry->size != entry->rawSize))
+	{
+		WARN_LOG(RENDERER, "Texture pack: invalid entry %08x", hash);
+		return nullptr;
+	}
+	const u8 *payload;
+	std::vector<u8> buffer;
+	if (mapped != nullptr)
+	{
+		if (entry->offset + entry->size > mappedSize)
+		{
+			WARN_LOG(RENDERER, "Texture pack: entry %08x is out of bounds", hash);
+			return nullptr;
+		}
+		payload = mapped + entry->offset;
+	}
+	else
+	{
+		buffer.resize(entry->size);
+		std::lock_guard<std::mutex> _(fileMutex);
+		if (file->seek(entry->offset, SEEK_SET) != 0 || file->read(buffer.data(), 1, buffer.size()) != buffer.size())
+		{
+			WARN_LOG(RENDERER, "Texture pack: can't read entry %08x", hash);
+			return nullptr;
+		}
+		payload = buffer.data();
+	}
+	u8 *data = (u8 *)malloc(entry->rawSize);
+	if (data == nullptr)
+		return nullptr;
+	switch (entry->compression)
+	{
+	case texpack::None:
+		memcpy(data, payload, entry->rawSize);
+		break;
+	case texpack::Deflate:
+		{
+			uLongf size = entry->rawSize;
+			if (uncompress(data, &size, payload, entry->size) != Z_OK || size != entry->rawSize)
+			{
+				WARN_LOG(RENDERER, "Texture pack: corrupted entry %08x", hash);
+				free(data);
+				return nullptr;
+			}
+			break;
+		}
+	default:
+		WARN_LOG(RENDERER, "Texture pack: unsupported compression %d", entry->compression);
+		free(data);
+		return nullptr;
+	}
+	width = entry->width;
+	height = entry->height;
+
+	return data;
+}
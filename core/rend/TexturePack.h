@@ -0,0 +1,67 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "types.h"
+#include "TexturePackFormat.h"
+#include "oslib/storage.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//
+// Read-only access to a custom texture pack.
+// The file is memory-mapped when possible so that only the textures actually used are paged in.
+// Otherwise the payloads are read from the file on demand.
+//
+class TexturePack
+{
+public:
+	~TexturePack() { close(); }
+
+	bool open(const std::string& path);
+	void close();
+	bool isOpen() const { return entries != nullptr; }
+	size_t size() const { return count; }
+
+	const texpack::Entry *find(u32 hash) const;
+	// Returns a malloc'ed RGBA8888 image or nullptr
+	u8 *load(u32 hash, int& width, int& height);
+
+private:
+	bool map(const std::string& path);
+	void unmap();
+
+	const u8 *mapped = nullptr;
+	size_t mappedSize = 0;
+#ifdef _WIN32
+	void *fileHandle = nullptr;
+	void *mappingHandle = nullptr;
+#endif
+	// Fallback when the file can't be mapped
+	std::unique_ptr<hostfs::File> file;
+	std::mutex fileMutex;
+	std::vector<texpack::Entry> index;
+
+	const texpack::Entry *entries = nullptr;
+	u32 count = 0;
+	// Always use the fallback
+	bool noMapping = false;
+
+	friend class TexturePackTest;
+};
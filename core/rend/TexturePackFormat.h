@@ -0,0 +1,66 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+// Custom texture pack file format.
+// Shared with tools/texpack so it must not depend on the rest of the core.
+//
+// Header
+// Entry[count], sorted by hash
+// Payloads, aligned on PayloadAlignment bytes
+//
+// Payloads are RGBA8888 images stored bottom-up, the way custom textures are uploaded,
+// either uncompressed or deflated (zlib).
+#pragma once
+#include <cstdint>
+
+namespace texpack
+{
+
+constexpr uint32_t Magic = 0x4b505446;	// "FTPK"
+constexpr uint32_t Version = 1;
+constexpr uint32_t PayloadAlignment = 16;
+constexpr const char *FileExtension = ".ftpack";
+
+enum Compression : uint8_t {
+	None,
+	Deflate,
+};
+
+struct Header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;
+	uint32_t reserved;
+};
+static_assert(sizeof(Header) == 16);
+
+struct Entry
+{
+	uint32_t hash;
+	uint16_t width;
+	uint16_t height;
+	uint64_t offset;	// from the start of the file
+	uint32_t size;		// payload size in the file
+	uint32_t rawSize;	// decompressed size: width * height * 4
+	uint8_t compression;
+	uint8_t reserved[7];
+};
+static_assert(sizeof(Entry) == 32);
+
+}
@@ -328,6 +328,7 @@ void DX11Renderer::Process(TA_context* ctx)
 		DX11Context::Instance()->setSwapInterval(ctx->rend.swapInterval);
 
 	ta_parse(ctx, true);
+	UploadDecodedTextures();
 }
 
 void DX11Renderer::resetContextState()
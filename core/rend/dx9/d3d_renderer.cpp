@@ -327,6 +327,7 @@ void D3DRenderer::Process(TA_context* ctx)
 	texCache.Cleanup();
 
 	ta_parse(ctx, false);
+	UploadDecodedTextures();
 }
 
 inline void D3DRenderer::setTexMode(D3DSAMPLERSTATETYPE state, u32 clamp, u32 mirror)
@@ -1081,6 +1081,7 @@ void OpenGLRenderer::Process(TA_context* ctx)
 	if (!ctx->rend.isRTT && ctx->rend.swapInterval > 0)
 		GraphicsContext::Instance()->setSwapInterval(ctx->rend.swapInterval);
 	ta_parse(ctx, gl.prim_restart_fixed_supported || gl.prim_restart_supported);
+	UploadDecodedTextures();
 }
 
 static void upload_vertex_indices()
@@ -0,0 +1,1131 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+	Tile-based CPU renderer
+
+	The render target is split into 32x32 tiles like the PVR2 ISP/TSP. All the
+	triangles of a frame are set up and binned into the tiles they overlap,
+	then tiles are rasterized independently on a thread pool using on-chip-like
+	tile color, depth and stencil buffers.
+	The pixel pipeline follows the OpenGL renderer shaders.
+	Naomi 2 T&L isn't supported.
+*/
+#include "hw/pvr/ta.h"
+#include "hw/pvr/ta_ctx.h"
+#include "hw/pvr/Renderer_if.h"
+#include "hw/pvr/pvr_mem.h"
+#include "rend/TexCache.h"
+#include "rend/transform_matrix.h"
+#include "util/thread_pool.h"
+#include "oslib/i18n.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if HOST_CPU == CPU_X86 || HOST_CPU == CPU_X64
+#include <emmintrin.h>
+#define SOFT_SSE2
+#elif HOST_CPU == CPU_ARM64
+#include <arm_neon.h>
+#define SOFT_NEON
+#endif
+
+namespace soft
+{
+
+constexpr int TileSize = 32;
+
+class Texture final : public BaseTextureCacheData
+{
+public:
+	Texture(TSP tsp, TCW tcw, int area) : BaseTextureCacheData(tsp, tcw, area) {
+	}
+	Texture(Texture&& other) : BaseTextureCacheData(std::move(other)) {
+		std::swap(pixels, other.pixels);
+		std::swap(indices, other.indices);
+		texWidth = other.texWidth;
+		texHeight = other.texHeight;
+	}
+
+	std::string GetId() override { return std::to_string((uintptr_t)this); }
+
+	void UploadToGPU(int width, int height, const u8 *temp_tex_buffer, bool mipmapped, bool mipmapsIncluded = false) override
+	{
+		// Only the highest level of detail is used
+		if (mipmapsIncluded)
+			for (int dim = 1; dim < width; dim *= 2)
+				temp_tex_buffer += dim * dim * (tex_type == TextureType::_8 ? 1 : 4);
+		texWidth = width;
+		texHeight = height;
+		if (tex_type == TextureType::_8)
+		{
+			indices.assign(temp_tex_buffer, temp_tex_buffer + width * height);
+			pixels.clear();
+		}
+		else
+		{
+			const u32 *src = (const u32 *)temp_tex_buffer;
+			pixels.assign(src, src + width * height);
+			indices.clear();
+		}
+	}
+
+	// Paletted textures are kept as 8-bit indices (see IsGpuHandledPaletted), everything else is converted to RGBA
+	bool Force32BitTexture(TextureType type) const override {
+		return type != TextureType::_8;
+	}
+
+	bool Delete() override
+	{
+		if (!BaseTextureCacheData::Delete())
+			return false;
+		pixels.clear();
+		indices.clear();
+		return true;
+	}
+
+	std::vector<u32> pixels;
+	std::vector<u8> indices;
+	int texWidth = 0;
+	int texHeight = 0;
+};
+
+class TextureCache final : public BaseTextureCache<Texture>
+{
+};
+
+struct Plane
+{
+	float dx, dy, c;
+
+	// Plane equation of an attribute given its value at the 3 vertices
+	void setup(const float *x, const float *y, float a0, float a1, float a2, float invArea)
+	{
+		dx = ((a1 - a0) * (y[2] - y[0]) - (a2 - a0) * (y[1] - y[0])) * invArea;
+		dy = ((a2 - a0) * (x[1] - x[0]) - (a1 - a0) * (x[2] - x[0])) * invArea;
+		c = a0 - dx * x[0] - dy * y[0];
+	}
+	void setConstant(float a) {
+		dx = dy = 0.f;
+		c = a;
+	}
+	float at(float x, float y) const {
+		return dx * x + dy * y + c;
+	}
+};
+
+enum ModifierVolumeMode { Xor, Or, Inclusion, Exclusion };
+
+enum class PrimType : u8 {
+	Polygon,
+	ModVolume,		// xor or or the volume bit
+	ModVolumeSum,	// inclusion or exclusion volume: sum the area
+	ModVolumeApply,	// apply the shadow to pixels inside volumes
+};
+
+struct Primitive
+{
+	PrimType type;
+	u8 listType;
+	bool sorted;
+	ModifierVolumeMode mvMode;
+	TileClipping clipMode;
+	// pixel bounding box: [minX, maxX[, [minY, maxY[
+	int minX, minY, maxX, maxY;
+	// clipping rectangle: [clipX0, clipX1[, [clipY0, clipY1[
+	int clipX0, clipY0, clipX1, clipY1;
+	// edge functions: inside if ea * x + eb * y + ec >= 0
+	float ea[3], eb[3], ec[3];
+	// 1/w
+	Plane z;
+	// perspective-corrected attributes (multiplied by 1/w)
+	Plane u, v;
+	Plane col[4];
+	Plane spc[4];
+	const PolyParam *pp;
+	const Texture *texture;
+};
+
+struct Color
+{
+	float r, g, b, a;
+
+	static Color fromRGBA(u32 c) {
+		return { (c & 0xff) / 255.f, ((c >> 8) & 0xff) / 255.f, ((c >> 16) & 0xff) / 255.f, (c >> 24) / 255.f };
+	}
+	u32 toRGBA() const
+	{
+		auto toU8 = [](float f) { return (u32)(std::clamp(f, 0.f, 1.f) * 255.f + 0.5f); };
+		return toU8(r) | (toU8(g) << 8) | (toU8(b) << 16) | (toU8(a) << 24);
+	}
+	static Color lerp(const Color& c0, const Color& c1, float t) {
+		return { c0.r + (c1.r - c0.r) * t, c0.g + (c1.g - c0.g) * t, c0.b + (c1.b - c0.b) * t, c0.a + (c1.a - c0.a) * t };
+	}
+};
+
+struct TileBuffer
+{
+	u32 color[TileSize * TileSize];
+	float depth[TileSize * TileSize];
+	// bit 7: pixel affected by modifier volumes
+	// bit 1: current volume state
+	// bit 0: summary result
+	u8 stencil[TileSize * TileSize];
+};
+
+// Evaluates the 3 edge functions of a primitive at 4 consecutive pixel centers.
+// Returns the coverage mask, bit i being set if pixel x + i is inside.
+static inline u32 coverage4(const Primitive& prim, float x, float y)
+{
+#if defined(SOFT_SSE2)
+	const __m128 xs = _mm_add_ps(_mm_set1_ps(x), _mm_setr_ps(0.f, 1.f, 2.f, 3.f));
+	__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	for (int i = 0; i < 3; i++)
+	{
+		const __m128 e = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(prim.ea[i]), xs), _mm_set1_ps(prim.eb[i] * y + prim.ec[i]));
+		inside = _mm_and_ps(inside, _mm_cmpge_ps(e, _mm_setzero_ps()));
+	}
+	return _mm_movemask_ps(inside);
+#elif defined(SOFT_NEON)
+	static const float offsets[4] = { 0.f, 1.f, 2.f, 3.f };
+	static const u32 bits[4] = { 1, 2, 4, 8 };
+	const float32x4_t xs = vaddq_f32(vdupq_n_f32(x), vld1q_f32(offsets));
+	uint32x4_t inside = vdupq_n_u32(~0u);
+	for (int i = 0; i < 3; i++)
+	{
+		const float32x4_t e = vmlaq_n_f32(vdupq_n_f32(prim.eb[i] * y + prim.ec[i]), xs, prim.ea[i]);
+		inside = vandq_u32(inside, vcgeq_f32(e, vdupq_n_f32(0.f)));
+	}
+	return vaddvq_u32(vandq_u32(inside, vld1q_u32(bits)));
+#else
+	u32 mask = 0;
+	for (int j = 0; j < 4; j++)
+	{
+		bool in = true;
+		for (int i = 0; i < 3; i++)
+			in = in && prim.ea[i] * (x + j) + prim.eb[i] * y + prim.ec[i] >= 0.f;
+		mask |= (u32)in << j;
+	}
+	return mask;
+#endif
+}
+
+static inline bool depthTest(u32 func, float z, float depth)
+{
+	switch (func)
+	{
+	case 0: return false;
+	case 1: return z < depth;
+	case 2: return z == depth;
+	case 3: return z <= depth;
+	case 4: return z > depth;
+	case 5: return z != depth;
+	case 6: return z >= depth;
+	default: return true;
+	}
+}
+
+static inline int wrapCoord(int c, int size, bool clamp, bool mirror)
+{
+	if (clamp)
+		return std::clamp(c, 0, size - 1);
+	if (mirror)
+	{
+		c %= size * 2;
+		if (c < 0)
+			c += size * 2;
+		return c >= size ? size * 2 - 1 - c : c;
+	}
+	c %= size;
+	return c < 0 ? c + size : c;
+}
+
+class SoftRenderer final : public Renderer
+{
+public:
+	bool Init() override
+	{
+		INFO_LOG(RENDERER, "Software renderer: %d worker threads", pool.size());
+		return true;
+	}
+
+	void Term() override
+	{
+		pool.stop();
+		texCache.Clear();
+		rendContext = nullptr;
+	}
+
+	void Process(TA_context* ctx) override
+	{
+		if (settings.platform.isNaomi2())
+			throw RendererException(i18n::T("Naomi 2 is not supported by the software renderer"));
+		rendContext = &ctx->rend;
+		if (resetTextureCache) {
+			texCache.Clear();
+			resetTextureCache = false;
+		}
+		texCache.CollectCleanup();
+		// The palette and fog table are read when rendering
+		updatePalette = false;
+		updateFogTable = false;
+		ta_parse(ctx, false);
+		UploadDecodedTextures();
+	}
+
+	bool Render() override
+	{
+		const rend_context& ctx = *rendContext;
+		int w, h;
+		if (ctx.isRTT)
+		{
+			w = ctx.tileClip.bottomRight().x + 1;
+			h = ctx.tileClip.bottomRight().y + 1;
+		}
+		else {
+			getPvrFramebufferSize(ctx, w, h);
+		}
+		if (w <= 0 || h <= 0)
+			return !ctx.isRTT;
+		resize(w, h);
+		setupFrameState(ctx);
+		setupPrimitives(ctx);
+		binPrimitives();
+
+		pool.parallelFor(tilesX * tilesY, [this](size_t tile) {
+			renderTile((int)tile);
+		});
+
+		if (ctx.isRTT)
+		{
+			writeRTT(ctx);
+			return false;
+		}
+		if (config::EmulateFramebuffer)
+		{
+			writeFramebufferToVRAM(ctx);
+		}
+		else
+		{
+			lastFrame = colorBuffer;
+			lastFrameWidth = width;
+			lastFrameHeight = height;
+			clearLastFrame = false;
+		}
+		return true;
+	}
+
+	void RenderFramebuffer(const FramebufferInfo& info) override
+	{
+		PixelBuffer<u32> pb;
+		int w, h;
+		ReadFramebuffer(info, pb, w, h);
+		lastFrameWidth = w;
+		lastFrameHeight = h;
+		if (info.fb_r_ctrl.fb_enable == 0 || info.vo_control.blank_video == 1)
+		{
+			// Video output disabled
+			const u32 border = info.vo_border_col._red | (info.vo_border_col._green << 8)
+					| (info.vo_border_col._blue << 16) | 0xff000000;
+			lastFrame.assign(w * h, border);
+		}
+		else {
+			lastFrame.assign(pb.data(), pb.data() + w * h);
+		}
+		clearLastFrame = false;
+	}
+
+	bool GetLastFrame(std::vector<u8>& data, int& outWidth, int& outHeight) override
+	{
+		if (lastFrame.empty() || clearLastFrame)
+			return false;
+		const float aspectRatio = getDCFramebufferAspectRatio();
+		if (outWidth != 0) {
+			outHeight = outWidth / aspectRatio;
+		}
+		else if (outHeight != 0) {
+			outWidth = aspectRatio * outHeight;
+		}
+		else
+		{
+			outWidth = lastFrameWidth;
+			outHeight = lastFrameHeight;
+			if (config::Rotate90)
+				std::swap(outWidth, outHeight);
+			// We need square pixels for PNG
+			int w = aspectRatio * outHeight;
+			if (outWidth > w)
+				outHeight = outWidth / aspectRatio;
+			else
+				outWidth = w;
+		}
+		data.resize(outWidth * outHeight * 3);
+		u8 *dst = data.data();
+		for (int y = 0; y < outHeight; y++)
+			for (int x = 0; x < outWidth; x++)
+			{
+				int sx, sy;
+				if (config::Rotate90)
+				{
+					sx = y * lastFrameWidth / outHeight;
+					sy = (outWidth - 1 - x) * lastFrameHeight / outWidth;
+				}
+				else
+				{
+					sx = x * lastFrameWidth / outWidth;
+					sy = y * lastFrameHeight / outHeight;
+				}
+				const u32 pixel = lastFrame[sy * lastFrameWidth + sx];
+				*dst++ = pixel & 0xff;
+				*dst++ = (pixel >> 8) & 0xff;
+				*dst++ = (pixel >> 16) & 0xff;
+			}
+		return true;
+	}
+
+	BaseTextureCacheData *GetTexture(TSP tsp, TCW tcw, int area = 0) override
+	{
+		Texture *texture = texCache.getTextureCacheData(tsp, tcw, area);
+		if (texture->NeedsUpdate())
+		{
+			if (!texture->Update())
+				texture = nullptr;
+		}
+		else if (texture->IsCustomTextureAvailable())
+		{
+			texture->CheckCustomTexture();
+		}
+		return texture;
+	}
+
+private:
+	void resize(int w, int h)
+	{
+		width = w;
+		height = h;
+		tilesX = (w + TileSize - 1) / TileSize;
+		tilesY = (h + TileSize - 1) / TileSize;
+		colorBuffer.resize(w * h);
+		bins.resize(tilesX * tilesY);
+	}
+
+	void setupFrameState(const rend_context& ctx)
+	{
+		u8 *fogTable = (u8 *)FOG_TABLE;
+		for (int i = 0; i < 128; i++)
+		{
+			fogTable0[i] = fogTable[i * 4] / 255.f;
+			fogTable1[i] = fogTable[i * 4 + 1] / 255.f;
+		}
+		fogDensity = FOG_DENSITY.get() * config::ExtraDepthScale;
+		fogColRam = Color::fromRGBA(FOG_COL_RAM._red | (FOG_COL_RAM._green << 8) | (FOG_COL_RAM._blue << 16));
+		fogColVert = Color::fromRGBA(FOG_COL_VERT._red | (FOG_COL_VERT._green << 8) | (FOG_COL_VERT._blue << 16));
+		fogClampMin = Color::fromRGBA(ctx.fog_clamp_min._red | (ctx.fog_clamp_min._green << 8)
+				| (ctx.fog_clamp_min._blue << 16) | (ctx.fog_clamp_min._alpha << 24));
+		fogClampMax = Color::fromRGBA(ctx.fog_clamp_max._red | (ctx.fog_clamp_max._green << 8)
+				| (ctx.fog_clamp_max._blue << 16) | (ctx.fog_clamp_max._alpha << 24));
+		alphaRef = PT_ALPHA_REF & 0xff;
+		shadowScale = FPU_SHAD_SCALE.scale_factor / 256.f;
+		if (ctx.isRTT)
+			clearColor = 0;
+		else
+			clearColor = VO_BORDER_COL._red | (VO_BORDER_COL._green << 8) | (VO_BORDER_COL._blue << 16) | 0xff000000;
+		clearBuffer = ctx.isRTT || ctx.clearFramebuffer;
+
+		// Base clipping
+		Rect clip = ctx.tileClip;
+		if (!ctx.isRTT && !config::EmulateFramebuffer)
+		{
+			// Framebuffer clipping is applied after scaling (SCALER_CTL)
+			float xscale = ctx.scaler_ctl.hscale == 1 ? 2.f : 1.f;
+			float yscale = 1.f;
+			if (ctx.scaler_ctl.vscalefactor < 1024 || ctx.scaler_ctl.vscalefactor > 1025)
+				yscale = ctx.scaler_ctl.vscalefactor / 1024.f;
+			Rect fbClip;
+			fbClip.origin = glm::ivec2(std::round(ctx.fbClip.origin.x * xscale), std::round(ctx.fbClip.origin.y * yscale));
+			fbClip.size = glm::ivec2(std::round(ctx.fbClip.size.x * xscale), std::round(ctx.fbClip.size.y * yscale));
+			clip = intersect(clip, fbClip);
+		}
+		baseClipX0 = std::max(clip.origin.x, 0);
+		baseClipY0 = std::max(clip.origin.y, 0);
+		baseClipX1 = std::min(clip.origin.x + clip.size.x, width);
+		baseClipY1 = std::min(clip.origin.y + clip.size.y, height);
+	}
+
+	void setClipping(Primitive& prim, u32 tileclip)
+	{
+		prim.clipX0 = baseClipX0;
+		prim.clipY0 = baseClipY0;
+		prim.clipX1 = baseClipX1;
+		prim.clipY1 = baseClipY1;
+		prim.clipMode = TileClipping::Off;
+		u32 clipmode = tileclip >> 28;
+		if (!config::Clipping || clipmode < 2)
+			return;
+		const int csx = (tileclip & 63) * 32;
+		const int cex = (((tileclip >> 6) & 63) + 1) * 32;
+		const int csy = ((tileclip >> 12) & 31) * 32;
+		const int cey = (((tileclip >> 17) & 31) + 1) * 32;
+		if (clipmode & 1)
+		{
+			// Render stuff outside the region
+			prim.clipMode = TileClipping::Inside;
+			prim.clipX0 = csx;
+			prim.clipY0 = csy;
+			prim.clipX1 = cex;
+			prim.clipY1 = cey;
+		}
+		else
+		{
+			// Render stuff inside the region
+			prim.clipMode = TileClipping::Outside;
+			prim.clipX0 = std::max(prim.clipX0, csx);
+			prim.clipY0 = std::max(prim.clipY0, csy);
+			prim.clipX1 = std::min(prim.clipX1, cex);
+			prim.clipY1 = std::min(prim.clipY1, cey);
+		}
+	}
+
+	// Sets up the edge functions and bounding box of a triangle.
+	// Returns false if the triangle is culled or empty.
+	bool setupEdges(Primitive& prim, float x[3], float y[3], float z[3], u32 cullMode, bool modVol, float& invArea)
+	{
+		for (int i = 0; i < 3; i++)
+			if (!std::isfinite(x[i]) || !std::isfinite(y[i]) || !std::isfinite(z[i]))
+				return false;
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (area == 0.f)
+			return false;
+		if (cullMode != 0)
+		{
+			if (!modVol && std::fabs(area) < FPU_CULL_VAL * 2.f)
+				return false;
+			if (cullMode >= 2)
+			{
+				// modifier volumes use the opposite culling direction
+				const bool cullPositive = ((cullMode & 1) != 0) ^ modVol;
+				if (cullPositive ? area < 0.f : area > 0.f)
+					return false;
+			}
+		}
+		if (area < 0.f)
+		{
+			// Make it counter-clockwise
+			std::swap(x[1], x[2]);
+			std::swap(y[1], y[2]);
+			std::swap(z[1], z[2]);
+			area = -area;
+		}
+		invArea = 1.f / area;
+		for (int i = 0; i < 3; i++)
+		{
+			const int j = (i + 1) % 3;
+			prim.ea[i] = y[i] - y[j];
+			prim.eb[i] = x[j] - x[i];
+			prim.ec[i] = -prim.ea[i] * x[i] - prim.eb[i] * y[i];
+			// top-left fill rule
+			const bool topLeft = prim.ea[i] > 0.f || (prim.ea[i] == 0.f && prim.eb[i] > 0.f);
+			if (!topLeft)
+				prim.ec[i] -= (std::fabs(prim.ea[i]) + std::fabs(prim.eb[i])) * 1e-4f;
+		}
+		prim.minX = std::max((int)std::floor(std::min({ x[0], x[1], x[2] })), prim.clipMode == TileClipping::Inside ? baseClipX0 : prim.clipX0);
+		prim.minY = std::max((int)std::floor(std::min({ y[0], y[1], y[2] })), prim.clipMode == TileClipping::Inside ? baseClipY0 : prim.clipY0);
+		prim.maxX = std::min((int)std::ceil(std::max({ x[0], x[1], x[2] })) + 1, prim.clipMode == TileClipping::Inside ? baseClipX1 : prim.clipX1);
+		prim.maxY = std::min((int)std::ceil(std::max({ y[0], y[1], y[2] })) + 1, prim.clipMode == TileClipping::Inside ? baseClipY1 : prim.clipY1);
+		if (prim.minX >= prim.maxX || prim.minY >= prim.maxY)
+			return false;
+		prim.z.setup(x, y, z[0], z[1], z[2], invArea);
+		return true;
+	}
+
+	void addTriangle(const PolyParam& pp, u32 listType, bool sorted, const Vertex *v0, const Vertex *v1, const Vertex *v2)
+	{
+		const Vertex *vtx[3] = { v0, v1, v2 };
+		Primitive prim;
+		prim.type = PrimType::Polygon;
+		prim.listType = listType;
+		prim.sorted = sorted;
+		prim.pp = &pp;
+		prim.texture = pp.pcw.Texture ? (const Texture *)pp.texture : nullptr;
+		if (prim.texture != nullptr && prim.texture->texWidth == 0)
+			prim.texture = nullptr;
+		setClipping(prim, pp.tileclip);
+
+		float x[3] = { v0->x, v1->x, v2->x };
+		float y[3] = { v0->y, v1->y, v2->y };
+		float z[3] = { v0->z, v1->z, v2->z };
+		float invArea;
+		if (!setupEdges(prim, x, y, z, pp.isp.CullMode, false, invArea))
+			return;
+		if (x[1] != v1->x || y[1] != v1->y)
+			// vertices 1 and 2 have been swapped
+			std::swap(vtx[1], vtx[2]);
+		auto persp = [&](float Vertex::*attr, Plane& plane) {
+			plane.setup(x, y, vtx[0]->*attr * z[0], vtx[1]->*attr * z[1], vtx[2]->*attr * z[2], invArea);
+		};
+		persp(&Vertex::u, prim.u);
+		persp(&Vertex::v, prim.v);
+		for (int i = 0; i < 4; i++)
+		{
+			if (pp.pcw.Gouraud)
+			{
+				prim.col[i].setup(x, y, vtx[0]->col[i] / 255.f * z[0], vtx[1]->col[i] / 255.f * z[1], vtx[2]->col[i] / 255.f * z[2], invArea);
+				prim.spc[i].setup(x, y, vtx[0]->spc[i] / 255.f * z[0], vtx[1]->spc[i] / 255.f * z[1], vtx[2]->spc[i] / 255.f * z[2], invArea);
+			}
+			else
+			{
+				// flat shading uses the last vertex of the triangle
+				prim.col[i] = prim.z;
+				prim.col[i].dx *= v2->col[i] / 255.f;
+				prim.col[i].dy *= v2->col[i] / 255.f;
+				prim.col[i].c *= v2->col[i] / 255.f;
+				prim.spc[i] = prim.z;
+				prim.spc[i].dx *= v2->spc[i] / 255.f;
+				prim.spc[i].dy *= v2->spc[i] / 255.f;
+				prim.spc[i].c *= v2->spc[i] / 255.f;
+			}
+		}
+		prims.push_back(prim);
+	}
+
+	void addStrips(const std::vector<PolyParam>& polys, int first, int end, u32 listType, bool sorted)
+	{
+		const rend_context& ctx = *rendContext;
+		for (int i = first; i < end; i++)
+		{
+			const PolyParam& pp = polys[i];
+			if (pp.count < 3)
+				continue;
+			if ((listType == ListType_Opaque || (listType == ListType_Translucent && !sorted))
+					&& pp.isp.DepthMode == 0)
+				// depthFunc = never
+				continue;
+			const u32 *idx = &ctx.idx[pp.first];
+			for (u32 j = 0; j + 2 < pp.count; j++)
+			{
+				const Vertex *v0 = &ctx.verts[idx[j]];
+				const Vertex *v1 = &ctx.verts[idx[j + 1]];
+				const Vertex *v2 = &ctx.verts[idx[j + 2]];
+				if (j & 1)
+					std::swap(v0, v1);
+				addTriangle(pp, listType, sorted, v0, v1, v2);
+			}
+		}
+	}
+
+	void addSortedTriangles(int first, int end)
+	{
+		const rend_context& ctx = *rendContext;
+		for (int i = first; i < end; i++)
+		{
+			const SortedTriangle& tri = ctx.sortedTriangles[i];
+			const PolyParam& pp = ctx.global_param_tr[tri.polyIndex];
+			const u32 *idx = &ctx.idx[tri.first];
+			for (u32 j = 0; j + 2 < tri.count; j += 3)
+				addTriangle(pp, ListType_Translucent, true, &ctx.verts[idx[j]], &ctx.verts[idx[j + 1]], &ctx.verts[idx[j + 2]]);
+		}
+	}
+
+	void addModVolTriangles(const ModifierVolumeParam& param, ModifierVolumeMode mode)
+	{
+		const rend_context& ctx = *rendContext;
+		for (u32 i = param.first; i < param.first + param.count; i++)
+		{
+			const ModTriangle& tri = ctx.modtrig[i];
+			Primitive prim;
+			prim.type = PrimType::ModVolume;
+			prim.mvMode = mode;
+			setClipping(prim, param.tileclip);
+			float x[3] = { tri.x0, tri.x1, tri.x2 };
+			float y[3] = { tri.y0, tri.y1, tri.y2 };
+			float z[3] = { tri.z0, tri.z1, tri.z2 };
+			float invArea;
+			if (setupEdges(prim, x, y, z, param.isp.CullMode, true, invArea))
+				prims.push_back(prim);
+		}
+	}
+
+	void addControl(PrimType type, ModifierVolumeMode mode = Xor)
+	{
+		Primitive prim;
+		prim.type = type;
+		prim.mvMode = mode;
+		prim.minX = baseClipX0;
+		prim.minY = baseClipY0;
+		prim.maxX = baseClipX1;
+		prim.maxY = baseClipY1;
+		prims.push_back(prim);
+	}
+
+	void addModVols(int first, int count)
+	{
+		const rend_context& ctx = *rendContext;
+		if (count == 0 || ctx.modtrig.empty())
+			return;
+		bool volumes = false;
+		for (int i = first; i < first + count; i++)
+		{
+			const ModifierVolumeParam& param = ctx.global_param_mvo[i];
+			if (param.count == 0)
+				continue;
+			const u32 mvMode = param.isp.DepthMode;
+			if (!param.isp.VolumeLast && mvMode > 0)
+				addModVolTriangles(param, Or);	// OR'ing (open volume or quad)
+			else
+				addModVolTriangles(param, Xor);	// XOR'ing (closed volume)
+			if (mvMode == 1 || mvMode == 2)
+			{
+				// Sum the area
+				addControl(PrimType::ModVolumeSum, mvMode == 1 ? Inclusion : Exclusion);
+				volumes = true;
+			}
+		}
+		if (volumes)
+			addControl(PrimType::ModVolumeApply);
+	}
+
+	void setupPrimitives(const rend_context& ctx)
+	{
+		prims.clear();
+		RenderPass previousPass = {};
+		for (const RenderPass& pass : ctx.render_passes)
+		{
+			addStrips(ctx.global_param_op, previousPass.op_count, pass.op_count, ListType_Opaque, false);
+			addStrips(ctx.global_param_pt, previousPass.pt_count, pass.pt_count, ListType_Punch_Through, false);
+			if (config::ModifierVolumes)
+				addModVols(previousPass.mvo_count, pass.mvo_count - previousPass.mvo_count);
+			if (pass.autosort)
+			{
+				if (!config::PerStripSorting)
+					addSortedTriangles(previousPass.sorted_tr_count, pass.sorted_tr_count);
+				else
+					// Already sorted by depth by sortPolyParams() in ta_parse(), as for the GL renderer
+					addStrips(ctx.global_param_tr, previousPass.tr_count, pass.tr_count, ListType_Translucent, true);
+			}
+			else
+			{
+				addStrips(ctx.global_param_tr, previousPass.tr_count, pass.tr_count, ListType_Translucent, false);
+			}
+			previousPass = pass;
+		}
+	}
+
+	void binPrimitives()
+	{
+		for (auto& bin : bins)
+			bin.clear();
+		for (u32 i = 0; i < prims.size(); i++)
+		{
+			const Primitive& prim = prims[i];
+			const int tx1 = (prim.maxX - 1) / TileSize;
+			const int ty1 = (prim.maxY - 1) / TileSize;
+			for (int ty = prim.minY / TileSize; ty <= ty1; ty++)
+				for (int tx = prim.minX / TileSize; tx <= tx1; tx++)
+					bins[ty * tilesX + tx].push_back(i);
+		}
+	}
+
+	u32 texel(const Primitive& prim, int x, int y) const
+	{
+		const Texture& tex = *prim.texture;
+		const TSP tsp = prim.pp->tsp;
+		x = wrapCoord(x, tex.texWidth, tsp.ClampU, tsp.FlipU);
+		y = wrapCoord(y, tex.texHeight, tsp.ClampV, tsp.FlipV);
+		if (!tex.indices.empty())
+		{
+			const TCW tcw = prim.pp->tcw;
+			const u32 paletteIndex = tcw.PixelFmt == PixelPal4 ? tcw.PalSelect << 4 : (tcw.PalSelect >> 4) << 8;
+			return palette32_ram[(tex.indices[y * tex.texWidth + x] + paletteIndex) & 1023];
+		}
+		return tex.pixels[y * tex.texWidth + x];
+	}
+
+	Color sample(const Primitive& prim, float u, float v) const
+	{
+		const Texture& tex = *prim.texture;
+		bool nearest;
+		if (config::TextureFiltering == 0)
+			nearest = prim.pp->tsp.FilterMode == 0;
+		else
+			nearest = config::TextureFiltering == 1;
+		const float fu = u * tex.texWidth;
+		const float fv = v * tex.texHeight;
+		if (nearest)
+			return Color::fromRGBA(texel(prim, (int)std::floor(fu), (int)std::floor(fv)));
+
+		const float pu = fu - 0.5f;
+		const float pv = fv - 0.5f;
+		const float x0 = std::floor(pu);
+		const float y0 = std::floor(pv);
+		const int ix = (int)x0;
+		const int iy = (int)y0;
+		const Color c00 = Color::fromRGBA(texel(prim, ix, iy));
+		const Color c10 = Color::fromRGBA(texel(prim, ix + 1, iy));
+		const Color c01 = Color::fromRGBA(texel(prim, ix, iy + 1));
+		const Color c11 = Color::fromRGBA(texel(prim, ix + 1, iy + 1));
+		return Color::lerp(Color::lerp(c00, c10, pu - x0), Color::lerp(c01, c11, pu - x0), pv - y0);
+	}
+
+	float fogMode2(float w) const
+	{
+		const float z = std::clamp(fogDensity * w, 1.f, 255.9999f);
+		const float exp = std::floor(std::log2(z));
+		const float m = z * 16.f / std::exp2(exp) - 16.f;
+		const int idx = std::clamp((int)std::floor(m) + (int)exp * 16, 0, 127);
+		const float frac = m - std::floor(m);
+		return fogTable1[idx] + (fogTable0[idx] - fogTable1[idx]) * frac;
+	}
+
+	// Returns false if the pixel is discarded
+	bool shadePixel(const Primitive& prim, float px, float py, float z, Color& color) const
+	{
+		const PolyParam& pp = *prim.pp;
+		const float w = 1.f / z;
+		color = { prim.col[0].at(px, py) * w, prim.col[1].at(px, py) * w, prim.col[2].at(px, py) * w, prim.col[3].at(px, py) * w };
+		Color offset = { prim.spc[0].at(px, py) * w, prim.spc[1].at(px, py) * w, prim.spc[2].at(px, py) * w, prim.spc[3].at(px, py) * w };
+		if (!pp.tsp.UseAlpha)
+			color.a = 1.f;
+		const u32 fogCtrl = config::Fog ? pp.tsp.FogCtrl : 2;
+		if (fogCtrl == 3)
+			color = { fogColRam.r, fogColRam.g, fogColRam.b, fogMode2(z) };
+		if (prim.texture != nullptr)
+		{
+			Color texcol = sample(prim, prim.u.at(px, py) * w, prim.v.at(px, py) * w);
+			if (pp.tsp.IgnoreTexA)
+				texcol.a = 1.f;
+			switch (pp.tsp.ShadInstr)
+			{
+			case 0:	// decal
+				color = texcol;
+				break;
+			case 1:	// modulate
+				color.r *= texcol.r;
+				color.g *= texcol.g;
+				color.b *= texcol.b;
+				color.a = texcol.a;
+				break;
+			case 2:	// decal alpha
+				color.r += (texcol.r - color.r) * texcol.a;
+				color.g += (texcol.g - color.g) * texcol.a;
+				color.b += (texcol.b - color.b) * texcol.a;
+				break;
+			case 3:	// modulate alpha
+				color.r *= texcol.r;
+				color.g *= texcol.g;
+				color.b *= texcol.b;
+				color.a *= texcol.a;
+				break;
+			}
+			if (pp.pcw.Offset)
+			{
+				color.r += offset.r;
+				color.g += offset.g;
+				color.b += offset.b;
+			}
+		}
+		if (pp.tsp.ColorClamp)
+		{
+			color.r = std::clamp(color.r, fogClampMin.r, fogClampMax.r);
+			color.g = std::clamp(color.g, fogClampMin.g, fogClampMax.g);
+			color.b = std::clamp(color.b, fogClampMin.b, fogClampMax.b);
+			color.a = std::clamp(color.a, fogClampMin.a, fogClampMax.a);
+		}
+		if (fogCtrl == 0)
+		{
+			const float f = fogMode2(z);
+			color.r += (fogColRam.r - color.r) * f;
+			color.g += (fogColRam.g - color.g) * f;
+			color.b += (fogColRam.b - color.b) * f;
+		}
+		else if (fogCtrl == 1 && pp.pcw.Offset)
+		{
+			const float f = std::clamp(offset.a, 0.f, 1.f);
+			color.r += (fogColVert.r - color.r) * f;
+			color.g += (fogColVert.g - color.g) * f;
+			color.b += (fogColVert.b - color.b) * f;
+		}
+		if (prim.listType == ListType_Punch_Through)
+		{
+			if ((int)(std::clamp(color.a, 0.f, 1.f) * 255.f + 0.5f) < (int)alphaRef)
+				return false;
+			color.a = 1.f;
+		}
+		return true;
+	}
+
+	static float blendFactor(u32 instr, const Color& other, const Color& src, const Color& dst, int channel)
+	{
+		auto comp = [channel](const Color& c) {
+			return channel == 0 ? c.r : channel == 1 ? c.g : channel == 2 ? c.b : c.a;
+		};
+		switch (instr)
+		{
+		case 0: return 0.f;
+		case 1: return 1.f;
+		case 2: return comp(other);
+		case 3: return 1.f - comp(other);
+		case 4: return src.a;
+		case 5: return 1.f - src.a;
+		case 6: return dst.a;
+		default: return 1.f - dst.a;
+		}
+	}
+
+	static u32 blend(const TSP tsp, Color src, u32 dstPixel)
+	{
+		if (tsp.SrcInstr == 1 && tsp.DstInstr == 0)
+			return src.toRGBA();
+		src.r = std::clamp(src.r, 0.f, 1.f);
+		src.g = std::clamp(src.g, 0.f, 1.f);
+		src.b = std::clamp(src.b, 0.f, 1.f);
+		src.a = std::clamp(src.a, 0.f, 1.f);
+		const Color dst = Color::fromRGBA(dstPixel);
+		Color out;
+		float *o = &out.r;
+		const float *s = &src.r;
+		const float *d = &dst.r;
+		for (int c = 0; c < 4; c++)
+			o[c] = s[c] * blendFactor(tsp.SrcInstr, dst, src, dst, c)
+				+ d[c] * blendFactor(tsp.DstInstr, src, src, dst, c);
+		return out.toRGBA();
+	}
+
+	void drawPolygon(const Primitive& prim, TileBuffer& buf, int tileX, int tileY) const
+	{
+		const PolyParam& pp = *prim.pp;
+		u32 depthFunc;
+		bool depthWrite;
+		if (prim.listType == ListType_Punch_Through || prim.sorted)
+			depthFunc = 6;	// >=
+		else
+			depthFunc = pp.isp.DepthMode;
+		if (prim.sorted)
+			depthWrite = false;
+		else
+			// Z Write Disable seems to be ignored for punch-through.
+			depthWrite = prim.listType == ListType_Punch_Through || !pp.isp.ZWriteDis;
+		const u8 stencil = pp.pcw.Shadow ? 0x80 : 0;
+
+		const int x0 = std::max(prim.minX, tileX);
+		const int x1 = std::min(prim.maxX, tileX + TileSize);
+		const int y0 = std::max(prim.minY, tileY);
+		const int y1 = std::min(prim.maxY, tileY + TileSize);
+		for (int y = y0; y < y1; y++)
+		{
+			const float py = y + 0.5f;
+			for (int xs = x0; xs < x1; xs += 4)
+			{
+				u32 mask = coverage4(prim, xs + 0.5f, py);
+				if (xs + 4 > x1)
+					mask &= (1 << (x1 - xs)) - 1;
+				for (; mask != 0; mask &= mask - 1)
+				{
+					const int x = xs + ctz(mask);
+					if (prim.clipMode == TileClipping::Inside
+							&& x >= prim.clipX0 && x < prim.clipX1 && y >= prim.clipY0 && y < prim.clipY1)
+						continue;
+					const float px = x + 0.5f;
+					const int i = (y - tileY) * TileSize + x - tileX;
+					const float z = prim.z.at(px, py);
+					if (!depthTest(depthFunc, z, buf.depth[i]))
+						continue;
+					Color color;
+					if (!shadePixel(prim, px, py, z, color))
+						continue;
+					buf.color[i] = blend(pp.tsp, color, buf.color[i]);
+					if (depthWrite)
+						buf.depth[i] = z;
+					buf.stencil[i] = stencil;
+				}
+			}
+		}
+	}
+
+	void drawModVolume(const Primitive& prim, TileBuffer& buf, int tileX, int tileY) const
+	{
+		const int x0 = std::max(prim.minX, tileX);
+		const int x1 = std::min(prim.maxX, tileX + TileSize);
+		const int y0 = std::max(prim.minY, tileY);
+		const int y1 = std::min(prim.maxY, tileY + TileSize);
+		for (int y = y0; y < y1; y++)
+		{
+			const float py = y + 0.5f;
+			for (int xs = x0; xs < x1; xs += 4)
+			{
+				u32 mask = coverage4(prim, xs + 0.5f, py);
+				if (xs + 4 > x1)
+					mask &= (1 << (x1 - xs)) - 1;
+				for (; mask != 0; mask &= mask - 1)
+				{
+					const int x = xs + ctz(mask);
+					const int i = (y - tileY) * TileSize + x - tileX;
+					if (prim.z.at(x + 0.5f, py) <= buf.depth[i])
+						continue;
+					if (prim.mvMode == Xor)
+						buf.stencil[i] ^= 2;
+					else
+						buf.stencil[i] |= 2;
+				}
+			}
+		}
+	}
+
+	void renderTile(int tile)
+	{
+		const int tileX = (tile % tilesX) * TileSize;
+		const int tileY = (tile / tilesX) * TileSize;
+		const int tileW = std::min(TileSize, width - tileX);
+		const int tileH = std::min(TileSize, height - tileY);
+
+		TileBuffer buf;
+		for (int y = 0; y < tileH; y++)
+		{
+			if (clearBuffer)
+				std::fill(&buf.color[y * TileSize], &buf.color[y * TileSize + tileW], clearColor);
+			else
+				memcpy(&buf.color[y * TileSize], &colorBuffer[(tileY + y) * width + tileX], tileW * sizeof(u32));
+		}
+		std::fill(std::begin(buf.depth), std::end(buf.depth), 0.f);
+		memset(buf.stencil, 0, sizeof(buf.stencil));
+
+		for (u32 primIdx : bins[tile])
+		{
+			const Primitive& prim = prims[primIdx];
+			switch (prim.type)
+			{
+			case PrimType::Polygon:
+				drawPolygon(prim, buf, tileX, tileY);
+				break;
+			case PrimType::ModVolume:
+				drawModVolume(prim, buf, tileX, tileY);
+				break;
+			case PrimType::ModVolumeSum:
+				for (u8& st : buf.stencil)
+				{
+					if (prim.mvMode == Inclusion)
+						st = (st & 0x80) | ((st & 3) != 0 ? 1 : 0);
+					else
+						st = (st & 0x80) | ((st & 3) == 1 ? 1 : 0);
+				}
+				break;
+			case PrimType::ModVolumeApply:
+				for (int i = 0; i < TileSize * TileSize; i++)
+				{
+					u8& st = buf.stencil[i];
+					if ((st & 0x81) == 0x81)
+					{
+						Color c = Color::fromRGBA(buf.color[i]);
+						c.r *= shadowScale;
+						c.g *= shadowScale;
+						c.b *= shadowScale;
+						c.a *= shadowScale;
+						buf.color[i] = c.toRGBA();
+					}
+					st &= ~3;
+				}
+				break;
+			}
+		}
+		for (int y = 0; y < tileH; y++)
+			memcpy(&colorBuffer[(tileY + y) * width + tileX], &buf.color[y * TileSize], tileW * sizeof(u32));
+	}
+
+	static int ctz(u32 v)
+	{
+#ifdef _MSC_VER
+		unsigned long idx;
+		_BitScanForward(&idx, v);
+		return (int)idx;
+#else
+		return __builtin_ctz(v);
+#endif
+	}
+
+	void writeRTT(const rend_context& ctx)
+	{
+		const u32 texAddr = ctx.fb_W_SOF1 & VRAM_MASK;
+		u32 linestride = ctx.fb_W_LINESTRIDE * 8;
+		if (linestride == 0)
+			linestride = width * 2;
+		WriteTextureToVRam(width, height, (const u8 *)colorBuffer.data(), (u16 *)&vram[texAddr], ctx.fb_W_CTRL, linestride, ctx.fbClip);
+	}
+
+	void writeFramebufferToVRAM(const rend_context& ctx)
+	{
+		glm::ivec2 scaledSize;
+		Rect finalClip;
+		getWriteFBToVramParams(ctx, scaledSize, finalClip);
+		const u32 texAddr = ctx.fb_W_SOF1 & VRAM_MASK;	// TODO SCALER_CTL.interlace, SCALER_CTL.fieldselect
+		const u32 linestride = ctx.fb_W_LINESTRIDE * 8;
+		if (scaledSize.x == width && scaledSize.y == height)
+		{
+			WriteFramebuffer(width, height, (const u8 *)colorBuffer.data(), texAddr, ctx.fb_W_CTRL, linestride, finalClip);
+			return;
+		}
+		// point sampling
+		std::vector<u32> scaled(scaledSize.x * scaledSize.y);
+		for (int y = 0; y < scaledSize.y; y++)
+		{
+			const int sy = std::min(y * height / scaledSize.y, height - 1);
+			for (int x = 0; x < scaledSize.x; x++)
+				scaled[y * scaledSize.x + x] = colorBuffer[sy * width + std::min(x * width / scaledSize.x, width - 1)];
+		}
+		WriteFramebuffer(scaledSize.x, scaledSize.y, (const u8 *)scaled.data(), texAddr, ctx.fb_W_CTRL, linestride, finalClip);
+	}
+
+	rend_context *rendContext = nullptr;
+	TextureCache texCache;
+	ThreadPool pool { "SoftRenderer" };
+
+	int width = 0;
+	int height = 0;
+	int tilesX = 0;
+	int tilesY = 0;
+	std::vector<u32> colorBuffer;
+	std::vector<Primitive> prims;
+	std::vector<std::vector<u32>> bins;
+
+	std::vector<u32> lastFrame;
+	int lastFrameWidth = 0;
+	int lastFrameHeight = 0;
+
+	// frame state
+	float fogTable0[128];
+	float fogTable1[128];
+	float fogDensity = 0.f;
+	Color fogColRam {};
+	Color fogColVert {};
+	Color fogClampMin {};
+	Color fogClampMax {};
+	u32 alphaRef = 0;
+	float shadowScale = 1.f;
+	u32 clearColor = 0;
+	bool clearBuffer = true;
+	int baseClipX0 = 0;
+	int baseClipY0 = 0;
+	int baseClipX1 = 0;
+	int baseClipY1 = 0;
+};
+
+}	// namespace soft
+
+Renderer *rend_software() {
+	return new soft::SoftRenderer();
+}
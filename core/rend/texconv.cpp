@@ -15,13 +15,14 @@
     along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
 */
 #include "texconv.h"
+#include "texconv_simd.h"
 #include "cfg/option.h"
 #include "hw/pvr/Renderer_if.h"
 #include <algorithm>
 #include <xxhash.h>
 
-const u8 *vq_codebook;
-u32 palette_index;
+thread_local const u8 *vq_codebook;
+thread_local u32 palette_index;
 u32 palette16_ram[1024];
 u32 palette32_ram[1024];
 u32 pal_hash_256[4];
@@ -339,10 +340,130 @@ struct ConvertTwiddlePal8
 	}
 };
 
+#ifdef TEXCONV_SIMD
+// Pixel convertors that have a vectorized implementation
+template<typename PixelConvertor>
+struct TileConvertor {
+	static constexpr bool enabled = false;
+};
+template<typename Unpacker>
+struct TileConvertor<ConvertTwiddle<Unpacker>> {
+	static constexpr bool enabled = texsimd::Convertor<Unpacker>::enabled;
+	using unpacker = Unpacker;
+};
+template<typename Unpacker>
+struct TileConvertor<ConvertPlanar<Unpacker>> {
+	static constexpr bool enabled = texsimd::Convertor<Unpacker>::enabled;
+	using unpacker = Unpacker;
+};
+template<>
+struct TileConvertor<ConvertTwiddlePal4<UnpackerNop<u8>>> {
+	static constexpr bool enabled = true;
+};
+template<>
+struct TileConvertor<ConvertTwiddlePal8<UnpackerNop<u8>>> {
+	static constexpr bool enabled = true;
+};
+
+template<typename Pixel>
+static size_t linePitch(PixelBuffer<Pixel> *pb) {
+	return pb->data(0, 1) - pb->data(0, 0);
+}
+
+// Decode a twiddled or VQ texture by tiles of 4x4 pixels. Width and height must be multiples of 4.
+template<typename PixelConvertor, bool VQ>
+static void texture_TW_simd(PixelBuffer<typename PixelConvertor::unpacked_type>* pb, const u8* p_in, u32 width, u32 height)
+{
+	using Pixel = typename PixelConvertor::unpacked_type;
+	const u32 bcx = bitscanrev(width);
+	const u32 bcy = bitscanrev(height);
+	const size_t pitch = linePitch(pb);
+	const u8 * const codebook = vq_codebook;
+	const u32 *xOffsets = detwiddle[0][bcy];
+
+	for (u32 y = 0; y < height; y += 4)
+	{
+		const u32 yOffset = detwiddle[1][bcx][y];
+		Pixel *dst = pb->data(0, y);
+		for (u32 x = 0; x < width; x += 4, dst += 4)
+		{
+			// index of the first pixel of the tile
+			const u32 offset = xOffsets[x] + yOffset;
+			if constexpr (std::is_same_v<PixelConvertor, ConvertTwiddlePal4<UnpackerNop<u8>>>)
+			{
+				static_assert(!VQ);
+				texsimd::storeRows8(dst, pitch, texsimd::detwiddle4x4x8(texsimd::expand4to8(texsimd::load64(&p_in[offset / 2]))));
+			}
+			else if constexpr (std::is_same_v<PixelConvertor, ConvertTwiddlePal8<UnpackerNop<u8>>>)
+			{
+				static_assert(!VQ);
+				texsimd::storeRows8(dst, pitch, texsimd::detwiddle4x4x8(texsimd::load128(&p_in[offset])));
+			}
+			else
+			{
+				using Unpacker = typename TileConvertor<PixelConvertor>::unpacker;
+				texsimd::Vec lo, hi;
+				if constexpr (VQ)
+				{
+					// Each index selects a 2x2 block, also in twiddled order
+					const u8 *index = &p_in[offset / 4];
+					lo = texsimd::load64x2(&codebook[index[0] * 8], &codebook[index[1] * 8]);
+					hi = texsimd::load64x2(&codebook[index[2] * 8], &codebook[index[3] * 8]);
+				}
+				else
+				{
+					lo = texsimd::load128(&p_in[offset * 2]);
+					hi = texsimd::load128(&p_in[offset * 2 + 16]);
+				}
+				texsimd::Vec rows01, rows23;
+				texsimd::detwiddle4x4(lo, hi, rows01, rows23);
+				texsimd::storeRows<Unpacker>(dst, pitch, rows01);
+				texsimd::storeRows<Unpacker>(dst + pitch * 2, pitch, rows23);
+			}
+		}
+	}
+}
+
+// Decode a planar texture 8 pixels at a time. Width must be a multiple of 4.
+template<typename PixelConvertor>
+static void texture_PL_simd(PixelBuffer<typename PixelConvertor::unpacked_type>* pb, const u8* p_in, u32 width, u32 height)
+{
+	using Unpacker = typename TileConvertor<PixelConvertor>::unpacker;
+	static_assert(sizeof(typename Unpacker::unpacked_type) == 4);
+	const u16 *src = (const u16 *)p_in;
+	for (u32 y = 0; y < height; y++)
+	{
+		u32 *dst = pb->data(0, y);
+		u32 x = 0;
+		for (; x + 8 <= width; x += 8)
+		{
+			texsimd::Vec lo, hi;
+			texsimd::Convertor<Unpacker>::convert(texsimd::load128(&src[x]), lo, hi);
+			texsimd::store128(&dst[x], lo);
+			texsimd::store128(&dst[x + 4], hi);
+		}
+		if (x + 4 <= width)
+		{
+			texsimd::Vec lo, hi;
+			texsimd::Convertor<Unpacker>::convert(texsimd::load64(&src[x]), lo, hi);
+			texsimd::store128(&dst[x], lo);
+		}
+		src += width;
+	}
+}
+#endif
+
 //handler functions
 template<typename PixelConvertor>
 void texture_PL(PixelBuffer<typename PixelConvertor::unpacked_type>* pb, const u8* p_in, u32 width, u32 height)
 {
+#ifdef TEXCONV_SIMD
+	if constexpr (TileConvertor<PixelConvertor>::enabled)
+	{
+		texture_PL_simd<PixelConvertor>(pb, p_in, width, height);
+		return;
+	}
+#endif
 	pb->amove(0,0);
 
 	height /= PixelConvertor::ypp;
@@ -385,6 +506,14 @@ void texture_PLVQ(PixelBuffer<typename PixelConvertor::unpacked_type>* pb, const
 template<typename PixelConvertor>
 void texture_TW(PixelBuffer<typename PixelConvertor::unpacked_type>* pb, const u8* p_in, u32 width, u32 height)
 {
+#ifdef TEXCONV_SIMD
+	if constexpr (TileConvertor<PixelConvertor>::enabled)
+		if (width >= 4 && height >= 4)
+		{
+			texture_TW_simd<PixelConvertor, false>(pb, p_in, width, height);
+			return;
+		}
+#endif
 	pb->amove(0, 0);
 
 	const u32 divider = PixelConvertor::xpp * PixelConvertor::ypp;
@@ -408,6 +537,14 @@ void texture_TW(PixelBuffer<typename PixelConvertor::unpacked_type>* pb, const u
 template<typename PixelConvertor>
 void texture_VQ(PixelBuffer<typename PixelConvertor::unpacked_type>* pb, const u8* p_in, u32 width, u32 height)
 {
+#ifdef TEXCONV_SIMD
+	if constexpr (TileConvertor<PixelConvertor>::enabled)
+		if (width >= 4 && height >= 4)
+		{
+			texture_TW_simd<PixelConvertor, true>(pb, p_in, width, height);
+			return;
+		}
+#endif
 	pb->amove(0, 0);
 
 	const u32 divider = PixelConvertor::xpp * PixelConvertor::ypp;
@@ -0,0 +1,340 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "texconv.h"
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+//
+// Vectorized texture decoding.
+// Twiddled textures are decoded by tiles of 4x4 pixels, which are contiguous in vram when both texture
+// dimensions are at least 4. The twiddled order of a tile is y0 x0 y1 x1 so its 16 pixels can be reordered
+// into rows with a few shuffles. Pixels are then converted 8 at a time.
+// The results are identical to the scalar Unpacker classes in texconv.h.
+//
+// SSE2 and NEON are always available on the supported x64 and arm64 targets so no runtime
+// detection is needed.
+//
+#if HOST_CPU == CPU_X64 || (HOST_CPU == CPU_X86 && defined(__SSE2__))
+#include <emmintrin.h>
+#define TEXCONV_SIMD 1
+#define TEXCONV_SSE2 1
+#elif HOST_CPU == CPU_ARM64 || (HOST_CPU == CPU_ARM && defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define TEXCONV_SIMD 1
+#define TEXCONV_NEON 1
+#endif
+
+#ifdef TEXCONV_SIMD
+
+namespace texsimd
+{
+
+static inline u32 load32(const void *p) {
+	u32 v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static inline void store32(void *p, u32 v) {
+	memcpy(p, &v, 4);
+}
+
+#ifdef TEXCONV_SSE2
+
+using Vec = __m128i;
+
+static inline Vec load128(const void *p) {
+	return _mm_loadu_si128((const __m128i *)p);
+}
+static inline Vec load64(const void *p) {
+	return _mm_loadl_epi64((const __m128i *)p);
+}
+// Load 8 bytes from each address
+static inline Vec load64x2(const void *lo, const void *hi) {
+	return _mm_unpacklo_epi64(load64(lo), load64(hi));
+}
+static inline void store128(void *p, Vec v) {
+	_mm_storeu_si128((__m128i *)p, v);
+}
+static inline void store64Low(void *p, Vec v) {
+	_mm_storel_epi64((__m128i *)p, v);
+}
+static inline void store64High(void *p, Vec v) {
+	_mm_storel_epi64((__m128i *)p, _mm_unpackhi_epi64(v, v));
+}
+static inline u32 lane32(Vec v, int i)
+{
+	switch (i)
+	{
+	case 0: return _mm_cvtsi128_si32(v);
+	case 1: return _mm_cvtsi128_si32(_mm_shuffle_epi32(v, 1));
+	case 2: return _mm_cvtsi128_si32(_mm_shuffle_epi32(v, 2));
+	default: return _mm_cvtsi128_si32(_mm_shuffle_epi32(v, 3));
+	}
+}
+
+// 16-bit lane operations
+template<int N> static inline Vec shl16(Vec v) { return _mm_slli_epi16(v, N); }
+template<int N> static inline Vec shr16(Vec v) { return _mm_srli_epi16(v, N); }
+static inline Vec sar16_15(Vec v) { return _mm_srai_epi16(v, 15); }
+static inline Vec and16(Vec v, u16 mask) { return _mm_and_si128(v, _mm_set1_epi16(mask)); }
+static inline Vec or_(Vec a, Vec b) { return _mm_or_si128(a, b); }
+static inline Vec set16(u16 v) { return _mm_set1_epi16(v); }
+
+// Interleave the 16-bit lanes of two vectors into 32-bit lanes: a0 b0 a1 b1...
+static inline void zip16(Vec a, Vec b, Vec& lo, Vec& hi)
+{
+	lo = _mm_unpacklo_epi16(a, b);
+	hi = _mm_unpackhi_epi16(a, b);
+}
+
+// Reorder a 4x4 tile of 16-bit pixels in twiddled order (pixels 0-7 in lo, 8-15 in hi)
+// into rows 0 and 1 (rows01) and rows 2 and 3 (rows23)
+static inline void detwiddle4x4(Vec lo, Vec hi, Vec& rows01, Vec& rows23)
+{
+	// p0 p2 p1 p3 p4 p6 p5 p7
+	lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+	// p8 p10 p9 p11 p12 p14 p13 p15
+	hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+	rows01 = _mm_unpacklo_epi32(lo, hi);
+	rows23 = _mm_unpackhi_epi32(lo, hi);
+}
+
+// Reorder a 4x4 tile of 8-bit pixels in twiddled order into 4 rows of 4 pixels, one per 32-bit lane
+static inline Vec detwiddle4x4x8(Vec v)
+{
+	const Vec mask = _mm_set1_epi16(0xff);
+	// p0 p2 p4 p6 p8 p10 p12 p14
+	Vec even = _mm_packus_epi16(_mm_and_si128(v, mask), _mm_setzero_si128());
+	// p1 p3 p5 p7 p9 p11 p13 p15
+	Vec odd = _mm_packus_epi16(_mm_srli_epi16(v, 8), _mm_setzero_si128());
+	// row 0, row 2
+	even = _mm_shufflelo_epi16(even, _MM_SHUFFLE(3, 1, 2, 0));
+	// row 1, row 3
+	odd = _mm_shufflelo_epi16(odd, _MM_SHUFFLE(3, 1, 2, 0));
+	return _mm_unpacklo_epi32(even, odd);
+}
+
+// Expand 16 4-bit pixels (low nibble first) into 16 bytes
+static inline Vec expand4to8(Vec v)
+{
+	const Vec mask = _mm_set1_epi8(0xf);
+	return _mm_unpacklo_epi8(_mm_and_si128(v, mask), _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+}
+
+#else // TEXCONV_NEON
+
+using Vec = uint16x8_t;
+
+static inline Vec load128(const void *p) {
+	return vreinterpretq_u16_u8(vld1q_u8((const u8 *)p));
+}
+static inline Vec load64(const void *p) {
+	return vreinterpretq_u16_u8(vcombine_u8(vld1_u8((const u8 *)p), vdup_n_u8(0)));
+}
+static inline Vec load64x2(const void *lo, const void *hi) {
+	return vreinterpretq_u16_u8(vcombine_u8(vld1_u8((const u8 *)lo), vld1_u8((const u8 *)hi)));
+}
+static inline void store128(void *p, Vec v) {
+	vst1q_u8((u8 *)p, vreinterpretq_u8_u16(v));
+}
+static inline void store64Low(void *p, Vec v) {
+	vst1_u8((u8 *)p, vget_low_u8(vreinterpretq_u8_u16(v)));
+}
+static inline void store64High(void *p, Vec v) {
+	vst1_u8((u8 *)p, vget_high_u8(vreinterpretq_u8_u16(v)));
+}
+static inline u32 lane32(Vec v, int i)
+{
+	const uint32x4_t v32 = vreinterpretq_u32_u16(v);
+	switch (i)
+	{
+	case 0: return vgetq_lane_u32(v32, 0);
+	case 1: return vgetq_lane_u32(v32, 1);
+	case 2: return vgetq_lane_u32(v32, 2);
+	default: return vgetq_lane_u32(v32, 3);
+	}
+}
+
+template<int N> static inline Vec shl16(Vec v) { return vshlq_n_u16(v, N); }
+template<int N> static inline Vec shr16(Vec v) { return vshrq_n_u16(v, N); }
+static inline Vec sar16_15(Vec v) { return vreinterpretq_u16_s16(vshrq_n_s16(vreinterpretq_s16_u16(v), 15)); }
+static inline Vec and16(Vec v, u16 mask) { return vandq_u16(v, vdupq_n_u16(mask)); }
+static inline Vec or_(Vec a, Vec b) { return vorrq_u16(a, b); }
+static inline Vec set16(u16 v) { return vdupq_n_u16(v); }
+
+static inline void zip16(Vec a, Vec b, Vec& lo, Vec& hi)
+{
+	const uint16x8x2_t z = vzipq_u16(a, b);
+	lo = z.val[0];
+	hi = z.val[1];
+}
+
+static inline void detwiddle4x4(Vec lo, Vec hi, Vec& rows01, Vec& rows23)
+{
+	// p0 p2 p4 p6 p8 p10 p12 p14 / p1 p3 p5 p7 p9 p11 p13 p15
+	const uint16x8x2_t evenOdd = vuzpq_u16(lo, hi);
+	// rows 0 and 1: p0 p2 p8 p10 p1 p3 p9 p11 / rows 2 and 3: p4 p6 p12 p14 p5 p7 p13 p15
+	const uint32x4x2_t rows = vuzpq_u32(vreinterpretq_u32_u16(evenOdd.val[0]), vreinterpretq_u32_u16(evenOdd.val[1]));
+	rows01 = vreinterpretq_u16_u32(rows.val[0]);
+	rows23 = vreinterpretq_u16_u32(rows.val[1]);
+}
+
+static inline Vec detwiddle4x4x8(Vec v)
+{
+	const uint8x16_t v8 = vreinterpretq_u8_u16(v);
+	// p0 p2 p4 p6 p8 p10 p12 p14 p1 p3 p5 p7 p9 p11 p13 p15
+	const uint8x8x2_t evenOdd = vuzp_u8(vget_low_u8(v8), vget_high_u8(v8));
+	const uint16x8_t eo = vreinterpretq_u16_u8(vcombine_u8(evenOdd.val[0], evenOdd.val[1]));
+	// rows 0 and 1: p0 p2 p8 p10 p1 p3 p9 p11 / rows 2 and 3: p4 p6 p12 p14 p5 p7 p13 p15
+	const uint16x4x2_t rows = vuzp_u16(vget_low_u16(eo), vget_high_u16(eo));
+	// row0 row1 row2 row3
+	return vcombine_u16(rows.val[0], rows.val[1]);
+}
+
+static inline Vec expand4to8(Vec v)
+{
+	const uint8x8_t v8 = vget_low_u8(vreinterpretq_u8_u16(v));
+	const uint8x8x2_t z = vzip_u8(vand_u8(v8, vdup_n_u8(0xf)), vshr_n_u8(v8, 4));
+	return vreinterpretq_u16_u8(vcombine_u8(z.val[0], z.val[1]));
+}
+
+#endif // TEXCONV_NEON
+
+// Pack 8-bit components held in 16-bit lanes into 8 32-bit pixels
+template<typename Packer>
+static inline void pack(Vec r, Vec g, Vec b, Vec a, Vec& lo, Vec& hi)
+{
+	if constexpr (std::is_same_v<Packer, BGRAPacker>)
+		std::swap(r, b);
+	zip16(or_(r, shl16<8>(g)), or_(b, shl16<8>(a)), lo, hi);
+}
+
+//
+// Conversion of 8 16-bit pixels, with the same result as the scalar unpacker
+//
+template<typename Unpacker>
+struct Convertor
+{
+	static constexpr bool enabled = false;
+};
+
+template<>
+struct Convertor<UnpackerNop<u16>>
+{
+	static constexpr bool enabled = true;
+	static Vec convert(Vec v) {
+		return v;
+	}
+};
+
+// ARGB1555 to RGBA5551: rotate left by 1
+template<>
+struct Convertor<Unpacker1555>
+{
+	static constexpr bool enabled = true;
+	static Vec convert(Vec v) {
+		return or_(shl16<1>(v), shr16<15>(v));
+	}
+};
+
+// ARGB4444 to RGBA4444: rotate left by 4
+template<>
+struct Convertor<Unpacker4444>
+{
+	static constexpr bool enabled = true;
+	static Vec convert(Vec v) {
+		return or_(shl16<4>(v), shr16<12>(v));
+	}
+};
+
+template<typename Packer>
+struct Convertor<Unpacker565_32<Packer>>
+{
+	static constexpr bool enabled = true;
+	static void convert(Vec v, Vec& lo, Vec& hi)
+	{
+		const Vec r = or_(shl16<3>(shr16<11>(v)), shr16<13>(v));
+		const Vec g = or_(shl16<2>(and16(shr16<5>(v), 0x3f)), and16(shr16<9>(v), 3));
+		const Vec b = or_(shl16<3>(and16(v, 0x1f)), and16(shr16<2>(v), 7));
+		pack<Packer>(r, g, b, set16(0xff), lo, hi);
+	}
+};
+
+template<typename Packer>
+struct Convertor<Unpacker1555_32<Packer>>
+{
+	static constexpr bool enabled = true;
+	static void convert(Vec v, Vec& lo, Vec& hi)
+	{
+		const Vec r = or_(shl16<3>(and16(shr16<10>(v), 0x1f)), and16(shr16<12>(v), 7));
+		const Vec g = or_(shl16<3>(and16(shr16<5>(v), 0x1f)), and16(shr16<7>(v), 7));
+		const Vec b = or_(shl16<3>(and16(v, 0x1f)), and16(shr16<2>(v), 7));
+		const Vec a = and16(sar16_15(v), 0xff);
+		pack<Packer>(r, g, b, a, lo, hi);
+	}
+};
+
+template<typename Packer>
+struct Convertor<Unpacker4444_32<Packer>>
+{
+	static constexpr bool enabled = true;
+	static void convert(Vec v, Vec& lo, Vec& hi)
+	{
+		const Vec r = and16(shr16<8>(v), 0xf);
+		const Vec g = and16(shr16<4>(v), 0xf);
+		const Vec b = and16(v, 0xf);
+		const Vec a = shr16<12>(v);
+		pack<Packer>(or_(r, shl16<4>(r)), or_(g, shl16<4>(g)), or_(b, shl16<4>(b)), or_(a, shl16<4>(a)), lo, hi);
+	}
+};
+
+// Convert and store two rows of 4 pixels
+template<typename Unpacker>
+static inline void storeRows(typename Unpacker::unpacked_type *dst, size_t pitch, Vec rows)
+{
+	if constexpr (sizeof(typename Unpacker::unpacked_type) == 2)
+	{
+		rows = Convertor<Unpacker>::convert(rows);
+		store64Low(dst, rows);
+		store64High(dst + pitch, rows);
+	}
+	else
+	{
+		Vec row0, row1;
+		Convertor<Unpacker>::convert(rows, row0, row1);
+		store128(dst, row0);
+		store128(dst + pitch, row1);
+	}
+}
+
+// Store 4 rows of 4 8-bit pixels
+static inline void storeRows8(u8 *dst, size_t pitch, Vec rows)
+{
+	store32(dst, lane32(rows, 0));
+	store32(dst + pitch, lane32(rows, 1));
+	store32(dst + pitch * 2, lane32(rows, 2));
+	store32(dst + pitch * 3, lane32(rows, 3));
+}
+
+} // namespace texsimd
+
+#endif // TEXCONV_SIMD
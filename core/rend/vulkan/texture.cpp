@@ -504,4 +504,7 @@ void TextureCache::Cleanup()
 		if (clearTexture(&cache[id]))
 			cache.erase(id);
 	}
+	EvictTextures([this](Texture *texture) {
+		return clearTexture(texture);
+	});
 }
@@ -108,6 +108,9 @@ void BaseVulkanRenderer::Process(TA_context* ctx)
 		GetContext()->setSwapInterval(ctx->rend.swapInterval);
 
 	ta_parse(ctx, true);
+	UploadDecodedTextures([this](BaseTextureCacheData *texture) {
+		static_cast<Texture *>(texture)->SetCommandBuffer(texCommandBuffer);
+	});
 
 	// TODO can't update fog or palette twice in multi render
 	CheckFogTexture();
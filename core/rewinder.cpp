@@ -0,0 +1,218 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "rewinder.h"
+#include "emulator.h"
+#include "serialize.h"
+#include "cfg/option.h"
+#include "hw/mem/mem_watch.h"
+#include "hw/mem/rewind_buffer.h"
+#include "hw/arm7/arm7_rec.h"
+#include "hw/pvr/Renderer_if.h"
+#include "hw/sh4/modules/mmu.h"
+#include "util/worker_thread.h"
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+namespace rewinder
+{
+
+// Only accessed by the worker thread, which compresses the frames in the background
+static checkpoint::RewindBuffer buffer;
+static WorkerThread thread { "Rewind" };
+// Frames captured but not compressed yet
+static std::atomic<int> pendingFrames;
+// Captures are skipped when the worker can't keep up.
+// The pages written are then part of the next frame.
+constexpr int MaxPendingFrames = 4;
+
+static bool _endOfFrame;
+static std::atomic<bool> rewinding;
+
+struct Frame
+{
+	std::array<memwatch::PageMap, checkpoint::RegionCount> pages;
+	std::vector<u8> state;
+};
+
+bool active()
+{
+	return config::Rewind && !config::GGPOEnable && !settings.network.online
+			&& !settings.naomi.multiboard && !settings.raHardcoreMode;
+}
+
+void endOfFrame()
+{
+	if (active())
+	{
+		_endOfFrame = true;
+		emu.getSh4Executor()->Stop();
+	}
+}
+
+void setRewinding(bool enabled)
+{
+	enabled = enabled && active();
+	if (rewinding == enabled)
+		return;
+	rewinding = enabled;
+	settings.aica.muteAudio = enabled;
+}
+
+// Memory regions aren't included in rollback mode
+static std::vector<u8> serializeState()
+{
+	Serializer ser(nullptr, std::numeric_limits<size_t>::max(), true);
+	dc_serialize(ser);
+	std::vector<u8> state(ser.size());
+	ser = Serializer(state.data(), state.size(), true);
+	dc_serialize(ser);
+
+	return state;
+}
+
+static void getPages(std::array<memwatch::PageMap, checkpoint::RegionCount>& pages)
+{
+	memwatch::ramWatcher.getPages(pages[0]);
+	memwatch::vramWatcher.getPages(pages[1]);
+	memwatch::aramWatcher.getPages(pages[2]);
+	memwatch::elanWatcher.getPages(pages[3]);
+}
+
+// Start a new history from the current frame
+static void start()
+{
+	auto state = std::make_shared<std::vector<u8>>(serializeState());
+	const size_t capacity = config::RewindBufferSize * 1_MB;
+	thread.run([state, capacity]() {
+		buffer.setCapacity(capacity);
+		buffer.reset(std::move(*state));
+	});
+	memwatch::reset();
+	memwatch::tracking = memwatch::Tracking::Rewind;
+	memwatch::protect();
+}
+
+static void capture()
+{
+	if (pendingFrames >= MaxPendingFrames)
+		return;
+	// Protect the pages written during this frame again
+	memwatch::protect();
+	auto frame = std::make_shared<Frame>();
+	getPages(frame->pages);
+	frame->state = serializeState();
+	const size_t capacity = config::RewindBufferSize * 1_MB;
+	pendingFrames++;
+	thread.run([frame, capacity]() {
+		checkpoint::UndoPages undo;
+		for (int i = 0; i < checkpoint::RegionCount; i++)
+			for (const auto& pair : frame->pages[i])
+				undo[i].push_back({ pair.first, &pair.second.data[0] });
+		try {
+			buffer.setCapacity(capacity);
+			buffer.push(undo, std::move(frame->state));
+		} catch (const std::bad_alloc&) {
+			WARN_LOG(SAVESTATE, "Rewind: out of memory");
+			buffer.clear();
+		}
+		pendingFrames--;
+	});
+}
+
+// Restore the previous frame like a net rollback. Loading a full savestate every frame would reset
+// the dynarec caches and custom textures.
+static void back()
+{
+	rend_start_rollback();
+	memwatch::unprotect();
+	std::array<memwatch::PageMap, checkpoint::RegionCount> pages;
+	getPages(pages);
+	const checkpoint::Regions regions = memwatch::regions();
+	checkpoint::DirtyPages restored;
+	std::vector<u8> state = thread.runFuture([&pages, &regions, &restored]() {
+		if (buffer.state().empty())
+			// The history was lost
+			return std::vector<u8>();
+		// Undo the writes since the last captured frame, then go back one more frame.
+		// The oldest frame is reloaded once the history is exhausted.
+		for (int i = 0; i < checkpoint::RegionCount; i++)
+			for (const auto& pair : pages[i])
+			{
+				memcpy(regions[i].data + pair.first, &pair.second.data[0], PAGE_SIZE);
+				restored[i].push_back(pair.first);
+			}
+		buffer.pop(regions, &restored);
+		return buffer.state();
+	}).get();
+	if (state.empty())
+	{
+		rend_allow_rollback();
+		start();
+		return;
+	}
+	mmu_flush_table();
+	Deserializer deser(state.data(), state.size(), true);
+	dc_deserialize(deser);
+	mmu_set_state();
+	// Memory isn't write-protected while restoring so the code of the restored pages must be discarded
+	for (u32 offset : restored[0])
+		bm_RamWriteAccess(offset);
+#if FEAT_AREC == DYNAREC_JIT
+	if (!restored[2].empty())
+		aica::arm::recompiler::flush();
+#endif
+	rend_allow_rollback();
+	memwatch::reset();
+	memwatch::tracking = memwatch::Tracking::Rewind;
+	memwatch::protect();
+}
+
+bool nextFrame()
+{
+	if (!_endOfFrame)
+		return false;
+	_endOfFrame = false;
+	try {
+		if (memwatch::tracking != memwatch::Tracking::Rewind)
+			// First frame or written pages haven't been tracked since the last one (state loaded, reset)
+			start();
+		else if (rewinding)
+			back();
+		else
+			capture();
+	} catch (const std::bad_alloc&) {
+		WARN_LOG(SAVESTATE, "Rewind: out of memory");
+		memwatch::reset();
+	}
+	return true;
+}
+
+void term()
+{
+	thread.runFuture([]() {
+		buffer.clear();
+		buffer.setCapacity(0);
+	}).get();
+	setRewinding(false);
+	_endOfFrame = false;
+}
+
+}
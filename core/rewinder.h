@@ -0,0 +1,40 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "types.h"
+
+//
+// Real-time rewind. A compressed delta is captured at the end of each frame, and
+// frames are undone one by one while the rewind button is held.
+//
+namespace rewinder
+{
+
+// Rewind is enabled and allowed for the current game
+bool active();
+// Called when a frame is rendered. Stops the sh4 so that the frame can be captured.
+void endOfFrame();
+// Capture the frame that just ended, or go back one frame when rewinding.
+// The emulator must be stopped. Returns false if the end of a frame hasn't been reached.
+bool nextFrame();
+void setRewinding(bool rewinding);
+// Discard the rewind history
+void term();
+
+}
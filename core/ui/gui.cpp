@@ -44,6 +44,8 @@
 #include <stb_image_write.h>
 #include "hw/pvr/Renderer_if.h"
 #include "rend/CustomTexture.h"
+#include "rend/TexCache.h"
+#include "audio/audiostream.h"
 #include "hw/mem/addrspace.h"
 #include "hw/maple/maple_if.h"
 #if defined(USE_SDL)
@@ -507,7 +509,7 @@ static void getScreenshot(std::vector<u8>& data, int width = 0)
 
 static void savestate()
 {
-	// TODO save state async: png compression, savestate file compression/write
+	// TODO save state async: png compression
 	std::vector<u8> pngData;
 	getScreenshot(pngData, 640);
 	dc_savestate(config::SavestateSlot, pngData.empty() ? nullptr : &pngData[0], pngData.size());
@@ -1264,7 +1266,7 @@ static void gui_display_loadscreen()
 			
 			const bool customTexPreloading = custom_texture.isPreloading();
 
-			if (gameLoader.ready() && !customTexPreloading)
+			if (gameLoader.ready() && !custom_texture.isPreparing())
 			{
 				if (NetworkHandshake::instance != nullptr)
 				{
@@ -1429,8 +1431,10 @@ static std::string getFPSNotification()
 			lastFrameCount = MainFrameCount;
 		}
 		if (fps >= 0.f && fps < 9999.f) {
-			char text[32];
-			snprintf(text, sizeof(text), "F:%4.1f%s", fps, settings.input.fastForwardMode ? " >>" : "");
+			char text[64];
+			TextureCacheStats texStats = getTextureCacheStats();
+			snprintf(text, sizeof(text), "F:%4.1f T:%dMB %d%%%s", fps, (int)(texStats.bytes / 1_MB), (int)texStats.hitRate,
+					settings.input.fastForwardMode ? " >>" : "");
 
 			return std::string(text);
 		}
@@ -1510,6 +1514,21 @@ void gui_display_profiler()
 			fc_profiler::drawGUI(profileThread->cachedResultTree);
 			ImGui::Unindent();
 		}
+		RenderQueueStats stats = getRenderQueueStats();
+		ImGui::Text("Render queue: %d/%d frames, wait %.3f ms", stats.depth, stats.maxDepth, stats.waitTime);
+		VramLockStats vramStats = getVramLockStats();
+		ImGui::Text("VRAM write faults: %d/s, %.2f us, %d textures invalidated/s", vramStats.faultsPerSecond,
+				vramStats.handlerLatency, vramStats.invalidationsPerSecond);
+		TextureCacheStats cacheStats = getTextureCacheStats();
+		ImGui::Text("Texture cache: %d textures, %.1f MB, hit rate %.1f%%, %d evictions/s", cacheStats.entries,
+				cacheStats.bytes / (float)1_MB, cacheStats.hitRate, cacheStats.evictionsPerSecond);
+		TextureDecodeStats decodeStats = getTextureDecodeStats();
+		ImGui::Text("Texture decoding: %d textures, %.3f ms, wait %.3f ms", decodeStats.textures,
+				decodeStats.decodeTime, decodeStats.waitTime);
+		AudioStats audioStats = getAudioStats();
+		if (audioStats.latency >= 0.f)
+			ImGui::Text("Audio: latency %.1f ms, rate %+.3f%%, %d underruns/s", audioStats.latency,
+					audioStats.rateAdjust, audioStats.underrunsPerSecond);
 	}
 
 	for (const fc_profiler::ProfileThread* profileThread : fc_profiler::ProfileThread::s_allThreads)
@@ -24,6 +24,8 @@
 #include "hw/maple/maple_if.h"
 #include "imgui_stdlib.h"
 #include "input/dreampotato.h"
+#include "oslib/oslib.h"
+#include "profiler/telemetry.h"
 
 #ifdef GDB_SERVER
 #include "hw/mem/addrspace.h"
@@ -45,6 +47,10 @@ static void gui_settings_advanced()
 		OptionSlider(T("SH4 Clock"), config::Sh4Clock, 100, 300,
 				T("Over/Underclock the main SH4 CPU. Default is 200 MHz. Other values may crash, freeze or trigger unexpected nuclear reactions."),
 				"%d MHz");
+		OptionCheckbox(T("Persistent Translation Cache"), config::DynarecPersistentCache,
+				T("Save translated SH4 code to disk to speed up the next start of the game"));
+		OptionCheckbox(T("Background Compilation"), config::DynarecBackgroundCompile,
+				T("Compile SH4 code in a separate thread and interpret it in the meantime. Reduces stuttering when new code is run"));
     }
 #ifdef GDB_SERVER
 	ImGui::Spacing();
@@ -96,6 +102,12 @@ static void gui_settings_advanced()
     	OptionCheckbox(T("HLE BIOS"), config::UseReios, T("Force high-level BIOS emulation"));
         OptionCheckbox(T("Multi-threaded emulation"), config::ThreadedRendering,
         		T("Run the emulated CPU and GPU on different threads"));
+        {
+        	DisabledScope scope(!config::ThreadedRendering);
+        	OptionSlider(T("Render Queue"), config::RenderQueueLatency, 1, 4,
+        			T("Maximum number of frames waiting to be rendered before the emulated CPU is paused. "
+        			  "Higher values absorb GPU hiccups but may increase input latency"), "%d frames");
+        }
 #if !defined(__ANDROID) && !defined(GDB_SERVER)
         OptionCheckbox(T("Serial Console"), config::SerialConsole,
         		T("Dump the Dreamcast serial console to stdout"));
@@ -121,6 +133,21 @@ static void gui_settings_advanced()
 			config::saveBool("log", "LogToFile", logToFile);
         ImGui::SameLine();
         ShowHelpMarker(T("Log debug information to flycast.log"));
+        OptionCheckbox(T("Record Telemetry"), config::Telemetry,
+        		T("Record the time spent in the main emulator functions during the last seconds of emulation"));
+		{
+			DisabledScope scope(!config::Telemetry);
+			if (ImGui::Button(T("Export Trace")))
+			{
+				const std::string path = get_writable_data_path("flycast-trace.json");
+				if (telemetry::exportChromeTrace(path))
+					os_notify(T("Trace saved"), 2000, path.c_str());
+				else
+					os_notify(T("Trace export failed"), 2000);
+			}
+			ImGui::SameLine();
+			ShowHelpMarker(T("Save the recorded telemetry as a Chrome trace file that can be opened with chrome://tracing or ui.perfetto.dev"));
+		}
 #ifdef SENTRY_UPLOAD
         OptionCheckbox(T("Automatically Report Crashes"), config::UploadCrashLogs,
         		T("Automatically upload crash reports to sentry.io to help in troubleshooting. No personal information is included."));
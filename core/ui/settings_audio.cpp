@@ -24,6 +24,10 @@ void gui_settings_audio()
 {
 	OptionCheckbox(T("Enable DSP"), config::DSPEnabled,
 			T("Enable the Dreamcast Digital Sound Processor. Only recommended on fast platforms"));
+	OptionCheckbox(T("Threaded Audio"), config::ThreadedAudio,
+			T("Run the sound CPU and DSP on a separate thread. Faster on multi-core platforms but less accurate. Disabled for netplay"));
+	OptionCheckbox(T("Dynamic Rate Control"), config::DynamicRateControl,
+			T("Slightly adjust the audio pitch to keep the audio latency constant and avoid crackling when using vsync. Only supported by some audio drivers"));
     OptionCheckbox(T("Enable VMU Sounds"), config::VmuSound, T("Play VMU beeps when enabled."));
 
 	if (OptionSlider(T("Volume Level"), config::AudioVolume, 0, 100, T("Adjust the emulator's audio level"), "%d%%"))
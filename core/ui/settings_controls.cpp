@@ -223,6 +223,7 @@ static constexpr Mapping dcButtons_src[] = {
 	{ EMU_BTN_ESCAPE, Tnop("Exit") },
 	{ EMU_BTN_PAUSE, Tnop("Pause") },
 	{ EMU_BTN_FFORWARD, Tnop("Fast-forward") },
+	{ EMU_BTN_REWIND, Tnop("Rewind") },
 	{ EMU_BTN_LOADSTATE, Tnop("Load State") },
 	{ EMU_BTN_SAVESTATE, Tnop("Save State") },
 	{ EMU_BTN_LOADSTATE_RAM, Tnop("Load State in RAM") },
@@ -283,6 +284,7 @@ static constexpr Mapping arcadeButtons_src[] = {
 	{ EMU_BTN_ESCAPE, Tnop("Exit") },
 	{ EMU_BTN_PAUSE, Tnop("Pause") },
 	{ EMU_BTN_FFORWARD, Tnop("Fast-forward") },
+	{ EMU_BTN_REWIND, Tnop("Rewind") },
 	{ EMU_BTN_LOADSTATE, Tnop("Load State") },
 	{ EMU_BTN_SAVESTATE, Tnop("Save State") },
 	{ EMU_BTN_LOADSTATE_RAM, Tnop("Load State in RAM") },
@@ -401,6 +401,19 @@ void gui_settings_general()
 	ImGui::SameLine();
 	OptionCheckbox(T("Save"), config::AutoSaveState,
 			T("Save the state of the game when stopping"));
+#ifdef HAVE_ZSTD
+	OptionCheckbox(T("Zstandard Savestates"), config::SavestateZstd,
+			T("Compress savestates with Zstandard. Faster but the savestates can't be loaded by older versions or other emulators."));
+#endif
+	OptionCheckbox(T("Incremental Quick Saves"), config::IncrementalSavestates,
+			T("In-memory quick saves only store the memory pages modified since the previous one"));
+	OptionCheckbox(T("Rewind"), config::Rewind,
+			T("Keep a history of the last frames to go back in time with the Rewind button. Not available online."));
+	{
+		DisabledScope _{!config::Rewind};
+		OptionSlider(T("Rewind Buffer Size"), config::RewindBufferSize, 16, 1024,
+				T("Maximum memory used to store the rewind history"), "%d MB");
+	}
 	OptionCheckbox(T("Naomi Free Play"), config::ForceFreePlay, T("Configure Naomi games in Free Play mode."));
 #if USE_DISCORD
 	OptionCheckbox(T("Discord Presence"), config::DiscordPresence, T("Show which game you are playing on Discord"));
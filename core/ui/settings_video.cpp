@@ -319,6 +319,19 @@ void gui_settings_video()
 
     	OptionArrowButtons(T("Frame Skipping"), config::SkipFrame, 0, 6,
     			T("Number of frames to skip between two actually rendered frames"));
+
+    	ImGui::Text("%s", T("Texture Decoding:"));
+    	ImGui::Columns(3, "texdecode", false);
+    	OptionRadioButton(T("Render Thread"), config::TextureDecodeMode, 0, T("Decode textures on the render thread"));
+    	ImGui::NextColumn();
+    	OptionRadioButton(T("Threaded"), config::TextureDecodeMode, 1, T("Decode textures on worker threads. The frame is rendered once all its textures are decoded"));
+    	ImGui::NextColumn();
+    	OptionRadioButton(T("Low Latency"), config::TextureDecodeMode, 2,
+    			T("Decode textures on worker threads. The previous version of an updated texture is used for one frame if it isn't decoded in time"));
+    	ImGui::Columns(1, nullptr, false);
+    	OptionSlider(T("Texture Cache Size"), config::TextureCacheSize, 0, 2048,
+    			T("Memory budget for cached textures. Textures that haven't been used recently are deleted when it's exceeded. 0 means no limit"), "%d MB");
+
     	OptionCheckbox(T("Shadows"), config::ModifierVolumes,
     			T("Enable modifier volumes, usually used for shadows"));
     	OptionCheckbox(T("Fog"), config::Fog, T("Enable fog effects"));
@@ -0,0 +1,155 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "tsqueue.h"
+#include "oslib/oslib.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <variant>
+#include <vector>
+
+//
+// Fixed-size pool of worker threads sharing a single task queue.
+// Threads are started on first use.
+//
+class ThreadPool
+{
+public:
+	using Function = std::function<void()>;
+
+	// threadCount == 0: one thread per available core minus one (the caller usually participates)
+	ThreadPool(const char *name, unsigned threadCount = 0) : name(name)
+	{
+		if (threadCount == 0)
+			threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+		this->threadCount = threadCount;
+	}
+	~ThreadPool() {
+		stop();
+	}
+
+	unsigned size() const {
+		return threadCount;
+	}
+
+	void stop()
+	{
+		std::lock_guard<std::mutex> _(mutex);
+		if (threads.empty())
+			return;
+		for (size_t i = 0; i < threads.size(); i++)
+			queue.push(Exit());
+		for (auto& thread : threads)
+			thread.join();
+		threads.clear();
+	}
+
+	void run(Function&& task) {
+		start();
+		queue.push(std::move(task));
+	}
+
+	template<class F, class... Args>
+	auto runFuture(F&& f, Args&&... args) -> std::future<typename std::result_of<F(Args...)>::type>
+	{
+		using return_type = typename std::result_of<F(Args...)>::type;
+		auto task = std::make_shared<std::packaged_task<return_type()>>(
+				std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+
+		run([task]() {
+			(*task)();
+		});
+		return task->get_future();
+	}
+
+	// Call func(i) for each i in [0, count) using the pool threads and the calling thread.
+	// Returns once all calls have completed.
+	template<typename Func>
+	void parallelFor(size_t count, const Func& func)
+	{
+		if (count == 0)
+			return;
+		const size_t helpers = std::min<size_t>(threadCount, count - 1);
+		if (helpers == 0)
+		{
+			for (size_t i = 0; i < count; i++)
+				func(i);
+			return;
+		}
+		struct Job
+		{
+			std::atomic<size_t> next { 0 };
+			size_t pending;
+			std::mutex mutex;
+			std::condition_variable done;
+		};
+		auto job = std::make_shared<Job>();
+		job->pending = helpers;
+		const auto& work = [job, count, &func]() {
+			for (size_t i = job->next++; i < count; i = job->next++)
+				func(i);
+		};
+		for (size_t i = 0; i < helpers; i++)
+			run([job, work]() {
+				work();
+				std::lock_guard<std::mutex> _(job->mutex);
+				if (--job->pending == 0)
+					job->done.notify_one();
+			});
+		work();
+		std::unique_lock<std::mutex> lock(job->mutex);
+		job->done.wait(lock, [&job]() { return job->pending == 0; });
+	}
+
+private:
+	void start()
+	{
+		std::lock_guard<std::mutex> _(mutex);
+		if (!threads.empty())
+			return;
+		queue.clear();
+		for (unsigned i = 0; i < threadCount; i++)
+			threads.emplace_back([this]()
+			{
+				ThreadName _(name);
+				while (true)
+				{
+					Task t = queue.pop();
+					if (std::get_if<Exit>(&t) != nullptr)
+						break;
+					Function& func = std::get<Function>(t);
+					func();
+				}
+			});
+	}
+
+	const char * const name;
+	unsigned threadCount;
+	using Exit = std::monostate;
+	using Task = std::variant<Exit, Function>;
+	TsQueue<Task> queue;
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+};
@@ -73,6 +73,9 @@ void initRenderApi(void *window, void *display)
 	}
 #endif
 #ifdef USE_OPENGL
+	if (config::RendererType == RenderType::Software)
+		// Its output can only be read back, it can't be displayed
+		WARN_LOG(RENDERER, "The software renderer is only available in headless builds and the benchmark. Using OpenGL");
 	if (!isOpenGL(config::RendererType))
 		config::RendererType = RenderType::OpenGL;
 	try {
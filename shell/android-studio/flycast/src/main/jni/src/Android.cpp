@@ -264,6 +264,7 @@ extern "C" JNIEXPORT void JNICALL Java_com_flycast_emulator_emu_JNIdc_setupMic(J
 static void *savestateThreadFunc(void *)
 {
 	dc_savestate(config::SavestateSlot);
+	dc_waitSavestates();
 	return nullptr;
 }
 
@@ -1276,9 +1276,13 @@ void retro_run()
 		msg.frames = 1;
 		environ_cb(RETRO_ENVIRONMENT_SET_MESSAGE, &msg);
 
-		video_cb(NULL, 0, 0, 0);
-		poll_cb();
-		return;
+		// The game can start while textures are preloaded in the background
+		if (custom_texture.isPreparing())
+		{
+			video_cb(NULL, 0, 0, 0);
+			poll_cb();
+			return;
+		}
 	}
 
 #if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
@@ -24,6 +24,8 @@ namespace config {
 // Dynarec
 
 Option<bool> DynarecEnabled("", true);
+Option<bool> DynarecPersistentCache("");
+Option<bool> DynarecBackgroundCompile("");
 IntOption Sh4Clock(CORE_OPTION_NAME "_sh4clock", 200);
 
 // General
@@ -35,11 +37,15 @@ Option<int> Language(CORE_OPTION_NAME "_language", 1);		// English
 Option<bool> AutoLoadState("");
 Option<bool> AutoSaveState("");
 Option<int, false> SavestateSlot("");
+Option<bool, false> Rewind("");
+Option<int, false> RewindBufferSize("");
 Option<bool> ForceFreePlay(CORE_OPTION_NAME "_force_freeplay", true);
 
 // Sound
 
 Option<bool> DSPEnabled(CORE_OPTION_NAME "_enable_dsp", false);
+Option<bool> ThreadedAudio("", false);
+Option<bool> DynamicRateControl("", false);
 #if HOST_CPU == CPU_ARM
 Option<int> AudioBufferSize("", 5644);	// 128 ms
 #else
@@ -89,6 +95,9 @@ Option<bool> IntegerScale("");
 Option<bool> LinearInterpolation("", true);
 Option<bool> VSync("", true);
 Option<bool> ThreadedRendering(CORE_OPTION_NAME "_threaded_rendering", true);
+Option<int> RenderQueueLatency("", 1);
+Option<int> TextureDecodeMode("", 0);
+Option<int> TextureCacheSize("", 512);
 Option<int> AnisotropicFiltering(CORE_OPTION_NAME "_anisotropic_filtering");
 Option<int> TextureFiltering(CORE_OPTION_NAME "_texture_filtering");
 Option<bool> PowerVR2Filter(CORE_OPTION_NAME "_pvr2_filtering");
@@ -110,6 +119,7 @@ Option<bool> RamMod32MB(CORE_OPTION_NAME "_dc_32mb_mod", false);
 
 //Option<std::vector<std::string>, false> ContentPath("");
 //Option<bool, false> HideLegacyNaomiRoms("", true);
+Option<bool, false> Telemetry("");
 
 // Network
 
@@ -0,0 +1,75 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "archive/rzip.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+class RZipTest : public ::testing::Test
+{
+protected:
+	void SetUp() override {
+		path = ::testing::TempDir() + "rziptest.bin";
+	}
+
+	void TearDown() override {
+		std::remove(path.c_str());
+	}
+
+	// Compressible data spanning several chunks
+	static std::vector<u8> makeData(size_t size)
+	{
+		std::vector<u8> data(size);
+		std::mt19937 rng(42);
+		for (size_t i = 0; i < size; i++)
+			data[i] = (i / 64) % 3 == 0 ? (u8)rng() : (u8)i;
+		return data;
+	}
+
+	void roundTrip(const std::vector<u8>& data, RZipFile::Codec codec)
+	{
+		RZipFile zipFile;
+		ASSERT_TRUE(zipFile.Open(new hostfs::StdFile(std::fopen(path.c_str(), "wb")), true, codec));
+		ASSERT_EQ(data.size(), zipFile.Write(data.data(), data.size()));
+		zipFile.Close();
+
+		hostfs::File *file = new hostfs::StdFile(std::fopen(path.c_str(), "rb"));
+		ASSERT_TRUE(zipFile.Open(file, false));
+		ASSERT_EQ(data.size(), zipFile.Size());
+		std::vector<u8> out(data.size());
+		ASSERT_EQ(data.size(), zipFile.Read(out.data(), out.size()));
+		zipFile.Close();
+		ASSERT_EQ(data, out);
+	}
+
+	std::string path;
+};
+
+TEST_F(RZipTest, zlib)
+{
+	roundTrip(makeData(10_MB + 1234), RZipFile::Codec::Zlib);
+	roundTrip(makeData(1_MB), RZipFile::Codec::Zlib);
+	roundTrip(makeData(100), RZipFile::Codec::Zlib);
+}
+
+TEST_F(RZipTest, zstd)
+{
+	roundTrip(makeData(10_MB + 1234), RZipFile::Codec::Zstd);
+	roundTrip(makeData(100), RZipFile::Codec::Zstd);
+}
+
+TEST_F(RZipTest, header)
+{
+	// Zlib files use the standard RZIP header
+	std::vector<u8> data = makeData(1000);
+	RZipFile zipFile;
+	ASSERT_TRUE(zipFile.Open(new hostfs::StdFile(std::fopen(path.c_str(), "wb")), true));
+	zipFile.Write(data.data(), data.size());
+	zipFile.Close();
+	FILE *f = std::fopen(path.c_str(), "rb");
+	char header[8];
+	ASSERT_EQ(1u, std::fread(header, sizeof(header), 1, f));
+	std::fclose(f);
+	ASSERT_EQ(0, memcmp(header, "#RZIPv\1#", sizeof(header)));
+}
@@ -0,0 +1,66 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "audio/audiostream.h"
+#include "cfg/option.h"
+
+#include <cmath>
+
+// Backend whose buffer is always empty, so that rate control produces more frames
+class StarvedBackend : public AudioBackend
+{
+public:
+	StarvedBackend() : AudioBackend("test_starved", "Test starved backend") {}
+
+	bool init() override {
+		return true;
+	}
+	u32 push(const void *data, u32 frames, bool wait) override
+	{
+		EXPECT_EQ(SAMPLE_COUNT, frames);
+		pushedFrames += frames;
+		return frames;
+	}
+	bool getBufferStatus(u32& queued, u32& capacity) override
+	{
+		queued = 0;
+		capacity = 4096;
+		return true;
+	}
+
+	u64 pushedFrames = 0;
+};
+static StarvedBackend starvedBackend;
+
+class AudioStreamTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		config::AudioBackend.override("test_starved");
+		config::DynamicRateControl.override(true);
+		InitAudio();
+		starvedBackend.pushedFrames = 0;
+	}
+
+	void TearDown() override
+	{
+		TermAudio();
+		config::AudioBackend.reset();
+		config::DynamicRateControl.reset();
+	}
+};
+
+TEST_F(AudioStreamTest, rateUp)
+{
+	constexpr u64 Frames = 44100 * 60;
+	for (u64 i = 0; i < Frames; i++)
+	{
+		s16 v = (s16)std::lround(8000.0 * std::sin(2 * M_PI * 440.0 * i / 44100.0));
+		WriteSample(v, v);
+	}
+	// The ratio quickly reaches its maximum and all the input is resampled and pushed,
+	// so the frames held back by the resampler and the audio stream don't grow
+	const double expected = Frames * 1.005;
+	ASSERT_GT((double)starvedBackend.pushedFrames, expected - SAMPLE_COUNT * 4);
+	ASSERT_LE((double)starvedBackend.pushedFrames, expected);
+}
@@ -0,0 +1,119 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "audio/resampler.h"
+
+#include <cmath>
+#include <vector>
+
+class ResamplerTest : public ::testing::Test
+{
+protected:
+	// Stereo sine wave, right channel inverted
+	static std::vector<s16> sine(u32 frames, double freq, double amplitude)
+	{
+		std::vector<s16> data(frames * 2);
+		for (u32 i = 0; i < frames; i++)
+		{
+			data[i * 2] = (s16)std::lround(amplitude * std::sin(2 * M_PI * freq * i / 44100.0));
+			data[i * 2 + 1] = -data[i * 2];
+		}
+		return data;
+	}
+
+	// Resample in chunks of 512 frames
+	static std::vector<s16> resample(Resampler& resampler, const std::vector<s16>& in)
+	{
+		std::vector<s16> out;
+		constexpr u32 Chunk = 512;
+		s16 buffer[Chunk * 2 * 2];
+		for (size_t i = 0; i < in.size() / 2; i += Chunk)
+		{
+			u32 frames = std::min<u32>(Chunk, in.size() / 2 - i);
+			u32 n = resampler.process(&in[i * 2], frames, buffer, Chunk * 2);
+			out.insert(out.end(), buffer, buffer + n * 2);
+		}
+		return out;
+	}
+
+	static double rms(const std::vector<s16>& data, size_t start)
+	{
+		double sum = 0;
+		for (size_t i = start * 2; i < data.size(); i += 2)
+			sum += (double)data[i] * data[i];
+		return std::sqrt(sum / (data.size() / 2 - start));
+	}
+};
+
+TEST_F(ResamplerTest, identity)
+{
+	Resampler resampler;
+	std::vector<s16> in(44100 * 2);
+	for (size_t i = 0; i < in.size(); i++)
+		in[i] = (s16)(i * 7919);
+	std::vector<s16> out = resample(resampler, in);
+	// Only the last input frames are held back
+	ASSERT_EQ(in.size() - Resampler::Taps, out.size());
+	for (size_t i = 0; i < out.size(); i++)
+		ASSERT_EQ(in[i], out[i]) << "sample " << i;
+}
+
+TEST_F(ResamplerTest, ratio)
+{
+	constexpr u32 Frames = 44100 * 4;
+	const std::vector<s16> in = sine(Frames, 1000.0, 16000.0);
+	for (double ratio : { 0.995, 0.999, 1.001, 1.005, 48000.0 / 44100.0 })
+	{
+		Resampler resampler;
+		resampler.setRatio(ratio);
+		std::vector<s16> out = resample(resampler, in);
+		const double expected = (Frames - Resampler::Taps / 2) * ratio;
+		ASSERT_NEAR(expected, out.size() / 2, 2.0) << "ratio " << ratio;
+		// Amplitude is preserved
+		ASSERT_NEAR(rms(in, 0), rms(out, Resampler::Taps), 16000.0 * 0.01) << "ratio " << ratio;
+		// Stereo channels are kept separate
+		for (size_t i = 0; i < out.size(); i += 2)
+			ASSERT_NEAR(out[i], -out[i + 1], 1) << "ratio " << ratio;
+	}
+}
+
+TEST_F(ResamplerTest, quality)
+{
+	// Compare against the ideal resampled sine wave
+	constexpr u32 Frames = 44100;
+	constexpr double Freq = 5000.0;
+	constexpr double Amplitude = 16000.0;
+	constexpr double Ratio = 1.003;
+	const std::vector<s16> in = sine(Frames, Freq, Amplitude);
+	Resampler resampler;
+	resampler.setRatio(Ratio);
+	std::vector<s16> out = resample(resampler, in);
+	double maxError = 0;
+	// Skip the start since the input is preceded by silence
+	for (size_t i = Resampler::Taps; i < out.size() / 2; i++)
+	{
+		double expected = Amplitude * std::sin(2 * M_PI * Freq * (i / Ratio) / 44100.0);
+		maxError = std::max(maxError, std::abs(out[i * 2] - expected));
+	}
+	// Better than 60 dB
+	ASSERT_LT(maxError, Amplitude / 1000.0);
+}
+
+TEST_F(ResamplerTest, rateChange)
+{
+	// Changing the ratio doesn't cause discontinuities
+	constexpr u32 Frames = 44100;
+	const std::vector<s16> in = sine(Frames, 440.0, 16000.0);
+	Resampler resampler;
+	std::vector<s16> out;
+	s16 buffer[1024 * 2];
+	for (u32 i = 0; i < Frames; i += 512)
+	{
+		resampler.setRatio(i % 1024 == 0 ? 1.005 : 0.995);
+		u32 n = resampler.process(&in[i * 2], std::min<u32>(512, Frames - i), buffer, 1024);
+		out.insert(out.end(), buffer, buffer + n * 2);
+	}
+	// Max difference between consecutive samples of a 440 Hz sine wave
+	const double maxDelta = 16000.0 * 2 * M_PI * 440.0 / 44100.0 * 1.01 + 1;
+	for (size_t i = Resampler::Taps * 2; i + 2 < out.size(); i += 2)
+		ASSERT_LE(std::abs(out[i + 2] - out[i]), maxDelta) << "sample " << i / 2;
+}
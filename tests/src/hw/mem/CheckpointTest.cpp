@@ -0,0 +1,122 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/mem/checkpoint.h"
+
+#include <random>
+#include <vector>
+
+using namespace checkpoint;
+
+class CheckpointTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		const u32 sizes[RegionCount] { 64 * PAGE_SIZE, 32 * PAGE_SIZE, 16 * PAGE_SIZE, 0 };
+		for (int i = 0; i < RegionCount; i++)
+		{
+			memory[i].resize(sizes[i]);
+			regions[i] = { memory[i].data(), sizes[i] };
+		}
+		randomize(1.0f);
+	}
+
+	// Write to a fraction of the pages and return their offsets
+	DirtyPages randomize(float fraction)
+	{
+		DirtyPages dirty;
+		for (int i = 0; i < RegionCount; i++)
+			for (u32 offset = 0; offset < memory[i].size(); offset += PAGE_SIZE)
+			{
+				if (rng() % 1000 >= fraction * 1000)
+					continue;
+				dirty[i].push_back(offset);
+				for (u32 j = 0; j < PAGE_SIZE; j++)
+					memory[i][offset + j] = (u8)rng();
+			}
+		return dirty;
+	}
+
+	static std::vector<u8> makeState(int n) {
+		return std::vector<u8>(100 + n, (u8)n);
+	}
+
+	std::array<std::vector<u8>, RegionCount> memory;
+	Regions regions;
+	std::mt19937 rng { 42 };
+};
+
+TEST_F(CheckpointTest, restore)
+{
+	History history;
+	ASSERT_TRUE(history.empty());
+	std::vector<std::array<std::vector<u8>, RegionCount>> snapshots;
+	history.addKeyframe(regions, makeState(0));
+	snapshots.push_back(memory);
+	for (int n = 1; n < 10; n++)
+	{
+		history.addDelta(regions, randomize(0.2f), makeState(n));
+		snapshots.push_back(memory);
+	}
+	ASSERT_EQ(10u, history.size());
+	// Deltas are smaller than the keyframe
+	ASSERT_LT(history.memoryUsage(), snapshots.size() * 112 * PAGE_SIZE / 2);
+
+	for (int n = 9; n >= 0; n -= 3)
+	{
+		randomize(0.5f);
+		const std::vector<u8>& state = history.restore(n, regions);
+		ASSERT_EQ(makeState(n), state);
+		ASSERT_EQ(snapshots[n], memory) << "checkpoint " << n;
+		ASSERT_EQ((size_t)n + 1, history.size());
+	}
+}
+
+TEST_F(CheckpointTest, branch)
+{
+	// Restoring a checkpoint then adding new ones
+	History history;
+	history.addKeyframe(regions, makeState(0));
+	history.addDelta(regions, randomize(0.3f), makeState(1));
+	auto snapshot1 = memory;
+	history.addDelta(regions, randomize(0.3f), makeState(2));
+	history.restore(1, regions);
+	ASSERT_EQ(snapshot1, memory);
+	history.addDelta(regions, randomize(0.3f), makeState(3));
+	auto snapshot3 = memory;
+	randomize(1.0f);
+	ASSERT_EQ(makeState(3), history.restore(2, regions));
+	ASSERT_EQ(snapshot3, memory);
+	ASSERT_EQ(makeState(1), history.restore(1, regions));
+	ASSERT_EQ(snapshot1, memory);
+}
+
+TEST_F(CheckpointTest, compact)
+{
+	History history;
+	std::vector<std::array<std::vector<u8>, RegionCount>> snapshots;
+	history.addKeyframe(regions, makeState(0));
+	snapshots.push_back(memory);
+	for (int n = 1; n < 20; n++)
+	{
+		history.addDelta(regions, randomize(0.05f), makeState(n));
+		snapshots.push_back(memory);
+		history.compact(8);
+		ASSERT_LE(history.size(), 9u);
+	}
+	ASSERT_EQ(9u, history.size());
+	// The keyframe is now checkpoint 11
+	for (int n = 8; n >= 0; n--)
+	{
+		ASSERT_EQ(makeState(n + 11), history.restore(n, regions));
+		ASSERT_EQ(snapshots[n + 11], memory) << "checkpoint " << n;
+	}
+
+	// Deltas can't use more memory than the keyframe
+	history.addDelta(regions, randomize(0.8f), makeState(20));
+	history.addDelta(regions, randomize(0.8f), makeState(21));
+	history.compact(8);
+	ASSERT_EQ(2u, history.size());
+	ASSERT_EQ(makeState(21), history.restore(1, regions));
+	ASSERT_EQ(makeState(20), history.restore(0, regions));
+}
@@ -0,0 +1,155 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/mem/rewind_buffer.h"
+
+#include <random>
+#include <vector>
+
+using namespace checkpoint;
+
+class RewindBufferTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		const u32 sizes[RegionCount] { 64 * PAGE_SIZE, 32 * PAGE_SIZE, 16 * PAGE_SIZE, 0 };
+		for (int i = 0; i < RegionCount; i++)
+		{
+			memory[i].resize(sizes[i]);
+			regions[i] = { memory[i].data(), sizes[i] };
+		}
+	}
+
+	// Write to a fraction of the pages and return their previous content
+	UndoPages runFrame(float fraction)
+	{
+		undoData.clear();
+		UndoPages undo;
+		for (int i = 0; i < RegionCount; i++)
+			for (u32 offset = 0; offset < memory[i].size(); offset += PAGE_SIZE)
+			{
+				if (rng() % 1000 >= fraction * 1000)
+					continue;
+				// The page data doesn't move when undoData grows
+				undo[i].push_back({ offset, undoData.emplace_back(&memory[i][offset], &memory[i][offset + PAGE_SIZE]).data() });
+				// A few random bytes per page, like a running game
+				for (int j = 0; j < 16; j++)
+					memory[i][offset + rng() % PAGE_SIZE] = (u8)rng();
+			}
+		return undo;
+	}
+
+	// Variable size state with a frame counter
+	static std::vector<u8> makeState(int n)
+	{
+		std::vector<u8> state(1000 + n % 7, 0x55);
+		memcpy(state.data(), &n, sizeof(n));
+		return state;
+	}
+
+	std::array<std::vector<u8>, RegionCount> memory;
+	Regions regions;
+	std::vector<std::vector<u8>> undoData;
+	std::mt19937 rng { 42 };
+};
+
+TEST_F(RewindBufferTest, rewind)
+{
+	RewindBuffer buffer;
+	buffer.setCapacity(16_MB);
+	buffer.reset(makeState(0));
+	std::vector<std::array<std::vector<u8>, RegionCount>> snapshots;
+	snapshots.push_back(memory);
+	for (int n = 1; n < 50; n++)
+	{
+		UndoPages undo = runFrame(0.2f);
+		buffer.push(undo, makeState(n));
+		snapshots.push_back(memory);
+	}
+	ASSERT_EQ(49u, buffer.size());
+	ASSERT_EQ(makeState(49), buffer.state());
+	for (int n = 48; n >= 0; n--)
+	{
+		ASSERT_TRUE(buffer.pop(regions));
+		ASSERT_EQ(makeState(n), buffer.state()) << "frame " << n;
+		ASSERT_EQ(snapshots[n], memory) << "frame " << n;
+	}
+	ASSERT_TRUE(buffer.empty());
+	ASSERT_EQ(0u, buffer.memoryUsage());
+	ASSERT_FALSE(buffer.pop(regions));
+	ASSERT_EQ(snapshots[0], memory);
+}
+
+TEST_F(RewindBufferTest, resume)
+{
+	// Play again after rewinding
+	RewindBuffer buffer;
+	buffer.setCapacity(16_MB);
+	buffer.reset(makeState(0));
+	std::vector<std::array<std::vector<u8>, RegionCount>> snapshots;
+	snapshots.push_back(memory);
+	for (int n = 1; n < 10; n++)
+	{
+		buffer.push(runFrame(0.2f), makeState(n));
+		snapshots.push_back(memory);
+	}
+	for (int n = 0; n < 5; n++)
+		ASSERT_TRUE(buffer.pop(regions));
+	snapshots.resize(5);
+	for (int n = 5; n < 10; n++)
+	{
+		buffer.push(runFrame(0.2f), makeState(n + 100));
+		snapshots.push_back(memory);
+	}
+	for (int n = 8; n >= 0; n--)
+	{
+		ASSERT_TRUE(buffer.pop(regions));
+		ASSERT_EQ(snapshots[n], memory) << "frame " << n;
+		ASSERT_EQ(makeState(n >= 5 ? n + 100 : n), buffer.state()) << "frame " << n;
+	}
+}
+
+TEST_F(RewindBufferTest, capacity)
+{
+	RewindBuffer buffer;
+	buffer.setCapacity(64_KB);
+	buffer.reset(makeState(0));
+	std::vector<std::array<std::vector<u8>, RegionCount>> snapshots;
+	snapshots.push_back(memory);
+	for (int n = 1; n < 100; n++)
+	{
+		buffer.push(runFrame(0.2f), makeState(n));
+		snapshots.push_back(memory);
+		ASSERT_LE(buffer.memoryUsage(), 64_KB);
+	}
+	const size_t count = buffer.size();
+	ASSERT_LT(count, 99u);
+	ASSERT_GT(count, 0u);
+	// The most recent frames are kept
+	for (size_t i = 0; i < count; i++)
+		ASSERT_TRUE(buffer.pop(regions));
+	ASSERT_EQ(snapshots[99 - count], memory);
+	ASSERT_EQ(makeState(99 - count), buffer.state());
+
+	buffer.setCapacity(0);
+	buffer.push(runFrame(0.2f), makeState(1));
+	ASSERT_EQ(1u, buffer.size());
+}
+
+TEST_F(RewindBufferTest, cleared)
+{
+	RewindBuffer buffer;
+	buffer.setCapacity(16_MB);
+	buffer.reset(makeState(0));
+	buffer.push(runFrame(0.2f), makeState(1));
+	buffer.clear();
+	// The first frame after clearing can't be undone
+	buffer.push(runFrame(0.2f), makeState(2));
+	ASSERT_TRUE(buffer.empty());
+	const auto snapshot = memory;
+	buffer.push(runFrame(0.2f), makeState(3));
+	ASSERT_EQ(1u, buffer.size());
+	ASSERT_TRUE(buffer.pop(regions));
+	ASSERT_EQ(snapshot, memory);
+	ASSERT_EQ(makeState(2), buffer.state());
+}
@@ -0,0 +1,155 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/pvr/ta_ctx.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+class SortTrianglesTest : public ::testing::Test
+{
+protected:
+	// Create a pass of translucent strips with random z values
+	void makeScene(u32 polyCount, u32 maxStripSize, u32 zRange)
+	{
+		ctx.Clear();
+		std::mt19937 gen(1234);
+		for (u32 i = 0; i < polyCount; i++)
+		{
+			PolyParam& pp = ctx.global_param_tr.emplace_back();
+			pp.init();
+			pp.first = ctx.verts.size();
+			pp.count = 1 + gen() % maxStripSize;
+			// a few different render states to test merging
+			pp.tsp.full = gen() % 4;
+			pp.isp.CullMode = gen() % 4;
+			for (u32 j = 0; j < pp.count; j++)
+			{
+				Vertex& v = ctx.verts.emplace_back();
+				v.x = (f32)(gen() % 640);
+				v.y = (f32)(gen() % 480);
+				// limited range to have equal z values
+				v.z = (f32)(gen() % zRange) / 16.f;
+				if (gen() % 500 == 0)
+					v.z = -0.f;
+				if (gen() % 1000 == 0)
+					v.x = std::numeric_limits<f32>::quiet_NaN();
+			}
+		}
+		previousPass = {};
+		pass = {};
+		pass.tr_count = ctx.global_param_tr.size();
+	}
+
+	struct Triangle
+	{
+		u32 pid;
+		u32 vid[3];
+		f32 z;
+	};
+
+	// Reference implementation with std::stable_sort
+	void referenceSort(std::vector<u32>& idx, std::vector<SortedTriangle>& sorted)
+	{
+		std::vector<Triangle> triangles;
+		const PolyParam *pp_base = &ctx.global_param_tr[0];
+		auto isInf = [](const Vertex& v) {
+			return std::isnan(v.x) || fabsf(v.x) > 1e25f
+					|| std::isnan(v.y) || fabsf(v.y) > 1e25f
+					|| std::isnan(v.z) || v.z > 3.4e37f;
+		};
+		for (u32 pid = 0; pid < pass.tr_count; pid++)
+		{
+			const PolyParam& pp = pp_base[pid];
+			for (u32 i = 2; i < pp.count; i++)
+			{
+				// strip order
+				u32 v0 = pp.first + (i & 1 ? i - 1 : i - 2);
+				u32 v1 = pp.first + (i & 1 ? i - 2 : i - 1);
+				u32 v2 = pp.first + i;
+				if (isInf(ctx.verts[v0]) || isInf(ctx.verts[v1]) || isInf(ctx.verts[v2]))
+					continue;
+				f32 z = std::min(std::min(ctx.verts[v0].z, ctx.verts[v1].z), ctx.verts[v2].z);
+				triangles.push_back({ pid, { v0, v1, v2 }, z });
+			}
+		}
+		std::stable_sort(triangles.begin(), triangles.end(), [](const Triangle& a, const Triangle& b) {
+			return a.z < b.z;
+		});
+		for (size_t k = 1; k < triangles.size(); k++)
+			if (triangles[k].pid != triangles[k - 1].pid)
+			{
+				const PolyParam& curPoly = pp_base[triangles[k].pid];
+				const PolyParam& prevPoly = pp_base[triangles[k - 1].pid];
+				if (curPoly.equivalentIgnoreCullingDirection(prevPoly)
+						&& (curPoly.isp.CullMode < 2 || curPoly.isp.CullMode == prevPoly.isp.CullMode))
+					triangles[k].pid = triangles[k - 1].pid;
+			}
+		for (size_t i = 0; i < triangles.size(); i++)
+		{
+			idx.insert(idx.end(), triangles[i].vid, triangles[i].vid + 3);
+			if (i == 0 || triangles[i].pid != triangles[i - 1].pid)
+			{
+				if (!sorted.empty())
+					sorted.back().count = i * 3 - sorted.back().first;
+				sorted.push_back({ triangles[i].pid, (u32)i * 3, 0 });
+			}
+		}
+		if (!sorted.empty())
+			sorted.back().count = triangles.size() * 3 - sorted.back().first;
+	}
+
+	void checkScene()
+	{
+		std::vector<u32> idx;
+		std::vector<SortedTriangle> sorted;
+		referenceSort(idx, sorted);
+
+		sortTriangles(ctx, pass, previousPass);
+		ASSERT_EQ(idx.size(), ctx.idx.size());
+		for (size_t i = 0; i < idx.size(); i++)
+			ASSERT_EQ(idx[i], ctx.idx[i]) << "index " << i;
+		ASSERT_EQ(sorted.size(), ctx.sortedTriangles.size());
+		for (size_t i = 0; i < sorted.size(); i++)
+		{
+			ASSERT_EQ(sorted[i].polyIndex, ctx.sortedTriangles[i].polyIndex);
+			ASSERT_EQ(sorted[i].first, ctx.sortedTriangles[i].first);
+			ASSERT_EQ(sorted[i].count, ctx.sortedTriangles[i].count);
+		}
+		ASSERT_EQ(sorted.size(), pass.sorted_tr_count);
+	}
+
+	rend_context ctx;
+	RenderPass previousPass;
+	RenderPass pass;
+};
+
+TEST_F(SortTrianglesTest, small)
+{
+	makeScene(50, 8, 64);
+	checkScene();
+}
+
+TEST_F(SortTrianglesTest, large)
+{
+	// Large enough to extract triangles in parallel
+	makeScene(5000, 16, 100000);
+	checkScene();
+}
+
+TEST_F(SortTrianglesTest, sameZ)
+{
+	makeScene(500, 10, 1);
+	checkScene();
+}
+
+TEST_F(SortTrianglesTest, noTriangle)
+{
+	// Strips of 1 or 2 vertices only
+	makeScene(50, 2, 64);
+	sortTriangles(ctx, pass, previousPass);
+	ASSERT_TRUE(ctx.idx.empty());
+	// A single empty entry signals that the pass is sorted
+	ASSERT_EQ(1u, ctx.sortedTriangles.size());
+	ASSERT_EQ(0u, ctx.sortedTriangles[0].count);
+	ASSERT_EQ(1u, pass.sorted_tr_count);
+}
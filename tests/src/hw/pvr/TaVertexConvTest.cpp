@@ -0,0 +1,234 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/pvr/ta_ctx.h"
+#include "hw/pvr/ta_structs.h"
+#include "cfg/option.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// Converts poly strips of all the 32-byte vertex types with ta_add_ta_data()
+// and checks the resulting vertices against the TA conversion rules.
+class TaVertexConvTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		SetCurrentTARC(0);
+		gen.seed(42);
+	}
+
+	void TearDown() override
+	{
+		tactx_Term();
+		config::RendererType.reset();
+	}
+
+	struct Block {
+		u32 w[8];
+	};
+
+	// Only floats whose 16 lsbits are 0 to get exact results with the conversion table
+	f32 randomColor()
+	{
+		f32 f = colorDist(gen);
+		u32 i = (u32&)f & 0xffff0000;
+		return (f32&)i;
+	}
+
+	static u32 floatBits(f32 f) {
+		return (u32&)f;
+	}
+
+	static f32 toFloat(u32 i) {
+		return (f32&)i;
+	}
+
+	static u8 satU8(u32 bits)
+	{
+		f32 f = toFloat(bits);
+		return f == f ? (u8)(std::clamp(f, 0.f, 1.f) * 255.f) : 255;
+	}
+
+	// Parse strips of vertices of the given type and check each vertex
+	void checkStrips(u32 objCtrl, int polyType)
+	{
+		const u32 faceColor[4] { floatBits(1.f), floatBits(0.5f), floatBits(0.25f), floatBits(1.25f) };
+		const u32 faceOffset[4] { floatBits(0.75f), floatBits(-1.f), floatBits(0.125f), floatBits(1.f) };
+		std::vector<Block> data;
+		// Global parameter
+		PCW pcw{};
+		pcw.ParaType = ParamType_Polygon_or_Modifier_Volume;
+		pcw.ListType = ListType_Opaque;
+		pcw.obj_ctrl = objCtrl;
+		Block& gp = data.emplace_back();
+		gp.w[0] = pcw.full;
+		if (pcw.Col_Type == 2)
+		{
+			if (pcw.Texture && pcw.Offset)
+			{
+				// Polygon type 2
+				Block& gp2 = data.emplace_back();
+				memcpy(&gp2.w[0], faceColor, sizeof(faceColor));
+				memcpy(&gp2.w[4], faceOffset, sizeof(faceOffset));
+			}
+			else {
+				// Polygon type 1
+				memcpy(&gp.w[4], faceColor, sizeof(faceColor));
+			}
+		}
+		// Vertices. Strips of odd sizes to test partial batches.
+		std::vector<u32> stripSizes { 1, 2, 3, 4, 5, 7, 8, 16, 31, 64, 129 };
+		for (u32 stripSize : stripSizes)
+			for (u32 i = 0; i < stripSize; i++)
+			{
+				Block& v = data.emplace_back();
+				PCW vpcw{};
+				vpcw.ParaType = ParamType_Vertex_Parameter;
+				vpcw.EndOfStrip = i == stripSize - 1;
+				v.w[0] = vpcw.full;
+				v.w[1] = floatBits((f32)(gen() % 640));
+				v.w[2] = floatBits((f32)(gen() % 480));
+				v.w[3] = floatBits(1.f / (1 + gen() % 1000));
+				for (int j = 4; j < 8; j++)
+					v.w[j] = polyType == 1 || polyType == 2 || polyType >= 7 ? floatBits(randomColor()) : (u32)gen();
+				if (polyType == 3 || polyType == 7)
+				{
+					v.w[4] = floatBits((f32)(gen() % 1024) / 1024.f);
+					v.w[5] = floatBits((f32)(gen() % 1024) / 1024.f);
+				}
+				if (gen() % 16 == 0)
+				{
+					// special values
+					const u32 specials[] { floatBits(std::numeric_limits<f32>::quiet_NaN()),
+						floatBits(std::numeric_limits<f32>::infinity()),
+						floatBits(-std::numeric_limits<f32>::infinity()),
+						floatBits(-0.f), floatBits(1.f), floatBits(0.99999f) & 0xffff0000 };
+					for (int j = 4; j < 8; j++)
+						if (polyType == 1 || (polyType == 2 && j == 6) || (polyType >= 7 && j >= 6))
+							v.w[j] = specials[gen() % std::size(specials)];
+				}
+			}
+		const u32 vertexCount = data.size() - (pcw.Texture && pcw.Offset && pcw.Col_Type == 2 ? 2 : 1);
+		PCW eol{};
+		eol.ParaType = ParamType_End_Of_List;
+		data.emplace_back().w[0] = eol.full;
+
+		rend_context& rc = ta_ctx->rend;
+		rc.Clear();
+		const u32 firstVertex = rc.verts.size();
+		ta_parse_reset();
+		u32 *p = data[0].w;
+		u32 size = data.size() * sizeof(Block);
+		while (size > 0)
+		{
+			u32 n = ta_add_ta_data(p, size);
+			ASSERT_NE(0u, n);
+			p += n / 4;
+			size -= n;
+		}
+
+		const bool dx = config::RendererType == RenderType::DirectX11;
+		const int Red = dx ? 2 : 0;
+		const int Green = 1;
+		const int Blue = dx ? 0 : 2;
+		const int Alpha = 3;
+		auto packed = [&](u8 *to, u32 t) {
+			to[Blue] = (u8)t;
+			to[Green] = (u8)(t >> 8);
+			to[Red] = (u8)(t >> 16);
+			to[Alpha] = (u8)(t >> 24);
+		};
+		auto floating = [&](u8 *to, const u32 *argb) {
+			to[Red] = satU8(argb[1]);
+			to[Green] = satU8(argb[2]);
+			to[Blue] = satU8(argb[3]);
+			to[Alpha] = satU8(argb[0]);
+		};
+		// Alpha doesn't get intensity
+		auto intensity = [&](u8 *to, u32 intensity, const u32 *faceArgb) {
+			u8 face[4];
+			floating(face, faceArgb);
+			u32 satint = satU8(intensity);
+			to[Red] = face[Red] * satint / 256;
+			to[Green] = face[Green] * satint / 256;
+			to[Blue] = face[Blue] * satint / 256;
+			to[Alpha] = face[Alpha];
+		};
+
+		ASSERT_EQ(firstVertex + vertexCount, rc.verts.size());
+		const Block *src = &data[data.size() - 1 - vertexCount];
+		for (u32 i = 0; i < vertexCount; i++, src++)
+		{
+			const Vertex& vtx = rc.verts[firstVertex + i];
+			const u32 *w = src->w;
+			ASSERT_EQ(w[1], floatBits(vtx.x)) << "vertex " << i;
+			ASSERT_EQ(w[2], floatBits(vtx.y)) << "vertex " << i;
+			ASSERT_EQ(w[3], floatBits(vtx.z)) << "vertex " << i;
+			u8 col[4];
+			u8 spc[4];
+			switch (polyType)
+			{
+			case 0:
+				packed(col, w[6]);
+				break;
+			case 1:
+				floating(col, &w[4]);
+				break;
+			case 2:
+				intensity(col, w[6], faceColor);
+				break;
+			case 3:
+			case 4:
+				packed(col, w[6]);
+				packed(spc, w[7]);
+				break;
+			case 7:
+			case 8:
+				intensity(col, w[6], faceColor);
+				intensity(spc, w[7], faceOffset);
+				break;
+			}
+			ASSERT_EQ(0, memcmp(col, vtx.col, 4)) << "base color of vertex " << i;
+			if (polyType >= 3)
+				ASSERT_EQ(0, memcmp(spc, vtx.spc, 4)) << "offset color of vertex " << i;
+			if (polyType == 3 || polyType == 7)
+			{
+				ASSERT_EQ(w[4], floatBits(vtx.u)) << "u of vertex " << i;
+				ASSERT_EQ(w[5], floatBits(vtx.v)) << "v of vertex " << i;
+			}
+			else if (polyType == 4 || polyType == 8)
+			{
+				// 16-bit u in the high half and v in the low half
+				ASSERT_EQ(w[4] & 0xffff0000, floatBits(vtx.u)) << "u of vertex " << i;
+				ASSERT_EQ(w[4] << 16, floatBits(vtx.v)) << "v of vertex " << i;
+			}
+		}
+	}
+
+	void checkAllTypes()
+	{
+		checkStrips(0x00, 0);	// Non-Textured, Packed Color
+		checkStrips(0x10, 1);	// Non-Textured, Floating Color
+		checkStrips(0x20, 2);	// Non-Textured, Intensity
+		checkStrips(0x08, 3);	// Textured, Packed Color
+		checkStrips(0x09, 4);	// Textured, Packed Color, 16bit UV
+		checkStrips(0x2c, 7);	// Textured, Intensity, Offset
+		checkStrips(0x2d, 8);	// Textured, Intensity, Offset, 16bit UV
+	}
+
+	std::mt19937 gen;
+	std::uniform_real_distribution<f32> colorDist { -0.25f, 1.25f };
+};
+
+TEST_F(TaVertexConvTest, rgba)
+{
+	config::RendererType.override(RenderType::OpenGL);
+	checkAllTypes();
+}
+
+TEST_F(TaVertexConvTest, bgra)
+{
+	config::RendererType.override(RenderType::DirectX11);
+	checkAllTypes();
+}
@@ -0,0 +1,141 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "profiler/telemetry.h"
+#include "oslib/oslib.h"
+#include "json.hpp"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <thread>
+
+using namespace nlohmann;
+
+class TelemetryTest : public ::testing::Test
+{
+protected:
+	void TearDown() override {
+		telemetry::setEnabled(false);
+	}
+
+	json exportTrace()
+	{
+		const std::string path = (std::filesystem::temp_directory_path() / "flycast-telemetry-test.json").string();
+		EXPECT_TRUE(telemetry::exportChromeTrace(path));
+		std::ifstream f(path);
+		json trace = json::parse(f);
+		f.close();
+		std::filesystem::remove(path);
+		return trace;
+	}
+
+	// Number of events of each probe, by thread name
+	static std::map<std::string, std::map<std::string, int>> countEvents(const json& trace)
+	{
+		std::map<int, std::string> threadNames;
+		for (const json& event : trace["traceEvents"])
+			if (event["ph"] == "M")
+				threadNames[event["tid"]] = event["args"]["name"];
+		std::map<std::string, std::map<std::string, int>> counts;
+		for (const json& event : trace["traceEvents"])
+			if (event["ph"] == "X")
+			{
+				EXPECT_GE(event["ts"].get<double>(), 0.0);
+				EXPECT_GE(event["dur"].get<double>(), 0.0);
+				counts[threadNames[event["tid"]]][event["name"]]++;
+			}
+		return counts;
+	}
+};
+
+TEST_F(TelemetryTest, disabled)
+{
+	telemetry::setEnabled(true);
+	telemetry::setEnabled(false);
+	std::thread thread([]() {
+		ThreadName _("Disabled");
+		for (int i = 0; i < 100; i++)
+			telemetry::Scope _(telemetry::Probe::TaParse);
+	});
+	thread.join();
+	auto counts = countEvents(exportTrace());
+	ASSERT_EQ(0u, counts.count("Disabled"));
+}
+
+TEST_F(TelemetryTest, threads)
+{
+	telemetry::setEnabled(true);
+	// The buffer of a thread can be reused once it exits
+	std::atomic<int> done = 0;
+	const auto& arriveAndWait = [&done]() {
+		done++;
+		while (done < 2)
+			std::this_thread::yield();
+	};
+	std::thread thread1([&arriveAndWait]() {
+		ThreadName _("Thread1");
+		for (int i = 0; i < 10; i++)
+		{
+			telemetry::Scope _(telemetry::Probe::StartRender);
+			telemetry::Scope nested(telemetry::Probe::TaParse);
+		}
+		arriveAndWait();
+	});
+	std::thread thread2([&arriveAndWait]() {
+		ThreadName _("Thread2");
+		for (int i = 0; i < 20; i++)
+			telemetry::Scope _(telemetry::Probe::AicaSample);
+		arriveAndWait();
+	});
+	thread1.join();
+	thread2.join();
+
+	auto counts = countEvents(exportTrace());
+	ASSERT_EQ(10, counts["Thread1"]["rend_start_render"]);
+	ASSERT_EQ(10, counts["Thread1"]["ta_parse"]);
+	ASSERT_EQ(2u, counts["Thread1"].size());
+	ASSERT_EQ(20, counts["Thread2"]["AICA_Sample"]);
+}
+
+TEST_F(TelemetryTest, wrapAround)
+{
+	telemetry::setEnabled(true);
+	std::thread thread([]() {
+		ThreadName _("WrapAround");
+		for (int i = 0; i < 1'000'000; i++)
+			telemetry::Scope _(telemetry::Probe::Sh4Scheduler);
+	});
+	thread.join();
+
+	auto counts = countEvents(exportTrace());
+	// Only the most recent events are kept
+	ASSERT_GT(counts["WrapAround"]["sh4_sched_tick"], 100'000);
+	ASSERT_LT(counts["WrapAround"]["sh4_sched_tick"], 1'000'000);
+}
+
+TEST_F(TelemetryTest, totals)
+{
+	telemetry::startTotals();
+	std::thread thread([]() {
+		ThreadName _("Totals");
+		for (int i = 0; i < 100; i++)
+		{
+			telemetry::Scope _(telemetry::Probe::TextureUpdate);
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	});
+	thread.join();
+	telemetry::stopTotals();
+	{
+		telemetry::Scope _(telemetry::Probe::TextureUpdate);
+	}
+
+	ASSERT_EQ(100u, telemetry::totalCount(telemetry::Probe::TextureUpdate));
+	ASSERT_EQ(0u, telemetry::totalCount(telemetry::Probe::TaParse));
+	ASSERT_GE(telemetry::totalTime(telemetry::Probe::TextureUpdate), 10.0);
+	ASSERT_EQ(0.0, telemetry::totalTime(telemetry::Probe::TaParse));
+	// Totals aren't traced
+	auto counts = countEvents(exportTrace());
+	ASSERT_EQ(0u, counts.count("Totals"));
+}
@@ -0,0 +1,136 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "rend/texconv.h"
+#include "hw/pvr/ta_structs.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+class TexConvTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		std::mt19937 gen(42);
+		// Largest texture with mipmaps, and a VQ codebook
+		data.resize(1024 * 1024 * 2 * 2);
+		for (u8& b : data)
+			b = gen();
+		codebook.resize(256 * 8);
+		for (u8& b : codebook)
+			b = gen();
+	}
+
+	// Same as texconv.cpp
+	static u32 twiddle(u32 x, u32 y, u32 x_sz, u32 y_sz)
+	{
+		u32 rv = 0;
+		u32 sh = 0;
+		x_sz >>= 1;
+		y_sz >>= 1;
+		while (x_sz != 0 || y_sz != 0)
+		{
+			if (y_sz != 0)
+			{
+				rv |= (y & 1) << sh;
+				y_sz >>= 1;
+				y >>= 1;
+				sh++;
+			}
+			if (x_sz != 0)
+			{
+				rv |= (x & 1) << sh;
+				x_sz >>= 1;
+				x >>= 1;
+				sh++;
+			}
+		}
+		return rv;
+	}
+
+	// Reference decoding of all the pixels of a 16-bit texture
+	template<typename Unpacker, typename Pixel = typename Unpacker::unpacked_type>
+	void checkTexture16(const char *name, void (*conv)(PixelBuffer<Pixel> *, const u8 *, u32, u32), bool vq, bool planar)
+	{
+		if (conv == nullptr)
+			return;
+		vq_codebook = codebook.data();
+		const u16 *src = (const u16 *)data.data();
+		const u16 *cb = (const u16 *)codebook.data();
+		// Planar textures are at least 8 pixels wide
+		for (u32 w = planar ? 8 : 2; w <= 1024; w *= 2)
+			for (u32 h = 2; h <= 1024; h *= 2)
+			{
+				PixelBuffer<Pixel> pb;
+				pb.init(w, h);
+				conv(&pb, data.data(), w, h);
+				for (u32 y = 0; y < h; y++)
+					for (u32 x = 0; x < w; x++)
+					{
+						u16 texel;
+						if (planar)
+							texel = src[y * w + x];
+						else if (vq)
+						{
+							const u32 idx = twiddle(x, y, w, h);
+							texel = cb[data[idx / 4] * 4 + idx % 4];
+						}
+						else
+							texel = src[twiddle(x, y, w, h)];
+						ASSERT_EQ(Unpacker::unpack(texel), *pb.data(x, y)) << name << " " << w << "x" << h << " at " << x << "," << y;
+					}
+			}
+	}
+
+	void checkPalette(const char *name, TexConvFP8 conv, u32 bpp)
+	{
+		if (conv == nullptr)
+			return;
+		for (u32 w = 4; w <= 1024; w *= 2)
+			for (u32 h = 4; h <= 1024; h *= 2)
+			{
+				PixelBuffer<u8> pb;
+				pb.init(w, h);
+				conv(&pb, data.data(), w, h);
+				for (u32 y = 0; y < h; y++)
+					for (u32 x = 0; x < w; x++)
+					{
+						const u32 idx = twiddle(x, y, w, h);
+						u8 expected = bpp == 8 ? data[idx] : (data[idx / 2] >> ((idx & 1) * 4)) & 0xf;
+						ASSERT_EQ(expected, *pb.data(x, y)) << name << " " << w << "x" << h << " at " << x << "," << y;
+					}
+			}
+	}
+
+	template<typename Unpacker16, typename Unpacker32>
+	void checkFormat(const PvrTexInfo& info)
+	{
+		checkTexture16<Unpacker16>(info.name, info.TW, false, false);
+		checkTexture16<Unpacker16>(info.name, info.VQ, true, false);
+		checkTexture16<Unpacker32>(info.name, info.TW32, false, false);
+		checkTexture16<Unpacker32>(info.name, info.VQ32, true, false);
+		checkTexture16<Unpacker32>(info.name, info.PL32, false, true);
+	}
+
+	std::vector<u8> data;
+	std::vector<u8> codebook;
+};
+
+TEST_F(TexConvTest, opengl)
+{
+	const PvrTexInfo *texInfo = opengl::pvrTexInfo;
+	checkFormat<Unpacker1555, Unpacker1555_32<RGBAPacker>>(texInfo[Pixel1555]);
+	checkFormat<UnpackerNop<u16>, Unpacker565_32<RGBAPacker>>(texInfo[Pixel565]);
+	checkFormat<Unpacker4444, Unpacker4444_32<RGBAPacker>>(texInfo[Pixel4444]);
+	checkFormat<Unpacker4444, Unpacker4444_32<RGBAPacker>>(texInfo[PixelBumpMap]);
+	checkPalette("pal4", texInfo[PixelPal4].TW8, 4);
+	checkPalette("pal8", texInfo[PixelPal8].TW8, 8);
+}
+
+TEST_F(TexConvTest, directx)
+{
+	const PvrTexInfo *texInfo = directx::pvrTexInfo;
+	checkFormat<UnpackerNop<u16>, Unpacker1555_32<BGRAPacker>>(texInfo[Pixel1555]);
+	checkFormat<UnpackerNop<u16>, Unpacker565_32<BGRAPacker>>(texInfo[Pixel565]);
+	checkFormat<UnpackerNop<u16>, Unpacker4444_32<BGRAPacker>>(texInfo[Pixel4444]);
+}
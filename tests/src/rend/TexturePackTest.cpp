@@ -0,0 +1,210 @@
+#include "gtest/gtest.h"
+#include "types.h"
+#include "rend/TexturePack.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+#include <zlib.h>
+
+class TexturePackTest : public ::testing::Test
+{
+protected:
+	struct Texture
+	{
+		u32 hash;
+		u16 width;
+		u16 height;
+		bool deflate;
+		std::vector<u8> pixels;
+	};
+
+	void SetUp() override
+	{
+		path = (std::filesystem::temp_directory_path() / "flycast-texpack-test.ftpack").string();
+		// Sorted by hash, as written by texpack
+		addTexture(0x00000010, 8, 8, false);
+		addTexture(0x12345678, 64, 32, true);
+		addTexture(0x12345679, 1, 1, false);
+		addTexture(0x9abcdef0, 16, 128, true);
+		addTexture(0xfffffff0, 4, 2, false);
+	}
+
+	void TearDown() override {
+		std::filesystem::remove(path);
+	}
+
+	void addTexture(u32 hash, u16 width, u16 height, bool deflate)
+	{
+		Texture& texture = textures.emplace_back();
+		texture.hash = hash;
+		texture.width = width;
+		texture.height = height;
+		texture.deflate = deflate;
+		texture.pixels.resize(width * height * 4);
+		// Repeating pattern so that deflating helps
+		for (size_t i = 0; i < texture.pixels.size(); i++)
+			texture.pixels[i] = (u8)(hash + i % 37);
+	}
+
+	// Same layout as tools/texpack
+	void writePack(u32 magic = texpack::Magic)
+	{
+		FILE *f = fopen(path.c_str(), "wb");
+		ASSERT_NE(nullptr, f);
+		texpack::Header header{};
+		header.magic = magic;
+		header.version = texpack::Version;
+		header.count = textures.size();
+		std::vector<texpack::Entry> entries(textures.size());
+		std::vector<std::vector<u8>> payloads(textures.size());
+		u64 offset = sizeof(header) + entries.size() * sizeof(texpack::Entry);
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			const Texture& texture = textures[i];
+			texpack::Entry& entry = entries[i];
+			memset(&entry, 0, sizeof(entry));
+			entry.hash = texture.hash;
+			entry.width = texture.width;
+			entry.height = texture.height;
+			entry.rawSize = texture.pixels.size();
+			entry.offset = (offset + texpack::PayloadAlignment - 1) & ~(u64)(texpack::PayloadAlignment - 1);
+			if (texture.deflate)
+			{
+				uLongf size = compressBound(entry.rawSize);
+				payloads[i].resize(size);
+				ASSERT_EQ(Z_OK, compress2(payloads[i].data(), &size, texture.pixels.data(), entry.rawSize, 9));
+				ASSERT_LT(size, entry.rawSize);
+				payloads[i].resize(size);
+				entry.compression = texpack::Deflate;
+			}
+			else
+			{
+				payloads[i] = texture.pixels;
+				entry.compression = texpack::None;
+			}
+			entry.size = payloads[i].size();
+			offset = entry.offset + entry.size;
+		}
+		fwrite(&header, sizeof(header), 1, f);
+		fwrite(entries.data(), sizeof(texpack::Entry), entries.size(), f);
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			fseek(f, entries[i].offset, SEEK_SET);
+			fwrite(payloads[i].data(), 1, payloads[i].size(), f);
+		}
+		fclose(f);
+	}
+
+	void checkPack(TexturePack& pack)
+	{
+		ASSERT_TRUE(pack.isOpen());
+		ASSERT_EQ(textures.size(), pack.size());
+		for (const Texture& texture : textures)
+		{
+			const texpack::Entry *entry = pack.find(texture.hash);
+			ASSERT_NE(nullptr, entry);
+			ASSERT_EQ(texture.hash, entry->hash);
+			ASSERT_EQ(texture.deflate ? texpack::Deflate : texpack::None, entry->compression);
+
+			int width = 0;
+			int height = 0;
+			u8 *data = pack.load(texture.hash, width, height);
+			ASSERT_NE(nullptr, data);
+			ASSERT_EQ(texture.width, width);
+			ASSERT_EQ(texture.height, height);
+			ASSERT_EQ(0, memcmp(texture.pixels.data(), data, texture.pixels.size()));
+			free(data);
+		}
+		// Before the first, between two and after the last hash
+		for (u32 hash : { 0u, 0x12345677u, 0x1234567au, 0xffffffffu })
+		{
+			ASSERT_EQ(nullptr, pack.find(hash));
+			int width, height;
+			ASSERT_EQ(nullptr, pack.load(hash, width, height));
+		}
+	}
+
+	static void disableMapping(TexturePack& pack) {
+		pack.noMapping = true;
+	}
+
+	static bool isMapped(const TexturePack& pack) {
+		return pack.mapped != nullptr;
+	}
+
+	std::string path;
+	std::vector<Texture> textures;
+};
+
+TEST_F(TexturePackTest, mapped)
+{
+	writePack();
+	TexturePack pack;
+	ASSERT_TRUE(pack.open(path));
+	ASSERT_TRUE(isMapped(pack));
+	checkPack(pack);
+	pack.close();
+	ASSERT_FALSE(pack.isOpen());
+	ASSERT_EQ(nullptr, pack.find(textures[0].hash));
+}
+
+TEST_F(TexturePackTest, fallback)
+{
+	writePack();
+	TexturePack pack;
+	disableMapping(pack);
+	ASSERT_TRUE(pack.open(path));
+	ASSERT_FALSE(isMapped(pack));
+	checkPack(pack);
+}
+
+TEST_F(TexturePackTest, empty)
+{
+	textures.clear();
+	writePack();
+	TexturePack pack;
+	ASSERT_TRUE(pack.open(path));
+	ASSERT_EQ(0u, pack.size());
+	ASSERT_EQ(nullptr, pack.find(0x12345678));
+}
+
+TEST_F(TexturePackTest, invalid)
+{
+	TexturePack pack;
+	ASSERT_FALSE(pack.open(path));
+
+	writePack(0x12345678);
+	ASSERT_FALSE(pack.open(path));
+	disableMapping(pack);
+	ASSERT_FALSE(pack.open(path));
+	ASSERT_FALSE(pack.isOpen());
+}
+
+TEST_F(TexturePackTest, truncated)
+{
+	writePack();
+	// Cut the last payload
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+	for (bool mapping : { true, false })
+	{
+		TexturePack pack;
+		if (!mapping)
+			disableMapping(pack);
+		ASSERT_TRUE(pack.open(path));
+		int width, height;
+		ASSERT_EQ(nullptr, pack.load(textures.back().hash, width, height));
+		u8 *data = pack.load(textures.front().hash, width, height);
+		ASSERT_NE(nullptr, data);
+		free(data);
+	}
+	// Cut the index
+	std::filesystem::resize_file(path, sizeof(texpack::Header) + sizeof(texpack::Entry));
+	for (bool mapping : { true, false })
+	{
+		TexturePack pack;
+		if (!mapping)
+			disableMapping(pack);
+		ASSERT_FALSE(pack.open(path));
+	}
+}
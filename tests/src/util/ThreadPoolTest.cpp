@@ -0,0 +1,49 @@
+#include "gtest/gtest.h"
+#include "util/thread_pool.h"
+#include <atomic>
+#include <vector>
+
+#include "test_utils.h"
+
+class ThreadPoolTest : public ::testing::Test
+{
+};
+
+TEST_F(ThreadPoolTest, ParallelFor)
+{
+	ThreadPool pool{"Test", 4};
+	std::vector<int> values(1000);
+	pool.parallelFor(values.size(), [&](size_t i) {
+		values[i] = (int)i * 2;
+	});
+	for (size_t i = 0; i < values.size(); i++)
+		ASSERT_EQ((int)i * 2, values[i]);
+
+	// fewer items than threads
+	std::atomic<int> counter = 0;
+	pool.parallelFor(2, [&](size_t i) {
+		++counter;
+	});
+	ASSERT_EQ(2, counter);
+	pool.parallelFor(0, [&](size_t i) {
+		++counter;
+	});
+	ASSERT_EQ(2, counter);
+}
+
+TEST_F(ThreadPoolTest, Future)
+{
+	ThreadPool pool{"Test", 2};
+	const auto& task = [](u32 v) -> u32 {
+		return v + 1;
+	};
+	std::future<u32> f1 = pool.runFuture(task, 41);
+	std::future<u32> f2 = pool.runFuture(task, 42);
+	ASSERT_EQ(42, f1.get());
+	ASSERT_EQ(43, f2.get());
+
+	// test restart
+	pool.stop();
+	f1 = pool.runFuture(task, 1);
+	ASSERT_EQ(2, f1.get());
+}
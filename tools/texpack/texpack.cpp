@@ -0,0 +1,199 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+*/
+// Converts a custom texture directory (<hash>.png/jpg files) into a single texture pack file.
+//
+// Usage: texpack [-z level] <texture directory> <output file>
+//   -z level: deflate the images with the given compression level (1-9). Default is uncompressed.
+//
+// Copy the output file into the game texture directory (textures/<game id>/) with a .ftpack extension.
+#include "TexturePackFormat.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+#include <zlib.h>
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_JPEG
+#define STBI_ONLY_PNG
+#include <stb_image.h>
+
+namespace fs = std::filesystem;
+
+static void usage()
+{
+	fprintf(stderr, "Usage: texpack [-z level] <texture directory> <output file>\n");
+	exit(1);
+}
+
+// Same rules as CustomTextureSource::loadMap
+static std::map<uint32_t, fs::path> scanDirectory(const fs::path& dir)
+{
+	std::map<uint32_t, fs::path> textures;
+	for (const fs::directory_entry& item : fs::recursive_directory_iterator(dir))
+	{
+		if (!item.is_regular_file())
+			continue;
+		std::string extension = item.path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension != ".jpg" && extension != ".jpeg" && extension != ".png")
+			continue;
+		const std::string basename = item.path().stem().string();
+		char *endptr;
+		uint32_t hash = (uint32_t)strtoll(basename.c_str(), &endptr, 16);
+		if (basename.empty() || endptr - basename.c_str() < (ptrdiff_t)basename.length())
+		{
+			fprintf(stderr, "Ignoring %s: invalid hash\n", item.path().string().c_str());
+			continue;
+		}
+		auto [it, inserted] = textures.emplace(hash, item.path());
+		if (!inserted)
+			fprintf(stderr, "Ignoring %s: duplicate of %s\n", item.path().string().c_str(), it->second.string().c_str());
+	}
+	return textures;
+}
+
+static bool writeAt(FILE *f, uint64_t offset, const void *data, size_t size)
+{
+#ifdef _WIN32
+	if (_fseeki64(f, offset, SEEK_SET) != 0)
+#else
+	if (fseeko(f, offset, SEEK_SET) != 0)
+#endif
+		return false;
+	return fwrite(data, 1, size, f) == size;
+}
+
+int main(int argc, char *argv[])
+{
+	int level = 0;
+	int argi = 1;
+	if (argi < argc && strcmp(argv[argi], "-z") == 0)
+	{
+		if (argi + 1 >= argc)
+			usage();
+		level = atoi(argv[argi + 1]);
+		if (level < 1 || level > 9)
+			usage();
+		argi += 2;
+	}
+	if (argc - argi != 2)
+		usage();
+	const fs::path dir(argv[argi]);
+	const char *outPath = argv[argi + 1];
+
+	std::map<uint32_t, fs::path> textures;
+	try {
+		textures = scanDirectory(dir);
+	} catch (const fs::filesystem_error& e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	if (textures.empty())
+	{
+		fprintf(stderr, "No texture found in %s\n", dir.string().c_str());
+		return 1;
+	}
+	FILE *out = fopen(outPath, "wb");
+	if (out == nullptr)
+	{
+		perror(outPath);
+		return 1;
+	}
+
+	std::vector<texpack::Entry> entries;
+	entries.reserve(textures.size());
+	uint64_t offset = sizeof(texpack::Header) + textures.size() * sizeof(texpack::Entry);
+	uint64_t rawTotal = 0;
+	std::vector<uint8_t> compressed;
+	// Same orientation as the custom textures loaded by flycast
+	stbi_set_flip_vertically_on_load(1);
+	for (const auto& [hash, path] : textures)
+	{
+		FILE *f = fopen(path.string().c_str(), "rb");
+		int width, height, n;
+		uint8_t *image = f != nullptr ? stbi_load_from_file(f, &width, &height, &n, STBI_rgb_alpha) : nullptr;
+		if (f != nullptr)
+			fclose(f);
+		if (image == nullptr)
+		{
+			fprintf(stderr, "Ignoring %s: can't load image\n", path.string().c_str());
+			continue;
+		}
+		if (width > 0xffff || height > 0xffff)
+		{
+			fprintf(stderr, "Ignoring %s: image too large\n", path.string().c_str());
+			stbi_image_free(image);
+			continue;
+		}
+		texpack::Entry& entry = entries.emplace_back();
+		memset(&entry, 0, sizeof(entry));
+		entry.hash = hash;
+		entry.width = width;
+		entry.height = height;
+		entry.rawSize = (uint32_t)width * height * 4;
+		entry.offset = (offset + texpack::PayloadAlignment - 1) & ~(uint64_t)(texpack::PayloadAlignment - 1);
+		const uint8_t *payload = image;
+		entry.size = entry.rawSize;
+		entry.compression = texpack::None;
+		if (level != 0)
+		{
+			uLongf size = compressBound(entry.rawSize);
+			compressed.resize(size);
+			// Keep the image uncompressed if deflating doesn't help
+			if (compress2(compressed.data(), &size, image, entry.rawSize, level) == Z_OK && size < entry.rawSize)
+			{
+				payload = compressed.data();
+				entry.size = size;
+				entry.compression = texpack::Deflate;
+			}
+		}
+		bool success = writeAt(out, entry.offset, payload, entry.size);
+		stbi_image_free(image);
+		if (!success)
+		{
+			perror(outPath);
+			fclose(out);
+			return 1;
+		}
+		offset = entry.offset + entry.size;
+		rawTotal += entry.rawSize;
+	}
+
+	texpack::Header header{};
+	header.magic = texpack::Magic;
+	header.version = texpack::Version;
+	header.count = entries.size();
+	// Unused index slots of ignored images are left empty
+	if (!writeAt(out, 0, &header, sizeof(header))
+			|| !writeAt(out, sizeof(header), entries.data(), entries.size() * sizeof(texpack::Entry)))
+	{
+		perror(outPath);
+		fclose(out);
+		return 1;
+	}
+	fclose(out);
+	printf("%s: %zd textures, %.1f MB (%.1f MB decoded)\n", outPath, entries.size(),
+			offset / 1024.0 / 1024.0, rawTotal / 1024.0 / 1024.0);
+
+	return 0;
+}